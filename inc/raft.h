@@ -3,6 +3,7 @@
 
 #include "raft_config.h"
 #include "raft_rpc.h"
+#include "raft_ready.h"
 
 typedef struct raft_state raft_state_t;
 
@@ -24,11 +25,86 @@ raft_status_t raft_tick(raft_state_t* p_state,
                         uint32_t elapsed_ms);
 
 /**
+ * Appends an entry to the leader's log and starts replicating it. The log
+ * takes ownership of p_data. Returns RAFT_STATUS_NOT_LEADER on other nodes,
+ * and RAFT_STATUS_TRANSFER_IN_PROGRESS while leadership is being handed over.
  *
+ * If pf_completion is set it is called with p_context when the entry
+ * commits and again when it is applied, or once if leadership is lost
+ * first.
  */
 raft_status_t raft_append(raft_state_t* p_state,
                           uint32_t unique_id,
                           void* p_data,
-                          uint32_t data_size);
+                          uint32_t data_size,
+                          raft_proposal_f* pf_completion,
+                          void* p_context);
+
+/**
+ * Requests a linearizable read without writing to the log. The leader
+ * records its commit index, or the empty entry it appended on taking office
+ * if that has yet to commit, and confirms it still leads with one heartbeat
+ * round; reads issued while a round is in flight share the next one.
+ * A follower instead asks its leader for the read index, with one request
+ * covering every read queued behind it, and serves the reads locally once
+ * it has applied that index.
+ * pf_read is called once the read index has been applied, or with
+ * RAFT_STATUS_NOT_LEADER if leadership or the term changes first.
+ * Witnesses, which store no data, refuse with RAFT_STATUS_INVALID_ARGS.
+ */
+raft_status_t raft_read_index(raft_state_t* p_state,
+                              raft_read_f* pf_read,
+                              void* p_context);
+
+/**
+ * Hands leadership to target_id, e.g. before restarting this node. The
+ * leader stops accepting proposals, brings the target's log up to date and
+ * then tells it to campaign at once, skipping its election timeout. Returns
+ * RAFT_STATUS_TRANSFER_IN_PROGRESS while another transfer is under way. A
+ * transfer that has not completed within election_timeout_max_ms is
+ * abandoned and proposals are accepted again.
+ */
+raft_status_t raft_transfer_leadership(raft_state_t* p_state,
+                                       raft_nodeid_t target_id);
+
+/**
+ * On the leader, whether the learner node_id has every committed entry and
+ * may be promoted without stalling commits.
+ */
+raft_bool_t raft_learner_caught_up(raft_state_t const* p_state,
+                                   raft_nodeid_t node_id);
+
+/**
+ * Changes the membership to the given voters and learners through joint
+ * consensus. The leader appends a joint configuration that needs majorities
+ * of both the old and new voters, then the new configuration once that
+ * commits. Nodes adopt a configuration as soon as it is in their log.
+ * Returns RAFT_STATUS_CHANGE_IN_PROGRESS until the previous change has
+ * committed. A leader left out of the new voters steps down once it commits.
+ * Voter counts that raft_config_t's quorum sizes do not fit are refused
+ * with RAFT_STATUS_INVALID_ARGS.
+ */
+raft_status_t raft_change_membership(raft_state_t* p_state,
+                                     raft_nodeid_t const* p_voter_ids,
+                                     uint32_t voter_count,
+                                     raft_nodeid_t const* p_learner_ids,
+                                     uint32_t learner_count);
+
+/**
+ * Makes the learner node_id a voter through raft_change_membership().
+ */
+raft_status_t raft_promote_learner(raft_state_t* p_state,
+                                   raft_nodeid_t node_id);
+
+/**
+ * Serves a read from local state without a round trip while the leader
+ * holds a lease (raft_config_t.lease_reads). On RAFT_STATUS_OK, local state
+ * reflects every entry through *p_read_index. Returns
+ * RAFT_STATUS_LEASE_EXPIRED when the lease has lapsed or local state is not
+ * yet current, as before the no-op appended on taking office has applied;
+ * fall back to raft_read_index() then.
+ */
+raft_status_t raft_lease_read(raft_state_t* p_state,
+                              raft_index_t* p_read_index);
 
 #endif
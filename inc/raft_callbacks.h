@@ -19,6 +19,11 @@ typedef raft_status_t raft_append_entries_response_rpc_f(
     raft_append_entries_response_args_t*
 );
 
+typedef raft_status_t raft_heartbeat_rpc_f(
+    raft_nodeid_t,
+    raft_heartbeat_args_t*
+);
+
 typedef raft_status_t raft_request_vote_rpc_f(
     raft_nodeid_t,
     raft_request_vote_args_t*
@@ -29,17 +34,122 @@ typedef raft_status_t raft_request_vote_response_rpc_f(
     raft_request_vote_response_args_t*
 );
 
+/* Pre-votes reuse the RequestVote arguments. The term is the one the
+ * candidate would campaign in. */
+typedef raft_status_t raft_pre_vote_rpc_f(
+    raft_nodeid_t,
+    raft_request_vote_args_t*
+);
+
+typedef raft_status_t raft_pre_vote_response_rpc_f(
+    raft_nodeid_t,
+    raft_request_vote_response_args_t*
+);
+
+typedef raft_status_t raft_timeout_now_rpc_f(
+    raft_nodeid_t,
+    raft_timeout_now_args_t*
+);
+
+typedef raft_status_t raft_read_index_rpc_f(
+    raft_nodeid_t,
+    raft_read_index_args_t*
+);
+
+typedef raft_status_t raft_read_index_response_rpc_f(
+    raft_nodeid_t,
+    raft_read_index_response_args_t*
+);
+
+typedef raft_status_t raft_fragment_rpc_f(
+    raft_nodeid_t,
+    raft_fragment_args_t*
+);
+
+typedef raft_status_t raft_fragment_response_rpc_f(
+    raft_nodeid_t,
+    raft_fragment_response_args_t*
+);
+
+/**
+ * Must durably store the term and vote before returning, see
+ * raft_hard_state_save().
+ */
+typedef raft_status_t raft_persist_hard_state_f(
+    raft_term_t current_term,
+    raft_nodeid_t voted_for
+);
+
+/**
+ * Invoked, in log order, for each entry once it has been committed.
+ */
+typedef raft_status_t raft_apply_log_entry_f(
+    raft_index_t index,
+    raft_log_entry_t const* p_entry
+);
+
+typedef enum {
+  /* The entry is committed. */
+  RAFT_PROPOSAL_COMMITTED,
+  /* The entry has been applied. This is the last notification. */
+  RAFT_PROPOSAL_APPLIED,
+  /* Leadership was lost before the entry committed. It may still be
+   * committed by a later leader. This is the last notification. */
+  RAFT_PROPOSAL_FAILED,
+} raft_proposal_event_t;
+
+/**
+ * Completion for an entry proposed through raft_append().
+ */
+typedef void raft_proposal_f(
+    void* p_context,
+    raft_index_t index,
+    uint32_t unique_id,
+    raft_proposal_event_t event
+);
+
+/**
+ * Completion for raft_read_index(). On RAFT_STATUS_OK every entry up to
+ * read_index has been applied and local state may be read linearizably.
+ */
+typedef void raft_read_f(
+    void* p_context,
+    raft_index_t read_index,
+    raft_status_t status
+);
+
 typedef struct {
   /**
    *
    */
   raft_send_message_f* pf_send_message;
 
+  raft_apply_log_entry_f* pf_apply_log_entry;
+
+  /**
+   * Called with the new term and vote before any message that follows a
+   * change to them is sent. Changes made in one step are stored together.
+   */
+  raft_persist_hard_state_f* pf_persist_hard_state;
+
   raft_append_entries_rpc_f*          pf_append_entries_rpc;
   raft_append_entries_response_rpc_f* pf_append_entries_response_rpc;
 
+  raft_heartbeat_rpc_f* pf_heartbeat_rpc;
+
   raft_request_vote_rpc_f*          pf_request_vote_rpc;
   raft_request_vote_response_rpc_f* pf_request_vote_response_rpc;
+
+  raft_pre_vote_rpc_f*          pf_pre_vote_rpc;
+  raft_pre_vote_response_rpc_f* pf_pre_vote_response_rpc;
+
+  raft_timeout_now_rpc_f* pf_timeout_now_rpc;
+
+  raft_read_index_rpc_f*          pf_read_index_rpc;
+  raft_read_index_response_rpc_f* pf_read_index_response_rpc;
+
+  raft_fragment_rpc_f*          pf_fragment_rpc;
+  raft_fragment_response_rpc_f* pf_fragment_response_rpc;
 } raft_callbacks_t;
 
 #endif
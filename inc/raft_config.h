@@ -3,18 +3,153 @@
 
 #include "raft_callbacks.h"
 
+/**
+ * A node's voting weight and election priority, see raft_config_t.
+ */
+typedef struct {
+  raft_nodeid_t id;
+  uint32_t      vote_weight;
+  uint32_t      priority;
+} raft_node_preference_t;
+
 typedef struct raft_config {
   raft_nodeid_t selfid;
 
+  /**
+   * The initial configuration: this node and the node_count - 1 others.
+   * Configuration entries in the log take precedence, see
+   * raft_change_membership().
+   */
   uint32_t       node_count;
   raft_nodeid_t* p_nodeids;
 
+  /**
+   * Nodes among the above that start as learners. Learners receive the log
+   * but neither vote nor count towards the commit quorum, and never campaign.
+   */
+  uint32_t       learner_count;
+  raft_nodeid_t* p_learner_ids;
+
+  /**
+   * Nodes among the above that are witnesses. Witnesses vote and acknowledge
+   * entries like any voter, but are sent and store user entries without
+   * their data, apply nothing, and never campaign. Membership changes keep
+   * a node's witness status.
+   */
+  uint32_t       witness_count;
+  raft_nodeid_t* p_witness_ids;
+
   raft_callbacks_t cb;
 
+  /**
+   * The term and vote last persisted, through pf_persist_hard_state or a
+   * raft_ready() batch, to restart from. See raft_hard_state_open().
+   */
+  raft_term_t   initial_term;
+  raft_nodeid_t initial_voted_for;
+
+  /**
+   * When set, outbound messages, entries to persist and committed entries are
+   * collected and handed out through raft_ready() instead of being passed to
+   * the callbacks as they are produced.
+   */
+  raft_bool_t use_ready;
+
   uint32_t leader_ping_interval_ms;
 
   uint32_t election_timeout_max_ms;
   uint32_t election_timeout_min_ms;
+
+  /**
+   * Leader leases. A leader whose heartbeat was acknowledged by a majority
+   * may serve reads locally until election_timeout_min_ms - lease_drift_ms
+   * after sending it. lease_drift_ms must cover clock drift between nodes
+   * and how late raft_tick() may run. Followers ignore candidates while
+   * they hear from a leader.
+   */
+  raft_bool_t lease_reads;
+  uint32_t    lease_drift_ms;
+
+  /**
+   * Pre-vote. A node whose election timeout elapses first asks the others
+   * whether they would vote for it in the next term, and only bumps its term
+   * and campaigns once a majority agrees. Nodes that have heard from a
+   * leader within election_timeout_min_ms refuse, so a node rejoining from a
+   * partition cannot depose a healthy leader.
+   */
+  raft_bool_t pre_vote;
+
+  /**
+   * CheckQuorum. A leader that has not heard from a majority within
+   * election_timeout_min_ms steps down, so clients stop waiting on a leader
+   * that cannot commit.
+   */
+  raft_bool_t check_quorum;
+
+  /**
+   * Flexible quorums. Commits, and the acknowledgements behind leases,
+   * ReadIndex and CheckQuorum, need replication_quorum voters; elections
+   * need election_quorum votes. The two must intersect, so their sum must
+   * exceed the number of voters (their total weight, see p_preferences),
+   * and election_quorum must be more than half of them so that no two
+   * leaders are elected in one term. Left at 0, a size is the smallest that
+   * meets these, or a majority if both are 0. The sizes apply to every
+   * configuration, and membership changes they do not fit are refused.
+   */
+  uint32_t replication_quorum;
+  uint32_t election_quorum;
+
+  /**
+   * Voting weights and election priorities, which every node must agree on.
+   * Votes and acknowledgements count for their node's weight, quorums are
+   * weighed against the voters' total and quorum sizes above are given in
+   * weight. Higher priority nodes draw their election timeouts from an
+   * earlier part of the election timeout range, so they campaign first.
+   * Unlisted nodes have weight 1 and priority 0.
+   */
+  uint32_t                preference_count;
+  raft_node_preference_t* p_preferences;
+
+  /**
+   * Adaptive election timeouts. The leader times the first message it sends
+   * each follower per heartbeat round, as resolved by raft_tick()'s clock,
+   * and advertises to each a window starting at twice
+   * leader_ping_interval_ms plus four times the 99th percentile of that
+   * follower's recent round trips. Followers draw their election
+   * timeouts from that window, up to twice its start, but never from one
+   * narrower than half its start or reaching past election_timeout_max_ms.
+   * The window may start as low as election_timeout_floor_ms, or
+   * election_timeout_min_ms when that is zero. Until a leader advertises
+   * one, the whole configured range is used.
+   */
+  raft_bool_t adaptive_election_timeout;
+  uint32_t    election_timeout_floor_ms;
+
+  /**
+   * Relay replication. When nonzero, the leader sends entries to at most
+   * relay_fanout followers, which forward them down a tree of the others
+   * with the same fanout. Only followers at the same next index as the
+   * first one are relayed to; lagging followers and witnesses are sent to
+   * directly. Followers acknowledge to the leader directly. Every node
+   * must agree on the fanout.
+   */
+  uint32_t relay_fanout;
+
+  /**
+   * Erasure-coded replication. User entries of at least erasure_min_size
+   * bytes are split into erasure_fragments data fragments plus parity, and
+   * each follower is sent only the fragment numbered its id - 1. Such an
+   * entry commits once enough nodes hold a fragment that every election
+   * quorum holds erasure_fragments of them, so a later leader can recover
+   * it. Entries are replicated whole while fewer nodes are live, and in
+   * configurations that are joint or weighted. Followers store their
+   * fragment, and gather erasure_fragments fragments from the others to
+   * rebuild the entry before applying it. A new leader rebuilds every entry
+   * it holds only a fragment of before replicating past it, and drops those
+   * too few nodes hold to have committed.
+   */
+  uint32_t erasure_fragments;
+  uint32_t erasure_min_size;
 } raft_config_t;
 
 #endif
@@ -0,0 +1,61 @@
+#ifndef __RAFT_ELECTION_H__
+#define __RAFT_ELECTION_H__
+
+#include "raft_types.h"
+
+typedef struct raft_state raft_state_t;
+
+/**
+ * Called when the election timeout elapses. With raft_config_t.pre_vote the
+ * node first becomes a pre-candidate and asks whether it could win without
+ * touching its term; otherwise it campaigns straight away.
+ */
+raft_status_t raft_begin_election(raft_state_t* p_state);
+
+/**
+ * Becomes a candidate for the next term and requests votes from every other
+ * node. leadership_transfer marks an election asked for by the leader.
+ */
+raft_status_t raft_campaign(raft_state_t* p_state,
+                            raft_bool_t leadership_transfer);
+
+/**
+ * Becomes leader of the current term and establishes leadership with a
+ * heartbeat.
+ */
+raft_status_t raft_promote_to_leader(raft_state_t* p_state);
+
+/**
+ * Sends TimeoutNow to the leadership transfer target once its log matches
+ * the leader's.
+ */
+raft_status_t raft_transfer_check(raft_state_t* p_state);
+
+/**
+ * With raft_config_t.check_quorum, steps the leader down if it has not heard
+ * from a majority within election_timeout_min_ms.
+ */
+raft_status_t raft_check_quorum(raft_state_t* p_state);
+
+/**
+ * Notes that a message of the current heartbeat round is going out to
+ * follower_id, for raft_config_t.adaptive_election_timeout. The first one
+ * sent each round is timed, unless an earlier one is still unanswered.
+ */
+void raft_election_rtt_sent(raft_state_t* p_state, raft_nodeid_t follower_id);
+
+/**
+ * Samples the round trip of the message timed to follower_id if seq is its
+ * round, and updates the election timeout hint follower_id is sent.
+ */
+void raft_election_rtt_ack(raft_state_t* p_state,
+                           raft_nodeid_t follower_id,
+                           uint32_t seq);
+
+/**
+ * Restarts the election timer with a new randomized timeout, earlier for
+ * nodes of higher priority.
+ */
+void raft_reset_election_timer(raft_state_t* p_state);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __RAFT_ERASURE_H__
+#define __RAFT_ERASURE_H__
+
+#include "raft_types.h"
+
+/**
+ * Systematic Reed-Solomon coding over GF(2^8). An entry is split into
+ * fragments_needed data fragments; fragment i below fragments_needed is the
+ * i-th of them, and fragments from there up to RAFT_ERASURE_MAX_FRAGMENTS
+ * are parity. Any fragments_needed distinct fragments recover the entry.
+ */
+#define RAFT_ERASURE_MAX_FRAGMENTS 256
+
+/**
+ * Size of each fragment of a size byte entry.
+ */
+uint32_t raft_erasure_fragment_size(uint32_t size, uint32_t fragments_needed);
+
+/**
+ * Writes fragment fragment_index of the entry in p_data to p_fragment, which
+ * must hold raft_erasure_fragment_size() bytes.
+ */
+void raft_erasure_encode(void const* p_data,
+                         uint32_t size,
+                         uint32_t fragments_needed,
+                         uint32_t fragment_index,
+                         void* p_fragment);
+
+/**
+ * Recovers the size byte entry in p_data from fragments_needed fragments,
+ * the i-th of which is fragment pp_fragments[i] of index p_indexes[i].
+ * Returns RAFT_STATUS_INVALID_ARGS if an index repeats or is out of range.
+ */
+raft_status_t raft_erasure_decode(void const* const* pp_fragments,
+                                  uint32_t const* p_indexes,
+                                  uint32_t fragments_needed,
+                                  uint32_t size,
+                                  void* p_data);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef __RAFT_HARD_STATE_H__
+#define __RAFT_HARD_STATE_H__
+
+#include "raft_types.h"
+
+/**
+ * A node's term and vote, the state raft's safety depends on surviving a
+ * restart.
+ */
+typedef struct {
+  raft_term_t   current_term;
+  raft_nodeid_t voted_for;
+} raft_hard_state_t;
+
+/**
+ * The hard state file holds two slots of RAFT_HARD_STATE_SIZE bytes, written
+ * alternately, each with a sequence number and checksum. A torn write
+ * damages only the slot being written, and the other still holds the
+ * previous state.
+ */
+#define RAFT_HARD_STATE_SIZE 32
+
+/**
+ * Writes the slot for the sequence-th update.
+ */
+void raft_hard_state_encode(raft_hard_state_t const* p_hard_state,
+                            uint64_t sequence,
+                            uint8_t* p_slot);
+
+/**
+ * Reads a slot. Returns RAFT_STATUS_INVALID_MESSAGE if it was never written
+ * or its checksum does not match.
+ */
+raft_status_t raft_hard_state_decode(uint8_t const* p_slot,
+                                     raft_hard_state_t* p_hard_state,
+                                     uint64_t* p_sequence);
+
+typedef struct raft_hard_state_file raft_hard_state_file_t;
+
+/**
+ * Opens the hard state file at p_path, creating it if needed, and loads
+ * the latest intact state into p_hard_state (zero for a new file). Writes
+ * go through O_DSYNC, so each update is a single synchronous 32-byte write
+ * with no separate fsync. Returns RAFT_STATUS_IO_ERROR if the file holds
+ * data but neither slot is intact.
+ */
+raft_status_t raft_hard_state_open(char const* p_path,
+                                   raft_hard_state_file_t** pp_file,
+                                   raft_hard_state_t* p_hard_state);
+
+/**
+ * Durably stores the hard state, overwriting the older slot. Suits
+ * pf_persist_hard_state, or a raft_ready() batch whose hard state changed,
+ * written alongside its entries.
+ */
+raft_status_t raft_hard_state_save(raft_hard_state_file_t* p_file,
+                                   raft_hard_state_t const* p_hard_state);
+
+void raft_hard_state_close(raft_hard_state_file_t* p_file);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef __RAFT_LEASE_H__
+#define __RAFT_LEASE_H__
+
+#include "raft_types.h"
+
+typedef struct raft_state raft_state_t;
+
+/**
+ * Begins tracking leases for a new term. Acknowledgements of rounds sent
+ * before this point are ignored.
+ */
+void raft_lease_start(raft_state_t* p_state);
+
+/**
+ * Records the send time of heartbeat round seq.
+ */
+void raft_lease_sent(raft_state_t* p_state, uint32_t seq);
+
+/**
+ * Extends follower_id's part of the lease to cover round seq.
+ */
+void raft_lease_ack(raft_state_t* p_state,
+                    raft_nodeid_t follower_id,
+                    uint32_t seq);
+
+/**
+ * Returns RAFT_TRUE while a majority's acknowledgements keep the lease
+ * alive.
+ */
+raft_bool_t raft_lease_valid(raft_state_t const* p_state);
+
+/**
+ * Gives up the lease. Called on step-down.
+ */
+void raft_lease_drop(raft_state_t* p_state);
+
+#endif
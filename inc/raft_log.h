@@ -15,9 +15,20 @@ typedef struct raft_log_entry {
   void*  p_data;
   uint32_t data_size;
 
+  /* Erasure-coded user entries, see raft_config_t.erasure_fragments, have
+   * nonzero fragments_needed. coded_size is the size of the whole entry;
+   * nodes other than its leader hold only fragment fragment_index of it in
+   * p_data until they rebuild it, and the leader holds it whole as
+   * RAFT_FRAGMENT_WHOLE. */
+  uint32_t coded_size;
+  uint16_t fragments_needed;
+  uint16_t fragment_index;
+
   uint32_t replication_count;
 } raft_log_entry_t;
 
+#define RAFT_FRAGMENT_WHOLE 0xffff
+
 typedef struct raft_log raft_log_t;
 
 raft_log_t* raft_log_alloc();
@@ -28,14 +39,62 @@ uint32_t raft_log_length(raft_log_t const* p_log);
 
 raft_log_entry_t const* raft_log_entry(raft_log_t const* p_log, int32_t index);
 
+/**
+ * Appends a user entry, taking ownership of p_data. Payloads are copied into
+ * the log's own storage and p_data is freed at once, so the entry's p_data
+ * is not the pointer passed in.
+ */
 raft_status_t raft_log_append_user(raft_log_t* p_log,
                                    uint32_t unique_id,
                                    raft_term_t term,
                                    void* p_data,
                                    uint32_t data_size);
 
+/**
+ * Like raft_log_append_user(), for an entry the leader replicates as
+ * fragments_needed out of one erasure-coded fragment per node.
+ */
+raft_status_t raft_log_append_coded(raft_log_t* p_log,
+                                    uint32_t unique_id,
+                                    raft_term_t term,
+                                    void* p_data,
+                                    uint32_t data_size,
+                                    uint32_t fragments_needed);
+
+/**
+ * Appends copies of the given entries (including their data) to the log.
+ */
 raft_status_t raft_log_append(raft_log_t* p_log,
-                              raft_log_entry_t* p_entries,
+                              raft_log_entry_t const* p_entries,
                               uint32_t num_entries);
 
+/**
+ * Like raft_log_append(), but keeps only the metadata of user entries: they
+ * retain their data_size but have no p_data. Used by witnesses.
+ */
+raft_status_t raft_log_append_metadata(raft_log_t* p_log,
+                                       raft_log_entry_t const* p_entries,
+                                       uint32_t num_entries);
+
+/**
+ * Replaces the fragment held for the erasure-coded entry at index with a
+ * copy of the whole entry, coded_size bytes at p_data.
+ */
+raft_status_t raft_log_restore(raft_log_t* p_log,
+                               raft_index_t index,
+                               void const* p_data);
+
+/**
+ * Removes every entry at or after index, freeing their data.
+ */
+void raft_log_truncate(raft_log_t* p_log, raft_index_t index);
+
+/**
+ * Points *pp_entries at the entry at index and returns the number of entries
+ * stored contiguously from there, or 0 if index is past the end of the log.
+ */
+uint32_t raft_log_entries(raft_log_t const* p_log,
+                          raft_index_t index,
+                          raft_log_entry_t const** pp_entries);
+
 #endif
@@ -0,0 +1,151 @@
+#ifndef __RAFT_MEMBERSHIP_H__
+#define __RAFT_MEMBERSHIP_H__
+
+#include "raft_types.h"
+
+typedef struct raft_state raft_state_t;
+typedef struct raft_config raft_config_t;
+
+/**
+ * Role bits of a node in a configuration. While joint, the _NEW bits give
+ * the configuration being moved to and the others the one being left.
+ */
+#define RAFT_ROLE_MEMBER     0x1
+#define RAFT_ROLE_VOTER      0x2
+#define RAFT_ROLE_MEMBER_NEW 0x4
+#define RAFT_ROLE_VOTER_NEW  0x8
+
+/**
+ * Witnesses vote and acknowledge entries but keep only their metadata, and
+ * never lead. The bit holds across both halves of a joint configuration.
+ */
+#define RAFT_ROLE_WITNESS    0x10
+
+typedef struct {
+  raft_nodeid_t id;
+  uint32_t      roles;
+} raft_member_t;
+
+/**
+ * Weight of the votes or acknowledgements towards a quorum, counted
+ * separately for the old and new halves of a joint configuration.
+ */
+typedef struct {
+  uint32_t a_votes[2];
+} raft_tally_t;
+
+/**
+ * Adopts the initial configuration given by raft_config_t.
+ */
+raft_status_t raft_membership_init(raft_state_t* p_state);
+
+void raft_membership_free(raft_state_t* p_state);
+
+/**
+ * Makes p_members the active configuration, growing the per-node arrays to
+ * cover every id in it. Nodes new to a leader start replicating from the
+ * end of its log.
+ */
+raft_status_t raft_membership_apply(raft_state_t* p_state,
+                                    raft_member_t const* p_members,
+                                    uint32_t num_members);
+
+/**
+ * Appends the joint configuration that moves to the given voters and
+ * learners. The final configuration follows once it commits.
+ */
+raft_status_t raft_membership_propose(raft_state_t* p_state,
+                                      raft_nodeid_t const* p_voter_ids,
+                                      uint32_t voter_count,
+                                      raft_nodeid_t const* p_learner_ids,
+                                      uint32_t learner_count);
+
+/**
+ * Whether a configuration entry has yet to commit or be followed by the
+ * final configuration.
+ */
+raft_bool_t raft_membership_changing(raft_state_t const* p_state);
+
+/**
+ * Adopts the latest configuration among the entries appended from index on.
+ * Configurations take effect when appended, committed or not.
+ */
+raft_status_t raft_membership_appended(raft_state_t* p_state,
+                                       raft_index_t index);
+
+/**
+ * Falls back to the latest configuration left in the log after it was
+ * truncated at index.
+ */
+raft_status_t raft_membership_truncated(raft_state_t* p_state,
+                                        raft_index_t index);
+
+/**
+ * Called on the leader as its commit index advances. Appends the final
+ * configuration once the joint one commits, and steps down once a final
+ * configuration without this node as a voter commits.
+ */
+void raft_membership_committed(raft_state_t* p_state);
+
+raft_bool_t raft_membership_is_member(raft_state_t const* p_state,
+                                      raft_nodeid_t node_id);
+
+/**
+ * Whether node_id votes in either half of the configuration.
+ */
+raft_bool_t raft_membership_is_voter(raft_state_t const* p_state,
+                                     raft_nodeid_t node_id);
+
+/**
+ * node_id's voting weight according to raft_config_t.p_preferences.
+ */
+uint32_t raft_membership_node_weight(raft_config_t const* p_config,
+                                     raft_nodeid_t node_id);
+
+raft_bool_t raft_membership_is_witness(raft_state_t const* p_state,
+                                       raft_nodeid_t node_id);
+
+/**
+ * Whether node_id may campaign: a voter that is not a witness.
+ */
+raft_bool_t raft_membership_can_lead(raft_state_t const* p_state,
+                                     raft_nodeid_t node_id);
+
+/**
+ * Counts node_id's weight towards each half of the configuration it votes
+ * in.
+ */
+void raft_tally_add(raft_state_t const* p_state,
+                    raft_tally_t* p_tally,
+                    raft_nodeid_t node_id);
+
+/**
+ * Whether the tally holds a replication quorum of the voters, or of both
+ * halves' voters while joint.
+ */
+raft_bool_t raft_tally_is_quorum(raft_state_t const* p_state,
+                                 raft_tally_t const* p_tally);
+
+/**
+ * Whether the votes in the ballot make up an election quorum.
+ */
+raft_bool_t raft_membership_ballot_won(raft_state_t const* p_state);
+
+/**
+ * Number of nodes that must hold a fragment of an entry coded into
+ * fragments_needed data fragments before it commits, so that every
+ * election quorum holds enough to recover it. 0 if the configuration
+ * cannot commit coded entries: while joint, with weighted voters or with
+ * elections needing fewer than fragments_needed votes.
+ */
+uint32_t raft_membership_coded_quorum(raft_state_t const* p_state,
+                                      uint32_t fragments_needed);
+
+/**
+ * Whether node_id counts towards raft_membership_coded_quorum(): a voter
+ * that is not a witness.
+ */
+raft_bool_t raft_membership_holds_fragment(raft_state_t const* p_state,
+                                           raft_nodeid_t node_id);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __RAFT_PROPOSAL_H__
+#define __RAFT_PROPOSAL_H__
+
+#include "raft_callbacks.h"
+
+typedef struct raft_state raft_state_t;
+
+typedef struct raft_proposal {
+  raft_proposal_f* pf_completion;
+  void*            p_context;
+  uint32_t         unique_id;
+} raft_proposal_t;
+
+/**
+ * Tracks a completion for the entry the leader just appended at index.
+ * Pending proposals form a ring indexed by log index, so resolving one is
+ * O(1).
+ */
+raft_status_t raft_proposals_push(raft_state_t* p_state,
+                                  raft_index_t index,
+                                  raft_proposal_t const* p_proposal);
+
+/**
+ * Forgets the proposal pushed for index, if any, without notifying it.
+ */
+void raft_proposals_cancel(raft_state_t* p_state, raft_index_t index);
+
+/**
+ * Notifies proposals at or below commit_index that have not yet been
+ * reported committed.
+ */
+void raft_proposals_committed(raft_state_t* p_state);
+
+/**
+ * Notifies and releases proposals at or below last_applied.
+ */
+void raft_proposals_applied(raft_state_t* p_state);
+
+/**
+ * Fails every uncommitted proposal. Called when leadership is lost.
+ */
+void raft_proposals_fail(raft_state_t* p_state);
+
+void raft_proposals_free(raft_state_t* p_state);
+
+#endif
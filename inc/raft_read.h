@@ -0,0 +1,65 @@
+#ifndef __RAFT_READ_H__
+#define __RAFT_READ_H__
+
+#include "raft_callbacks.h"
+
+typedef struct raft_state raft_state_t;
+
+typedef struct raft_read {
+  raft_read_f* pf_read;
+  void*        p_context;
+  raft_index_t read_index;
+
+  /* The heartbeat round, or on a follower the read index request, that
+   * confirms this read. */
+  uint32_t     seq;
+
+  /* Set on the leader for reads on behalf of a follower, which are answered
+   * with a read index response instead of pf_read. */
+  raft_nodeid_t requester_id;
+  uint32_t      request_id;
+} raft_read_t;
+
+/**
+ * Queues a copy of p_read for the next confirmation round, and starts that
+ * round unless one is already in flight. On the leader the read waits behind
+ * the current commit index; on a follower, behind the index the leader
+ * returns.
+ */
+raft_status_t raft_reads_push(raft_state_t* p_state,
+                              raft_read_t const* p_read);
+
+/**
+ * Records that follower_id acknowledged heartbeat round seq, and confirms
+ * rounds acknowledged by a majority.
+ */
+void raft_reads_ack(raft_state_t* p_state,
+                    raft_nodeid_t follower_id,
+                    uint32_t seq);
+
+/**
+ * Starts a confirmation round for queued reads if none is in flight. Inside
+ * raft_recv_messages() this waits for the end of the batch so that every
+ * read in the batch shares one round.
+ */
+raft_status_t raft_reads_start(raft_state_t* p_state);
+
+/**
+ * Resends a follower's outstanding read index request, e.g. after it was
+ * lost on the way to the leader.
+ */
+raft_status_t raft_reads_retry(raft_state_t* p_state);
+
+/**
+ * Releases confirmed reads whose read index has been applied.
+ */
+void raft_reads_release(raft_state_t* p_state);
+
+/**
+ * Fails every queued read. Called when leadership or the term changes.
+ */
+void raft_reads_fail(raft_state_t* p_state);
+
+void raft_reads_free(raft_state_t* p_state);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef __RAFT_READY_H__
+#define __RAFT_READY_H__
+
+#include "raft_types.h"
+#include "raft_wire.h"
+
+typedef struct raft_state raft_state_t;
+
+/**
+ * Everything a node produced since the last raft_advance(), for embedders
+ * that set raft_config_t.use_ready.
+ *
+ * The hard state and the entries in [first_persist_index,
+ * first_persist_index + num_persist_entries) must be made durable before
+ * the messages are sent; raft_hard_state_save() stores the former with a
+ * single synchronous write. Any previously stored entries at or after
+ * first_persist_index are superseded. The entries in [first_apply_index,
+ * first_apply_index + num_apply_entries) are committed and may be applied.
+ */
+typedef struct {
+  raft_envelope_t* p_messages;
+  uint32_t         num_messages;
+
+  raft_bool_t   hard_state_changed;
+  raft_term_t   current_term;
+  raft_nodeid_t voted_for;
+
+  raft_index_t first_persist_index;
+  uint32_t     num_persist_entries;
+
+  raft_index_t first_apply_index;
+  uint32_t     num_apply_entries;
+} raft_ready_t;
+
+/**
+ * Returns RAFT_TRUE if raft_ready() would return a non-empty batch.
+ */
+raft_bool_t raft_has_ready(raft_state_t const* p_state);
+
+/**
+ * Collects the pending batch. The messages are owned by p_ready until it is
+ * passed to raft_advance().
+ */
+raft_status_t raft_ready(raft_state_t* p_state, raft_ready_t* p_ready);
+
+/**
+ * Acknowledges that the batch has been persisted, sent and applied, and
+ * releases its messages. Must be called before the node is stepped again.
+ */
+raft_status_t raft_advance(raft_state_t* p_state, raft_ready_t* p_ready);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef __RAFT_RECOVERY_H__
+#define __RAFT_RECOVERY_H__
+
+#include "raft_types.h"
+
+typedef struct raft_state raft_state_t;
+typedef struct raft_log_entry raft_log_entry_t;
+
+/**
+ * Whether this node holds only a fragment of the erasure-coded entry, which
+ * must be rebuilt before it is applied or replicated.
+ */
+raft_bool_t raft_recovery_needed(raft_log_entry_t const* p_entry);
+
+/**
+ * Starts rebuilding the entry at index from the other nodes' fragments. If
+ * that is already underway, asks again those yet to answer, at most once
+ * per leader_ping_interval_ms.
+ */
+raft_status_t raft_recovery_start(raft_state_t* p_state, raft_index_t index);
+
+/**
+ * Called on a new leader, which rebuilds every entry after last_applied
+ * that it holds only a fragment of, in order. Entries that could not have
+ * committed, since too many nodes lack them, are dropped instead.
+ */
+raft_status_t raft_recovery_promoted(raft_state_t* p_state);
+
+/**
+ * Asks again the nodes yet to answer, or retries rebuilding from the
+ * fragments in hand, if an entry is being rebuilt.
+ */
+raft_status_t raft_recovery_retry(raft_state_t* p_state);
+
+/**
+ * Index of the entry being rebuilt, before which a leader's log may be
+ * replicated, or the length of the log.
+ */
+raft_index_t raft_recovery_limit(raft_state_t const* p_state);
+
+/**
+ * Abandons the rebuild if the log was truncated at or before its entry.
+ */
+void raft_recovery_truncated(raft_state_t* p_state, raft_index_t index);
+
+void raft_recovery_free(raft_state_t* p_state);
+
+#endif
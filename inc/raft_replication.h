@@ -0,0 +1,72 @@
+#ifndef __RAFT_REPLICATION_H__
+#define __RAFT_REPLICATION_H__
+
+#include "raft_types.h"
+#include "raft_rpc.h"
+
+typedef struct raft_state raft_state_t;
+
+/**
+ * Sends the entries the follower is missing, or a heartbeat if it has them
+ * all, and advances its next_index optimistically. Deferred to the end of
+ * the batch inside raft_recv_messages(). Followers known to have matched the
+ * whole log get a raft_heartbeat_args_t rather than an empty AppendEntries.
+ */
+raft_status_t raft_replicate_to(raft_state_t* p_state,
+                                raft_nodeid_t follower_id);
+
+/**
+ * raft_replicate_to() every other node in the cluster, or through relays
+ * when raft_config_t.relay_fanout is set.
+ */
+raft_status_t raft_replicate(raft_state_t* p_state);
+
+/**
+ * Forwards an AppendEntries this node was sent as a relay to the subtrees
+ * below it.
+ */
+raft_status_t raft_relay(raft_state_t* p_state,
+                         raft_append_entries_args_t* p_args);
+
+/**
+ * Starts a new heartbeat round and raft_replicate()s it. Acknowledgements of
+ * the round confirm leadership for reads and leases.
+ */
+raft_status_t raft_heartbeat(raft_state_t* p_state);
+
+/**
+ * raft_tick()'s heartbeat: starts a round like raft_heartbeat(), but skips
+ * followers sent AppendEntries within leader_ping_interval_ms, which already
+ * keeps them from campaigning. They acknowledge the round with whatever
+ * they are sent next.
+ */
+raft_status_t raft_heartbeat_idle(raft_state_t* p_state);
+
+/**
+ * Advances the leader's commit_index to the highest entry of the current
+ * term stored on a majority of the cluster. Deferred to the end of the batch
+ * inside raft_recv_messages().
+ */
+void raft_advance_commit_index(raft_state_t* p_state);
+
+/**
+ * Finds the first erasure-coded entry past commit_index, from which
+ * raft_advance_commit_index() checks fragments are held. Called when the
+ * leader's log changes other than by appending to it.
+ */
+void raft_find_coded(raft_state_t* p_state);
+
+/**
+ * Appends an empty entry of the current term. Once it commits, the commit
+ * index covers every earlier leader's entries, so reads and leases can rely
+ * on it (Raft section 8). Appended on taking office.
+ */
+raft_status_t raft_append_noop(raft_state_t* p_state);
+
+/**
+ * Applies committed entries through pf_apply_log_entry. Does nothing when
+ * outputs are collected through raft_ready() or inside a batch.
+ */
+raft_status_t raft_apply_committed(raft_state_t* p_state);
+
+#endif
@@ -13,6 +13,17 @@ raft_status_t raft_recv_message(raft_state_t* p_state,
                                 void* p_message_bytes,
                                 uint32_t buffer_size);
 
+/**
+ * Receives a batch of messages and coalesces the work they set off: the
+ * commit index is recomputed once, and each peer gets at most one
+ * AppendEntries and one AppendEntries response once the batch is done.
+ * Every message is processed; the first failure is returned.
+ */
+raft_status_t raft_recv_messages(raft_state_t* p_state,
+                                 void** pp_message_bytes,
+                                 uint32_t const* p_buffer_sizes,
+                                 uint32_t num_messages);
+
 typedef struct {
   raft_term_t        term;
   raft_nodeid_t      leader_id;
@@ -21,6 +32,20 @@ typedef struct {
   raft_log_entry_t*  p_log_entries;
   uint32_t           num_entries;
   uint32_t           leader_commit;
+
+  /* Leader-assigned sequence number, echoed in the response. */
+  uint32_t           seq;
+
+  /* Start of the leader's measured election timeout window, or 0. */
+  uint32_t           election_timeout_hint_ms;
+
+  /* User entries are sent without their data, for witnesses. */
+  raft_bool_t        metadata_only;
+
+  /* Nodes the recipient forwards the message to, as a relay, see
+   * raft_config_t.relay_fanout. */
+  raft_nodeid_t*     p_relay_ids;
+  uint32_t           num_relay_ids;
 } raft_append_entries_args_t;
 
 raft_status_t
@@ -35,18 +60,41 @@ typedef struct {
 
   raft_index_t acknowledged_log_index;
   raft_index_t acknowledged_log_term;
+
+  uint32_t seq;
 } raft_append_entries_response_args_t;
 
 raft_status_t
 raft_recv_append_entries_response(raft_state_t* p_state,
                                   raft_append_entries_response_args_t* p_args);
 
+/**
+ * An AppendEntries without entries or a log position, sent in its place to
+ * followers known to hold the leader's whole log. It is answered with an
+ * AppendEntries response that acknowledges the commit index.
+ */
+typedef struct {
+  raft_term_t   term;
+  raft_nodeid_t leader_id;
+  raft_index_t  leader_commit;
+  uint32_t      seq;
+  uint32_t      election_timeout_hint_ms;
+} raft_heartbeat_args_t;
+
+raft_status_t
+raft_recv_heartbeat(raft_state_t* p_state,
+                    raft_heartbeat_args_t* p_args);
+
 
 typedef struct {
   raft_term_t   term;
   raft_nodeid_t candidate_id;
   raft_index_t  last_log_index;
   raft_term_t   last_log_term;
+
+  /* Set when the leader handed over through TimeoutNow. Voters then grant
+   * the vote even while they still hear from that leader. */
+  raft_bool_t   leadership_transfer;
 } raft_request_vote_args_t;
 
 raft_status_t
@@ -64,4 +112,90 @@ raft_status_t
 raft_recv_request_vote_response(raft_state_t* p_state,
                                 raft_request_vote_response_args_t* p_args);
 
+/**
+ * PreVote carries the same arguments and response as RequestVote, with the
+ * term the candidate would campaign in. Granting a pre-vote changes neither
+ * the voter's term nor its vote.
+ */
+raft_status_t
+raft_recv_pre_vote(raft_state_t* p_state,
+                   raft_request_vote_args_t* p_args);
+
+raft_status_t
+raft_recv_pre_vote_response(raft_state_t* p_state,
+                            raft_request_vote_response_args_t* p_args);
+
+/**
+ * Sent by a leader handing leadership over, once the target's log has caught
+ * up. The target campaigns immediately.
+ */
+typedef struct {
+  raft_term_t   term;
+  raft_nodeid_t leader_id;
+} raft_timeout_now_args_t;
+
+raft_status_t
+raft_recv_timeout_now(raft_state_t* p_state,
+                      raft_timeout_now_args_t* p_args);
+
+/**
+ * Sent by a follower to learn a read index from the leader. One request
+ * covers every read queued on the follower when it is sent.
+ */
+typedef struct {
+  raft_term_t   term;
+  raft_nodeid_t follower_id;
+  uint32_t      request_id;
+} raft_read_index_args_t;
+
+raft_status_t
+raft_recv_read_index(raft_state_t* p_state,
+                     raft_read_index_args_t* p_args);
+
+typedef struct {
+  raft_term_t  term;
+  uint32_t     request_id;
+  raft_bool_t  success;
+  raft_index_t read_index;
+} raft_read_index_response_args_t;
+
+raft_status_t
+raft_recv_read_index_response(raft_state_t* p_state,
+                              raft_read_index_response_args_t* p_args);
+
+/**
+ * Sent by a node holding only a fragment of the erasure-coded entry at
+ * index, see raft_config_t.erasure_fragments, to gather what it needs to
+ * rebuild the entry. entry_term tells the entry apart from others that
+ * were at the same index.
+ */
+typedef struct {
+  raft_nodeid_t sender_id;
+  raft_index_t  index;
+  raft_term_t   entry_term;
+} raft_fragment_args_t;
+
+raft_status_t
+raft_recv_fragment(raft_state_t* p_state,
+                   raft_fragment_args_t* p_args);
+
+/**
+ * Carries the sender's fragment of the entry, or the whole entry as
+ * RAFT_FRAGMENT_WHOLE, unless held is RAFT_FALSE because the sender does
+ * not have it. When read from a message, p_data points into the message.
+ */
+typedef struct {
+  raft_nodeid_t sender_id;
+  raft_index_t  index;
+  raft_term_t   entry_term;
+  raft_bool_t   held;
+  uint32_t      fragment_index;
+  void const*   p_data;
+  uint32_t      data_size;
+} raft_fragment_response_args_t;
+
+raft_status_t
+raft_recv_fragment_response(raft_state_t* p_state,
+                            raft_fragment_response_args_t* p_args);
+
 #endif
@@ -2,9 +2,18 @@
 #define __RAFT_STATE_H__
 
 #include "raft_types.h"
+#include "raft_wire.h"
 
 typedef struct raft_log raft_log_t;
 typedef struct raft_config raft_config_t;
+typedef struct raft_proposal raft_proposal_t;
+typedef struct raft_read raft_read_t;
+
+/* Heartbeat rounds whose send times are remembered for leases. */
+#define RAFT_LEASE_ROUND_HISTORY 16
+
+/* Round trips kept per follower for adaptive election timeouts. */
+#define RAFT_RTT_SAMPLE_COUNT 32
 
 typedef struct raft_state {
   raft_config_t* p_config;
@@ -30,8 +39,43 @@ typedef struct raft_state {
 
     uint32_t ms_since_last_leader_ping;
     uint32_t election_timeout_ms;
+
+    /* Leader of the current term, if known. */
+    raft_nodeid_t leader_id;
+
+    /* Time since raft_alloc(), as accumulated by raft_tick(). */
+    uint64_t clock_ms;
+
+    /* Election timeout window advertised by the leader, or 0. */
+    uint32_t election_timeout_hint_ms;
   } v;
 
+  /**
+   * Membership state.
+   */
+  struct {
+    /* Every per-node array covers ids 1 to capacity. */
+    uint32_t capacity;
+
+    /* RAFT_ROLE_* bits, indexed by node id - 1. */
+    uint8_t* p_roles;
+
+    /* Members other than this node. */
+    raft_nodeid_t* p_peers;
+    uint32_t peer_count;
+
+    /* Voting weight of each node, indexed by node id - 1. */
+    uint32_t* p_weights;
+
+    /* Total voting weight of the old and new halves of a joint
+     * configuration. */
+    uint32_t a_weights[2];
+    raft_bool_t joint;
+
+    /* Log index of the active configuration, 0 for raft_config_t's. */
+    raft_index_t config_index;
+  } m;
+
   /**
    * Leader state.
    */
@@ -40,11 +84,151 @@ typedef struct raft_state {
 
     raft_index_t* p_next_index;
     raft_index_t* p_match_index;
+
+    /* clock_ms of each follower's latest response in this term. */
+    uint64_t* p_last_ack_ms;
+
+    /* clock_ms before which raft_tick() need not ping each follower, as it
+     * was sent AppendEntries within leader_ping_interval_ms. */
+    uint64_t* p_ping_due_ms;
+
+    /* Followers raft_replicate() sends through relays. */
+    raft_nodeid_t* p_relay_ids;
+
+    /* The round timed to each follower, when its first message went out,
+     * and whether it is still unanswered. */
+    uint32_t*    p_rtt_seq;
+    uint64_t*    p_rtt_sent_ms;
+    raft_bool_t* p_rtt_pending;
+
+    /* RAFT_RTT_SAMPLE_COUNT recent round trips from each follower, and the
+     * election timeout hint each is sent. */
+    uint32_t* p_rtt_ms;
+    uint32_t* p_rtt_count;
+    uint32_t* p_hint_ms;
+
+    /* Leadership transfer in progress, see raft_transfer_leadership(). */
+    raft_nodeid_t transfer_id;
+    raft_bool_t   transfer_sent;
+    uint32_t      transfer_elapsed_ms;
+
+    /* First uncommitted erasure-coded entry, or 0 while there is none. */
+    raft_index_t first_coded_index;
+
+    /* The empty entry appended on taking office, see raft_append_noop(). */
+    raft_index_t noop_index;
   } l;
+
+  /**
+   * Ready state. Outputs accumulated until the next raft_ready() when
+   * p_config->use_ready is set. The persisted term and vote also track
+   * pf_persist_hard_state otherwise.
+   */
+  struct {
+    raft_envelope_t* p_messages;
+    uint32_t message_count;
+    uint32_t message_capacity;
+
+    raft_index_t  unstable_index;
+    raft_term_t   persisted_term;
+    raft_nodeid_t persisted_voted_for;
+  } r;
+
+  /**
+   * Proposal state. Completions for the leader's pending entries, held in a
+   * ring starting at first_index.
+   */
+  struct {
+    raft_proposal_t* p_slots;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t count;
+
+    raft_index_t first_index;
+    raft_index_t committed_index;
+  } q;
+
+  /**
+   * Read state. Queued ReadIndex requests and the heartbeat rounds that
+   * confirm them.
+   */
+  struct {
+    raft_read_t* p_reads;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t count;
+
+    uint32_t seq;
+    uint32_t confirmed_seq;
+    uint32_t* p_acked_seq;
+  } rd;
+
+  /**
+   * Lease state. When recent heartbeat rounds were sent, and how long each
+   * follower's acknowledgements keep the lease alive.
+   */
+  struct {
+    uint32_t first_seq;
+    uint64_t a_round_sent_ms[RAFT_LEASE_ROUND_HISTORY];
+    uint64_t* p_expiry_ms;
+  } ls;
+
+  /**
+   * Recovery state. The erasure-coded entry being rebuilt, which this node
+   * holds only a fragment of, the fragments gathered for it so far, and
+   * which nodes answered, by id - 1.
+   */
+  struct {
+    raft_index_t index;
+    raft_term_t  term;
+    uint64_t     sent_ms;
+
+    void**    pp_fragments;
+    uint32_t* p_indexes;
+    uint32_t  count;
+
+    raft_bool_t* p_answered;
+    uint32_t     answered_capacity;
+    uint32_t     lacking;
+  } rc;
+
+  /**
+   * Batch state. Work deferred until the end of raft_recv_messages().
+   */
+  struct {
+    raft_bool_t active;
+    raft_bool_t commit_dirty;
+
+    raft_bool_t* p_replicate;
+    raft_bool_t* p_respond;
+    raft_append_entries_response_args_t* p_responses;
+  } b;
 } raft_state_t;
 
 void raft_state_set_type(raft_state_t* p_state, raft_node_type_t type);
 
+/**
+ * Moves to a new term, forgetting the vote and leader of the old one.
+ */
+void raft_state_set_term(raft_state_t* p_state, raft_term_t term);
+
+/**
+ * Passes the term and vote to pf_persist_hard_state if they changed since it
+ * was last called. Senders call this first so that no message leaves ahead
+ * of the state it depends on; raft_ready() batches handle it themselves.
+ */
+raft_status_t raft_state_persist_hard_state(raft_state_t* p_state);
+
+/**
+ * Sends the envelope, or queues it for the next raft_ready() batch. Takes
+ * ownership of the envelope's buffer in the latter case.
+ */
+raft_status_t raft_state_send_envelope(raft_state_t* p_state,
+                                       raft_envelope_t* p_envelope);
+
+/**
+ * Votes in the ballot, counting only voters.
+ */
 uint32_t raft_state_vote_count(raft_state_t* p_state);
 
 #endif
@@ -11,6 +11,7 @@ typedef enum {
   RAFT_NODE_TYPE_LEADER,
   RAFT_NODE_TYPE_FOLLOWER,
   RAFT_NODE_TYPE_CANDIDATE,
+  RAFT_NODE_TYPE_PRE_CANDIDATE,
 } raft_node_type_t;
 
 typedef enum {
@@ -19,6 +20,11 @@ typedef enum {
   RAFT_STATUS_INVALID_TERM,
   RAFT_STATUS_INVALID_ARGS,
   RAFT_STATUS_INVALID_MESSAGE,
+  RAFT_STATUS_NOT_LEADER,
+  RAFT_STATUS_LEASE_EXPIRED,
+  RAFT_STATUS_TRANSFER_IN_PROGRESS,
+  RAFT_STATUS_CHANGE_IN_PROGRESS,
+  RAFT_STATUS_IO_ERROR,
 } raft_status_t;
 
 #define RAFT_SUCCESS(_status) ((_status) == RAFT_STATUS_OK)
@@ -33,12 +33,18 @@
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
-#define RAFT_LSBYTE(val, idx) (((val) >> (8*(idx))) % 0xff)
+#define RAFT_LSBYTE(val, idx) (((val) >> (8*(idx))) & 0xff)
 
 #define RAFT_ALIGN_UP(val, align) (((val) + ((align) - 1)) & (~((align) - 1)))
 
 void raft_sleep(uint32_t ms);
 
+/**
+ * CRC-32C (Castagnoli) of size bytes at p_data, continuing from crc; pass 0
+ * to start.
+ */
+uint32_t raft_crc32c(uint32_t crc, void const* p_data, uint32_t size);
+
 #define ARRAY_ELEMENT_COUNT(_arr) (sizeof(_arr) / sizeof(_arr[0]))
 
 #endif
@@ -0,0 +1,122 @@
+#ifndef __RAFT_WAL_H__
+#define __RAFT_WAL_H__
+
+#include "raft_log.h"
+
+/**
+ * A write-ahead log of entries kept as a directory of segment files, for
+ * embedders that persist raft_ready() batches. Each segment holds a run of
+ * consecutive entries and is named after the index of its first one. Once
+ * a segment reaches segment_size bytes it is synced and sealed: it is never
+ * written again and is read through a read-only mapping.
+ *
+ * Segment files are allocated and zero-filled to segment_size up front, so
+ * syncing appends to them flushes data blocks only.
+ *
+ * Sealing a segment writes a footer indexing the offset and term of each of
+ * its entries. Opening the log scans only the last segment; sealed ones are
+ * indexed from their footers when first read.
+ */
+typedef struct raft_wal raft_wal_t;
+
+typedef struct {
+  uint32_t segment_size;
+
+  /**
+   * Number of preallocated segment files kept ready for the log to move
+   * into. The pool is filled on open and topped up by one on each
+   * compaction, and segments compacted away are recycled into it rather
+   * than deleted.
+   */
+  uint32_t spare_segments;
+
+  /**
+   * When nonzero, writes and syncs are submitted through an io_uring of this
+   * depth, copying appends into io_depth registered buffers of
+   * io_buffer_size bytes. Where io_uring is unavailable the log falls back
+   * to pwrite() and fdatasync().
+   */
+  uint32_t io_depth;
+  uint32_t io_buffer_size;
+
+  /**
+   * When nonzero, opening the log checks the CRC of every record in sealed
+   * segments, spread over this many threads. Otherwise those records are
+   * checked as they are read.
+   */
+  uint32_t verify_threads;
+} raft_wal_config_t;
+
+/**
+ * Opens the log in the existing directory p_dir, recovering the entries
+ * of any segments in it. A torn record at the end of the last segment is
+ * discarded along with everything after it. Returns RAFT_STATUS_IO_ERROR if
+ * a sealed segment is damaged, when verify_threads is set.
+ */
+raft_status_t raft_wal_open(char const* p_dir,
+                            raft_wal_config_t const* p_config,
+                            raft_wal_t** pp_wal);
+
+void raft_wal_close(raft_wal_t* p_wal);
+
+/**
+ * Index of the first entry held, and one past the last. Equal when empty.
+ */
+raft_index_t raft_wal_first_index(raft_wal_t const* p_wal);
+raft_index_t raft_wal_end_index(raft_wal_t const* p_wal);
+
+/**
+ * Writes the entries as indexes first_index on, replacing any held at or
+ * after first_index. first_index may not be past raft_wal_end_index()
+ * unless the log is empty. Entries are durable once raft_wal_sync()
+ * returns.
+ */
+raft_status_t raft_wal_append(raft_wal_t* p_wal,
+                              raft_index_t first_index,
+                              raft_log_entry_t const* p_entries,
+                              uint32_t num_entries);
+
+raft_status_t raft_wal_sync(raft_wal_t* p_wal);
+
+/**
+ * Starts syncing the appended entries without waiting for it to finish.
+ * With io_uring the sync is submitted linked behind the pending writes;
+ * otherwise this is raft_wal_sync().
+ */
+raft_status_t raft_wal_flush(raft_wal_t* p_wal);
+
+/**
+ * One past the last entry known to be durable, checking for completed syncs
+ * without blocking. A raft_ready() batch's messages may go out once this
+ * passes its last entry to persist.
+ */
+raft_index_t raft_wal_durable_index(raft_wal_t* p_wal);
+
+/**
+ * Reads the entry at index into p_entry. In sealed segments p_data points
+ * into the segment's mapping and stays valid until the segment is
+ * compacted away; in the last segment it points to a buffer that the next
+ * read reuses. Returns RAFT_STATUS_INVALID_ARGS if the entry is not held and
+ * RAFT_STATUS_IO_ERROR if its record is damaged.
+ */
+raft_status_t raft_wal_entry(raft_wal_t* p_wal,
+                             raft_index_t index,
+                             raft_log_entry_t* p_entry);
+
+/**
+ * Reads the term of the entry at index from the segment index, without
+ * reading the entry.
+ */
+raft_status_t raft_wal_term(raft_wal_t* p_wal,
+                            raft_index_t index,
+                            raft_term_t* p_term);
+
+/**
+ * Deletes the sealed segments holding only entries before index, releasing
+ * their pages. Their files are recycled as spares where the pool has room.
+ * If the pool is still short, one more spare is preallocated, zero-filled
+ * and synced before returning.
+ */
+raft_status_t raft_wal_compact(raft_wal_t* p_wal, raft_index_t index);
+
+#endif
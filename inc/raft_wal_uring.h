@@ -0,0 +1,63 @@
+#ifndef __RAFT_WAL_URING_H__
+#define __RAFT_WAL_URING_H__
+
+#include "raft_types.h"
+
+/**
+ * io_uring submission of raft_wal_t's writes and syncs, see
+ * raft_wal_config_t.io_depth. Writes are copied into buffers registered with
+ * the ring and each sync is linked after the writes queued before it, so a
+ * write and its sync cost one submission.
+ */
+typedef struct raft_wal_uring raft_wal_uring_t;
+
+/**
+ * Sets up a ring of depth entries with depth registered buffers of
+ * buffer_size bytes. Returns RAFT_STATUS_INVALID_ARGS where io_uring is not
+ * supported.
+ */
+raft_status_t raft_wal_uring_alloc(uint32_t depth,
+                                   uint32_t buffer_size,
+                                   raft_wal_uring_t** pp_uring);
+
+/**
+ * Frees the ring. Every submission must have completed.
+ */
+void raft_wal_uring_free(raft_wal_uring_t* p_uring);
+
+/**
+ * Queues a write of size bytes to fd at offset, waiting for buffers to free
+ * up if needed.
+ */
+raft_status_t raft_wal_uring_write(raft_wal_uring_t* p_uring,
+                                   int fd,
+                                   void const* p_bytes,
+                                   uint32_t size,
+                                   uint64_t offset);
+
+/**
+ * Queues an fdatasync of fd after the queued writes and submits them. Once it
+ * completes, raft_wal_uring_reap() reports end_index as durable.
+ */
+raft_status_t raft_wal_uring_sync(raft_wal_uring_t* p_uring,
+                                  int fd,
+                                  raft_index_t end_index);
+
+/**
+ * Submits anything queued and processes completions, waiting for every
+ * submission to complete if wait_all is set. Raises *p_durable_index to the
+ * end index of the latest sync that completed along with every write and
+ * sync submitted before it. Returns RAFT_STATUS_IO_ERROR once
+ * any write or sync has failed.
+ */
+raft_status_t raft_wal_uring_reap(raft_wal_uring_t* p_uring,
+                                  raft_bool_t wait_all,
+                                  raft_index_t* p_durable_index);
+
+/**
+ * Lowers the end index reported as durable after entries from index on were
+ * dropped. Every submission must have completed.
+ */
+void raft_wal_uring_truncated(raft_wal_uring_t* p_uring, raft_index_t index);
+
+#endif
@@ -9,6 +9,14 @@ typedef enum {
   MSG_TYPE_APPEND_ENTRIES_RESPONSE,
   MSG_TYPE_REQUEST_VOTE,
   MSG_TYPE_REQUEST_VOTE_RESPONSE,
+  MSG_TYPE_READ_INDEX,
+  MSG_TYPE_READ_INDEX_RESPONSE,
+  MSG_TYPE_PRE_VOTE,
+  MSG_TYPE_PRE_VOTE_RESPONSE,
+  MSG_TYPE_TIMEOUT_NOW,
+  MSG_TYPE_HEARTBEAT,
+  MSG_TYPE_FRAGMENT,
+  MSG_TYPE_FRAGMENT_RESPONSE,
 } raft_message_type_t;
 
 typedef struct {
@@ -26,6 +34,10 @@ raft_status_t raft_write_append_entries_response_envelope(
     raft_envelope_t* p_env,
     raft_nodeid_t recipient_id,
     raft_append_entries_response_args_t const* p_args);
+raft_status_t raft_write_heartbeat_envelope(
+    raft_envelope_t* p_envelope,
+    raft_nodeid_t node_id,
+    raft_heartbeat_args_t const* p_args);
 raft_status_t raft_write_request_vote_envelope(
     raft_envelope_t* p_envelope,
     raft_nodeid_t node_id,
@@ -34,6 +46,34 @@ raft_status_t raft_write_request_vote_response_envelope(
     raft_envelope_t* p_envelope,
     raft_nodeid_t node_id,
     raft_request_vote_response_args_t const* p_args);
+raft_status_t raft_write_pre_vote_envelope(
+    raft_envelope_t* p_envelope,
+    raft_nodeid_t node_id,
+    raft_request_vote_args_t const* p_args);
+raft_status_t raft_write_pre_vote_response_envelope(
+    raft_envelope_t* p_envelope,
+    raft_nodeid_t node_id,
+    raft_request_vote_response_args_t const* p_args);
+raft_status_t raft_write_timeout_now_envelope(
+    raft_envelope_t* p_envelope,
+    raft_nodeid_t node_id,
+    raft_timeout_now_args_t const* p_args);
+raft_status_t raft_write_read_index_envelope(
+    raft_envelope_t* p_envelope,
+    raft_nodeid_t node_id,
+    raft_read_index_args_t const* p_args);
+raft_status_t raft_write_read_index_response_envelope(
+    raft_envelope_t* p_envelope,
+    raft_nodeid_t node_id,
+    raft_read_index_response_args_t const* p_args);
+raft_status_t raft_write_fragment_envelope(
+    raft_envelope_t* p_envelope,
+    raft_nodeid_t node_id,
+    raft_fragment_args_t const* p_args);
+raft_status_t raft_write_fragment_response_envelope(
+    raft_envelope_t* p_envelope,
+    raft_nodeid_t node_id,
+    raft_fragment_response_args_t const* p_args);
 
 void raft_dealloc_envelope(raft_envelope_t* p_envelope);
 
@@ -42,10 +82,14 @@ raft_message_type_t raft_message_type(void* p_message_bytes);
 raft_status_t raft_read_append_entries_args(raft_append_entries_args_t* p_args,
                                             void* p_message_bytes,
                                             uint32_t message_size);
+void raft_dealloc_append_entries_args(raft_append_entries_args_t* p_args);
 raft_status_t raft_read_append_entries_response_args(
     raft_append_entries_response_args_t* p_args,
     void* p_message_bytes,
     uint32_t message_size);
+raft_status_t raft_read_heartbeat_args(raft_heartbeat_args_t* p_args,
+                                       void* p_message_bytes,
+                                       uint32_t message_size);
 raft_status_t raft_read_request_vote_args(raft_request_vote_args_t* p_args,
                                           void* p_message_bytes,
                                           uint32_t message_size);
@@ -53,5 +97,22 @@ raft_status_t raft_read_request_vote_response_args(
     raft_request_vote_response_args_t* p_args,
     void* p_message_bytes,
     uint32_t message_size);
+raft_status_t raft_read_timeout_now_args(raft_timeout_now_args_t* p_args,
+                                         void* p_message_bytes,
+                                         uint32_t message_size);
+raft_status_t raft_read_read_index_args(raft_read_index_args_t* p_args,
+                                        void* p_message_bytes,
+                                        uint32_t message_size);
+raft_status_t raft_read_read_index_response_args(
+    raft_read_index_response_args_t* p_args,
+    void* p_message_bytes,
+    uint32_t message_size);
+raft_status_t raft_read_fragment_args(raft_fragment_args_t* p_args,
+                                      void* p_message_bytes,
+                                      uint32_t message_size);
+raft_status_t raft_read_fragment_response_args(
+    raft_fragment_response_args_t* p_args,
+    void* p_message_bytes,
+    uint32_t message_size);
 
 #endif
@@ -1,22 +1,24 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "raft.h"
 #include "raft_util.h"
 #include "raft_state.h"
 #include "raft_config.h"
+#include "raft_election.h"
+#include "raft_erasure.h"
+#include "raft_lease.h"
 #include "raft_log.h"
+#include "raft_membership.h"
+#include "raft_proposal.h"
+#include "raft_read.h"
+#include "raft_recovery.h"
+#include "raft_replication.h"
 #include "raft_wire.h"
 
 static raft_bool_t should_begin_election(raft_state_t* p_state);
-static raft_status_t begin_election(raft_state_t* p_state);
-
-static raft_status_t send_append_entries(raft_state_t* p_state,
-                                         raft_nodeid_t recipient_id,
-                                         raft_append_entries_args_t* p_args);
-
-static raft_status_t send_request_vote(raft_state_t* p_state,
-                                       raft_nodeid_t recipient_id,
-                                       raft_request_vote_args_t* p_args);
+static raft_bool_t should_code(raft_state_t const* p_state,
+                               uint32_t data_size);
 
 raft_status_t raft_alloc(raft_state_t** pp_state, raft_config_t* p_config) {
   *pp_state = NULL;
@@ -40,6 +42,10 @@ raft_status_t raft_alloc(raft_state_t** pp_state, raft_config_t* p_config) {
 
   p_state->p_config = p_config;
 
+  p_state->p.current_term = p_state->r.persisted_term = p_config->initial_term;
+  p_state->p.voted_for = p_state->r.persisted_voted_for =
+      p_config->initial_voted_for;
+
   /**
    * Validate election timeout settings and set initial timeout.
    */
@@ -53,29 +59,72 @@ raft_status_t raft_alloc(raft_state_t** pp_state, raft_config_t* p_config) {
     return RAFT_STATUS_INVALID_ARGS;
   }
 
-  uint32_t range = (p_config->election_timeout_max_ms -
-                    p_config->election_timeout_min_ms);
-  p_state->v.election_timeout_ms = ((rand() % range) +
-                                    p_config->election_timeout_min_ms);
+  if (p_config->election_timeout_floor_ms > p_config->election_timeout_min_ms) {
+    RAFT_LOG(p_state,
+             "Invalid election_timeout settings: election_timeout_floor_ms (%u) > election_timeout_min_ms (%u)",
+             p_config->election_timeout_floor_ms,
+             p_config->election_timeout_min_ms);
+    raft_log_free(p_log);
+    free(p_state);
+    return RAFT_STATUS_INVALID_ARGS;
+  }
 
-  /**
-   * Allocate and initialize the ballot.
-   */
-  uint32_t const ballot_size = p_config->node_count * sizeof(raft_bool_t);
-  p_state->l.p_ballot = calloc(1, ballot_size);
-  if (p_state->l.p_ballot == NULL) {
+  if (p_config->lease_reads &&
+      p_config->lease_drift_ms >= p_config->election_timeout_min_ms) {
+    RAFT_LOG(p_state,
+             "Invalid lease settings: lease_drift_ms (%u) >= election_timeout_min_ms (%u)",
+             p_config->lease_drift_ms,
+             p_config->election_timeout_min_ms);
     raft_log_free(p_log);
     free(p_state);
-    return RAFT_STATUS_OUT_OF_MEMORY;
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  raft_reset_election_timer(p_state);
+
+  /**
+   * Adopt the initial configuration, allocating the ballot and per-node
+   * replication progress.
+   */
+  raft_status_t const status = raft_membership_init(p_state);
+  if (RAFT_FAILURE(status)) {
+    raft_free(p_state);
+    return status;
   }
 
+  /* Everything but the sentinel entry still has to be persisted. */
+  p_state->r.unstable_index = 1;
+
   *pp_state = p_state;
   return RAFT_STATUS_OK;
 }
 
 void raft_free(raft_state_t* p_state) {
   // TODO: Make sure everything is actually freed...
+  for (uint32_t i = 0; i < p_state->r.message_count; ++i) {
+    raft_dealloc_envelope(&p_state->r.p_messages[i]);
+  }
+  free(p_state->r.p_messages);
+  raft_membership_free(p_state);
   free(p_state->l.p_ballot);
+  free(p_state->l.p_next_index);
+  free(p_state->l.p_match_index);
+  free(p_state->l.p_last_ack_ms);
+  free(p_state->l.p_ping_due_ms);
+  free(p_state->l.p_relay_ids);
+  free(p_state->l.p_rtt_seq);
+  free(p_state->l.p_rtt_sent_ms);
+  free(p_state->l.p_rtt_pending);
+  free(p_state->l.p_rtt_ms);
+  free(p_state->l.p_rtt_count);
+  free(p_state->l.p_hint_ms);
+  free(p_state->b.p_replicate);
+  free(p_state->b.p_respond);
+  free(p_state->b.p_responses);
+  raft_proposals_free(p_state);
+  raft_reads_free(p_state);
+  raft_recovery_free(p_state);
+  free(p_state->ls.p_expiry_ms);
   raft_log_free(p_state->p.p_log);
   free(p_state);
 }
@@ -86,6 +135,7 @@ raft_status_t raft_tick(raft_state_t* p_state,
   raft_status_t status = RAFT_STATUS_OK;
 
   p_state->v.ms_since_last_leader_ping += elapsed_ms;
+  p_state->v.clock_ms += elapsed_ms;
   RAFT_LOG(p_state,
            "TICK: ms since last leader ping: %u, election_timeout: %u",
            p_state->v.ms_since_last_leader_ping,
@@ -94,23 +144,56 @@ raft_status_t raft_tick(raft_state_t* p_state,
   raft_config_t const* p_config = p_state->p_config;
 
   if (p_state->type == RAFT_NODE_TYPE_LEADER) {
-    raft_append_entries_args_t args = { 0 };
-    args.term = p_state->p.current_term;
-
-    for (uint32_t i = 0; i < p_config->node_count - 1; ++i) {
-      if (p_config->p_nodeids[i] != p_state->p.self) {
-        send_append_entries(p_state, p_config->p_nodeids[i], &args);
+    /* Give up on a transfer whose target has not taken over in time. */
+    if (p_state->l.transfer_id != 0) {
+      p_state->l.transfer_elapsed_ms += elapsed_ms;
+      if (p_state->l.transfer_elapsed_ms >= p_config->election_timeout_max_ms) {
+        RAFT_LOG(p_state, "Leadership transfer to %u timed out.",
+                 p_state->l.transfer_id);
+        /* The target may have been elected ignoring the lease, so only
+         * rounds sent from now on may extend it. */
+        if (p_state->l.transfer_sent) {
+          raft_lease_start(p_state);
+        }
+        p_state->l.transfer_id = 0;
+        p_state->l.transfer_sent = RAFT_FALSE;
       }
     }
 
-    *p_reschedule_ms = p_config->leader_ping_interval_ms;
+    if (RAFT_FAILURE(status = raft_check_quorum(p_state))) {
+      return status;
+    }
+  }
+
+  /* Fragments asked for may have been lost on the way. */
+  if (RAFT_FAILURE(status = raft_recovery_retry(p_state))) {
+    return status;
+  }
+
+  /* A leader that just stepped down carries on as a follower. */
+  if (p_state->type == RAFT_NODE_TYPE_LEADER) {
+    raft_heartbeat_idle(p_state);
   } else {
-    if (should_begin_election(p_state)) {
-      if (RAFT_FAILURE(status = begin_election(p_state))) {
+    raft_reads_retry(p_state);
+
+    if (!raft_membership_can_lead(p_state, p_state->p.self)) {
+      /* Learners and witnesses never campaign; they wait out another
+       * timeout. */
+      if (p_state->v.ms_since_last_leader_ping >=
+          p_state->v.election_timeout_ms) {
+        raft_reset_election_timer(p_state);
+      }
+    } else if (should_begin_election(p_state)) {
+      if (RAFT_FAILURE(status = raft_begin_election(p_state))) {
         return status;
       }
     }
+  }
 
+  /* An election may have just been won. */
+  if (p_state->type == RAFT_NODE_TYPE_LEADER) {
+    *p_reschedule_ms = p_config->leader_ping_interval_ms;
+  } else {
     *p_reschedule_ms = (p_state->v.election_timeout_ms -
                         p_state->v.ms_since_last_leader_ping);
   }
@@ -118,46 +201,186 @@ raft_status_t raft_tick(raft_state_t* p_state,
   return RAFT_STATUS_OK;
 }
 
-/*******************************************************************************
- ******************************** Elections ************************************
- ******************************************************************************/
+raft_status_t raft_append(raft_state_t* p_state,
+                          uint32_t unique_id,
+                          void* p_data,
+                          uint32_t data_size,
+                          raft_proposal_f* pf_completion,
+                          void* p_context) {
+  if (p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return RAFT_STATUS_NOT_LEADER;
+  }
+  if (p_state->l.transfer_id != 0) {
+    return RAFT_STATUS_TRANSFER_IN_PROGRESS;
+  }
+
+  raft_log_t* p_log = p_state->p.p_log;
+  raft_proposal_t const proposal = {
+    .pf_completion = pf_completion,
+    .p_context = p_context,
+    .unique_id = unique_id,
+  };
+  raft_status_t status = raft_proposals_push(p_state,
+                                             raft_log_length(p_log),
+                                             &proposal);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  raft_index_t const index = raft_log_length(p_log);
+  if (should_code(p_state, data_size)) {
+    status = raft_log_append_coded(p_log,
+                                   unique_id,
+                                   p_state->p.current_term,
+                                   p_data,
+                                   data_size,
+                                   p_state->p_config->erasure_fragments);
+    if (RAFT_SUCCESS(status) && p_state->l.first_coded_index == 0) {
+      p_state->l.first_coded_index = index;
+    }
+  } else {
+    status = raft_log_append_user(p_log,
+                                  unique_id,
+                                  p_state->p.current_term,
+                                  p_data,
+                                  data_size);
+  }
+  if (RAFT_FAILURE(status)) {
+    raft_proposals_cancel(p_state, raft_log_length(p_log));
+    return status;
+  }
+
+  /* A single node cluster commits as soon as the entry is appended. */
+  raft_advance_commit_index(p_state);
+  if (RAFT_FAILURE(status = raft_apply_committed(p_state))) {
+    return status;
+  }
+  if (p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return RAFT_STATUS_OK;
+  }
+
+  return raft_replicate(p_state);
+}
+
+raft_status_t raft_read_index(raft_state_t* p_state,
+                              raft_read_f* pf_read,
+                              void* p_context) {
+  /* Followers ask the leader they know of for the read index. */
+  if (p_state->type == RAFT_NODE_TYPE_CANDIDATE ||
+      (p_state->type == RAFT_NODE_TYPE_FOLLOWER && p_state->v.leader_id == 0)) {
+    return RAFT_STATUS_NOT_LEADER;
+  }
+  /* Witnesses hold no state to read. */
+  if (pf_read == NULL || raft_membership_is_witness(p_state, p_state->p.self)) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  raft_read_t const read = {
+    .pf_read = pf_read,
+    .p_context = p_context,
+  };
+  return raft_reads_push(p_state, &read);
+}
+
+raft_status_t raft_transfer_leadership(raft_state_t* p_state,
+                                       raft_nodeid_t target_id) {
+  if (p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return RAFT_STATUS_NOT_LEADER;
+  }
+  if (target_id == p_state->p.self ||
+      !raft_membership_can_lead(p_state, target_id)) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+  if (p_state->l.transfer_id != 0) {
+    return (p_state->l.transfer_id == target_id ?
+            RAFT_STATUS_OK :
+            RAFT_STATUS_TRANSFER_IN_PROGRESS);
+  }
 
-static raft_status_t begin_election(raft_state_t* p_state) {
-  RAFT_LOG(p_state, "Beginning election!");
+  p_state->l.transfer_id = target_id;
+  p_state->l.transfer_sent = RAFT_FALSE;
+  p_state->l.transfer_elapsed_ms = 0;
 
-  raft_term_t election_term;
+  raft_status_t status;
+  if (p_state->l.p_next_index[target_id - 1] <
+      raft_log_length(p_state->p.p_log) &&
+      RAFT_FAILURE(status = raft_replicate_to(p_state, target_id))) {
+    return status;
+  }
+  return raft_transfer_check(p_state);
+}
 
-  {
-    raft_state_set_type(p_state, RAFT_NODE_TYPE_CANDIDATE);
-    p_state->p.voted_for = p_state->p.self;
-    election_term = ++p_state->p.current_term;
+raft_status_t raft_change_membership(raft_state_t* p_state,
+                                     raft_nodeid_t const* p_voter_ids,
+                                     uint32_t voter_count,
+                                     raft_nodeid_t const* p_learner_ids,
+                                     uint32_t learner_count) {
+  if (p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return RAFT_STATUS_NOT_LEADER;
+  }
+  if (p_state->l.transfer_id != 0) {
+    return RAFT_STATUS_TRANSFER_IN_PROGRESS;
+  }
+  if (raft_membership_changing(p_state)) {
+    return RAFT_STATUS_CHANGE_IN_PROGRESS;
   }
 
-  /* Vote for self. */
-  {
-    raft_bool_t* p_ballot = p_state->l.p_ballot;
-    memset(p_ballot, 0, p_state->p_config->node_count * sizeof(*p_ballot));
-    p_ballot[p_state->p.self - 1] = RAFT_TRUE;
+  raft_status_t status = raft_membership_propose(p_state,
+                                                 p_voter_ids,
+                                                 voter_count,
+                                                 p_learner_ids,
+                                                 learner_count);
+  if (RAFT_FAILURE(status)) {
+    return status;
   }
 
-  raft_request_vote_args_t args = { 0 };
-  args.term = election_term;
-  args.candidate_id = p_state->p.self;
+  raft_advance_commit_index(p_state);
+  if (RAFT_FAILURE(status = raft_apply_committed(p_state))) {
+    return status;
+  }
+  if (p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return RAFT_STATUS_OK;
+  }
+  return raft_replicate(p_state);
+}
 
-  raft_log_t* p_log = p_state->p.p_log;
-  args.last_log_index = raft_log_length(p_log);
-  args.last_log_term = (args.last_log_index > 0 ?
-                        raft_log_entry(p_log, -1)->term :
-                        0);
-
-  raft_config_t* p_config = p_state->p_config;
-  for (uint32_t i = 0; i < p_config->node_count - 1; ++i) {
-    if (p_config->p_nodeids[i] != p_state->p.self) {
-      send_request_vote(p_state, p_config->p_nodeids[i], &args);
+raft_bool_t raft_learner_caught_up(raft_state_t const* p_state,
+                                   raft_nodeid_t node_id) {
+  return (p_state->type == RAFT_NODE_TYPE_LEADER &&
+          raft_membership_is_member(p_state, node_id) &&
+          p_state->l.p_match_index[node_id - 1] >= p_state->v.commit_index);
+}
+
+raft_status_t raft_promote_learner(raft_state_t* p_state,
+                                   raft_nodeid_t node_id) {
+  if (!raft_membership_is_member(p_state, node_id) ||
+      raft_membership_is_voter(p_state, node_id)) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  uint32_t const capacity = p_state->m.capacity;
+  raft_nodeid_t* p_ids = calloc(capacity, sizeof(*p_ids));
+  if (p_ids == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+
+  /* Voters fill the front of p_ids and the remaining learners the back. */
+  uint32_t voter_count = 0;
+  uint32_t learner_count = 0;
+  for (raft_nodeid_t id = 1; id <= capacity; ++id) {
+    if (id == node_id || raft_membership_is_voter(p_state, id)) {
+      p_ids[voter_count++] = id;
+    } else if (raft_membership_is_member(p_state, id)) {
+      p_ids[capacity - ++learner_count] = id;
     }
   }
 
-  return RAFT_STATUS_OK;
+  raft_status_t const status = raft_change_membership(
+      p_state,
+      p_ids, voter_count,
+      p_ids + capacity - learner_count, learner_count);
+  free(p_ids);
+  return status;
 }
 
 static raft_bool_t should_begin_election(raft_state_t* p_state) {
@@ -168,52 +391,34 @@ static raft_bool_t should_begin_election(raft_state_t* p_state) {
   return p_state->v.ms_since_last_leader_ping >= p_state->v.election_timeout_ms;
 }
 
-/*******************************************************************************
- *******************************************************************************
- ******************************************************************************/
-
-static raft_status_t send_append_entries(raft_state_t* p_state,
-                                         raft_nodeid_t recipient_id,
-                                         raft_append_entries_args_t* p_args) {
+/**
+ * Whether an entry of data_size bytes is erasure-coded: only while enough
+ * nodes to commit it were heard from within election_timeout_min_ms.
+ */
+static raft_bool_t should_code(raft_state_t const* p_state,
+                               uint32_t data_size) {
   raft_config_t const* p_config = p_state->p_config;
-
-  raft_status_t status;
-  if (p_config->cb.pf_append_entries_rpc) {
-    status = p_config->cb.pf_append_entries_rpc(recipient_id, p_args);
-  } else {
-    raft_envelope_t envelope = { 0 };
-    status = raft_write_append_entries_envelope(&envelope,
-                                                recipient_id,
-                                                p_args);
-    if (RAFT_SUCCESS(status)) {
-      status = p_config->cb.pf_send_message(recipient_id,
-                                            envelope.p_message,
-                                            envelope.message_size);
-    } else {
-      raft_dealloc_envelope(&envelope);
-    }
+  if (p_config->erasure_fragments == 0 ||
+      p_config->erasure_fragments > RAFT_ERASURE_MAX_FRAGMENTS ||
+      data_size == 0 ||
+      data_size < p_config->erasure_min_size) {
+    return RAFT_FALSE;
   }
-  return status;
-}
 
-static raft_status_t send_request_vote(raft_state_t* p_state,
-                                       raft_nodeid_t recipient_id,
-                                       raft_request_vote_args_t* p_args) {
-  raft_config_t const* p_config = p_state->p_config;
+  uint32_t const quorum =
+      raft_membership_coded_quorum(p_state, p_config->erasure_fragments);
+  if (quorum == 0) {
+    return RAFT_FALSE;
+  }
 
-  raft_status_t status;
-  if (p_config->cb.pf_request_vote_rpc) {
-    status = p_config->cb.pf_request_vote_rpc(recipient_id, p_args);
-  } else {
-    raft_envelope_t envelope = { 0 };
-    status = raft_write_request_vote_envelope(&envelope, recipient_id, p_args);
-    if (RAFT_SUCCESS(status)) {
-      status = p_config->cb.pf_send_message(recipient_id,
-                                            envelope.p_message,
-                                            envelope.message_size);
-    } else {
-      raft_dealloc_envelope(&envelope);
+  uint32_t live = raft_membership_holds_fragment(p_state, p_state->p.self);
+  for (uint32_t i = 0; i < p_state->m.peer_count; ++i) {
+    raft_nodeid_t const id = p_state->m.p_peers[i];
+    if (raft_membership_holds_fragment(p_state, id) &&
+        (p_state->v.clock_ms - p_state->l.p_last_ack_ms[id - 1] <
+         p_config->election_timeout_min_ms)) {
+      ++live;
     }
   }
-  return status;
+  return live >= quorum;
 }
@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "raft_election.h"
+#include "raft_config.h"
+#include "raft_lease.h"
+#include "raft_log.h"
+#include "raft_membership.h"
+#include "raft_recovery.h"
+#include "raft_replication.h"
+#include "raft_state.h"
+#include "raft_util.h"
+#include "raft_wire.h"
+
+static raft_status_t request_votes(raft_state_t* p_state,
+                                   raft_term_t term,
+                                   raft_message_type_t type,
+                                   raft_bool_t leadership_transfer);
+
+static raft_status_t send_request_vote(raft_state_t* p_state,
+                                       raft_nodeid_t recipient_id,
+                                       raft_request_vote_args_t* p_args);
+static raft_status_t send_pre_vote(raft_state_t* p_state,
+                                   raft_nodeid_t recipient_id,
+                                   raft_request_vote_args_t* p_args);
+static raft_status_t send_timeout_now(raft_state_t* p_state,
+                                      raft_nodeid_t recipient_id,
+                                      raft_timeout_now_args_t* p_args);
+
+raft_status_t raft_begin_election(raft_state_t* p_state) {
+  if (!p_state->p_config->pre_vote) {
+    return raft_campaign(p_state, RAFT_FALSE);
+  }
+
+  RAFT_LOG(p_state, "Beginning pre-vote!");
+
+  raft_state_set_type(p_state, RAFT_NODE_TYPE_PRE_CANDIDATE);
+  p_state->v.leader_id = 0;
+  raft_reset_election_timer(p_state);
+
+  return request_votes(p_state,
+                       p_state->p.current_term + 1,
+                       MSG_TYPE_PRE_VOTE,
+                       RAFT_FALSE);
+}
+
+raft_status_t raft_campaign(raft_state_t* p_state,
+                            raft_bool_t leadership_transfer) {
+  RAFT_LOG(p_state, "Beginning election!");
+
+  raft_state_set_type(p_state, RAFT_NODE_TYPE_CANDIDATE);
+  raft_state_set_term(p_state, p_state->p.current_term + 1);
+  p_state->p.voted_for = p_state->p.self;
+  raft_reset_election_timer(p_state);
+
+  return request_votes(p_state,
+                       p_state->p.current_term,
+                       MSG_TYPE_REQUEST_VOTE,
+                       leadership_transfer);
+}
+
+raft_status_t raft_promote_to_leader(raft_state_t* p_state) {
+  RAFT_LOG(p_state, "Leader for term %u.",
+           p_state->p.current_term);
+
+  raft_state_set_type(p_state, RAFT_NODE_TYPE_LEADER);
+  p_state->v.leader_id = p_state->p.self;
+  p_state->l.transfer_id = 0;
+  raft_lease_start(p_state);
+
+  raft_index_t const log_length = raft_log_length(p_state->p.p_log);
+  for (uint32_t i = 0; i < p_state->m.capacity; ++i) {
+    p_state->l.p_next_index[i] = log_length;
+    p_state->l.p_match_index[i] = 0;
+    p_state->l.p_rtt_seq[i] = 0;
+    p_state->l.p_rtt_pending[i] = RAFT_FALSE;
+    p_state->l.p_rtt_count[i] = 0;
+    p_state->l.p_hint_ms[i] = 0;
+
+    /* Followers get a full timeout to answer the new leader. */
+    p_state->l.p_last_ack_ms[i] = p_state->v.clock_ms;
+    p_state->l.p_ping_due_ms[i] = 0;
+  }
+
+  raft_find_coded(p_state);
+
+  raft_status_t status = raft_append_noop(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  /* Entries held only as fragments are rebuilt before being replicated. */
+  if (RAFT_FAILURE(status = raft_recovery_promoted(p_state))) {
+    return status;
+  }
+
+  /* Send initial AppendEntries messages to establish leadership. */
+  return raft_heartbeat(p_state);
+}
+
+raft_status_t raft_transfer_check(raft_state_t* p_state) {
+  raft_nodeid_t const target_id = p_state->l.transfer_id;
+  if (target_id == 0 || p_state->l.transfer_sent ||
+      p_state->l.p_match_index[target_id - 1] + 1 <
+      raft_log_length(p_state->p.p_log)) {
+    return RAFT_STATUS_OK;
+  }
+
+  RAFT_LOG(p_state, "Handing leadership to %u.", target_id);
+  p_state->l.transfer_sent = RAFT_TRUE;
+
+  raft_timeout_now_args_t args = {
+    .term = p_state->p.current_term,
+    .leader_id = p_state->p.self,
+  };
+  return send_timeout_now(p_state, target_id, &args);
+}
+
+raft_status_t raft_check_quorum(raft_state_t* p_state) {
+  raft_config_t const* p_config = p_state->p_config;
+  if (!p_config->check_quorum || p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return RAFT_STATUS_OK;
+  }
+
+  uint64_t const clock_ms = p_state->v.clock_ms;
+  raft_tally_t active = { 0 };
+  raft_tally_add(p_state, &active, p_state->p.self);
+  for (uint32_t i = 0; i < p_state->m.peer_count; ++i) {
+    raft_nodeid_t const id = p_state->m.p_peers[i];
+    if (clock_ms - p_state->l.p_last_ack_ms[id - 1] <
+        p_config->election_timeout_min_ms) {
+      raft_tally_add(p_state, &active, id);
+    }
+  }
+  if (raft_tally_is_quorum(p_state, &active)) {
+    return RAFT_STATUS_OK;
+  }
+
+  RAFT_LOG(p_state, "Lost contact with a majority; stepping down.");
+  raft_state_set_type(p_state, RAFT_NODE_TYPE_FOLLOWER);
+  p_state->v.leader_id = 0;
+  raft_reset_election_timer(p_state);
+  return RAFT_STATUS_OK;
+}
+
+static int compare_u32(void const* p_a, void const* p_b) {
+  uint32_t const a = *(uint32_t const*)p_a;
+  uint32_t const b = *(uint32_t const*)p_b;
+  return (a > b) - (a < b);
+}
+
+void raft_election_rtt_sent(raft_state_t* p_state, raft_nodeid_t follower_id) {
+  raft_config_t const* p_config = p_state->p_config;
+  uint32_t const i = follower_id - 1;
+  if (!p_config->adaptive_election_timeout ||
+      p_state->l.p_rtt_seq[i] >= p_state->rd.seq) {
+    return;
+  }
+
+  /* A message unanswered for a whole election timeout was lost. */
+  if (p_state->l.p_rtt_pending[i] &&
+      (p_state->v.clock_ms - p_state->l.p_rtt_sent_ms[i] <
+       p_config->election_timeout_max_ms)) {
+    return;
+  }
+
+  p_state->l.p_rtt_seq[i] = p_state->rd.seq;
+  p_state->l.p_rtt_sent_ms[i] = p_state->v.clock_ms;
+  p_state->l.p_rtt_pending[i] = RAFT_TRUE;
+}
+
+void raft_election_rtt_ack(raft_state_t* p_state,
+                           raft_nodeid_t follower_id,
+                           uint32_t seq) {
+  raft_config_t const* p_config = p_state->p_config;
+  uint32_t const i = follower_id - 1;
+  if (!p_config->adaptive_election_timeout ||
+      !p_state->l.p_rtt_pending[i] ||
+      seq != p_state->l.p_rtt_seq[i]) {
+    return;
+  }
+  p_state->l.p_rtt_pending[i] = RAFT_FALSE;
+
+  uint32_t* p_rtt_ms = &p_state->l.p_rtt_ms[i * RAFT_RTT_SAMPLE_COUNT];
+  uint32_t* p_rtt_count = &p_state->l.p_rtt_count[i];
+  p_rtt_ms[(*p_rtt_count)++ % RAFT_RTT_SAMPLE_COUNT] =
+      (uint32_t)(p_state->v.clock_ms - p_state->l.p_rtt_sent_ms[i]);
+
+  uint32_t a_sorted[RAFT_RTT_SAMPLE_COUNT];
+  uint32_t const count = MIN(*p_rtt_count, RAFT_RTT_SAMPLE_COUNT);
+  memcpy(a_sorted, p_rtt_ms, count * sizeof(*a_sorted));
+  qsort(a_sorted, count, sizeof(*a_sorted), compare_u32);
+
+  uint32_t const rtt_ms = a_sorted[(count - 1) * 99 / 100];
+  p_state->l.p_hint_ms[i] = 2 * p_config->leader_ping_interval_ms + 4 * rtt_ms;
+}
+
+void raft_reset_election_timer(raft_state_t* p_state) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  /* Narrow the range to the window the leader advertised. */
+  uint32_t min_ms = p_config->election_timeout_min_ms;
+  uint32_t max_ms = p_config->election_timeout_max_ms;
+  uint32_t const hint_ms = p_state->v.election_timeout_hint_ms;
+  if (p_config->adaptive_election_timeout && hint_ms != 0) {
+    uint32_t const floor_ms = (p_config->election_timeout_floor_ms != 0 ?
+                               p_config->election_timeout_floor_ms :
+                               p_config->election_timeout_min_ms);
+    /* Starting no later than 2/3 of the maximum leaves a window at least
+     * half as wide as its start. */
+    min_ms = MIN(MAX(floor_ms, hint_ms), max_ms / 3 * 2);
+    max_ms = MAX(MIN(max_ms, 2 * min_ms), min_ms + 1);
+  }
+
+  /**
+   * Split the range into a band per priority level, the highest priority
+   * taking the earliest, and draw the timeout from this node's band.
+   */
+  uint32_t priority = 0;
+  uint32_t max_priority = 0;
+  for (uint32_t i = 0; i < p_config->preference_count; ++i) {
+    raft_node_preference_t const* p_preference = &p_config->p_preferences[i];
+    max_priority = MAX(max_priority, p_preference->priority);
+    if (p_preference->id == p_state->p.self) {
+      priority = p_preference->priority;
+    }
+  }
+
+  p_state->v.ms_since_last_leader_ping = 0;
+  uint32_t const range = max_ms - min_ms;
+  uint32_t const band = MAX(1, range / (max_priority + 1));
+  uint32_t const band_start = MIN(range - 1, (max_priority - priority) * band);
+  p_state->v.election_timeout_ms = (min_ms +
+                                    band_start +
+                                    rand() % MIN(band, range - band_start));
+}
+
+/**
+ * Votes for self and asks every other node for its vote in term, as a
+ * pre-vote or a real one.
+ */
+static raft_status_t request_votes(raft_state_t* p_state,
+                                   raft_term_t term,
+                                   raft_message_type_t type,
+                                   raft_bool_t leadership_transfer) {
+  raft_bool_t* p_ballot = p_state->l.p_ballot;
+  memset(p_ballot, 0, p_state->m.capacity * sizeof(*p_ballot));
+  p_ballot[p_state->p.self - 1] = RAFT_TRUE;
+
+  /* A single node cluster wins on its own vote. */
+  if (raft_membership_ballot_won(p_state)) {
+    return (type == MSG_TYPE_PRE_VOTE ?
+            raft_campaign(p_state, RAFT_FALSE) :
+            raft_promote_to_leader(p_state));
+  }
+
+  raft_request_vote_args_t args = { 0 };
+  args.term = term;
+  args.candidate_id = p_state->p.self;
+  args.leadership_transfer = leadership_transfer;
+
+  raft_log_t* p_log = p_state->p.p_log;
+  args.last_log_index = raft_log_length(p_log) - 1;
+  args.last_log_term = (args.last_log_index > 0 ?
+                        raft_log_entry(p_log, -1)->term :
+                        0);
+
+  for (uint32_t i = 0; i < p_state->m.peer_count; ++i) {
+    raft_nodeid_t const id = p_state->m.p_peers[i];
+    if (!raft_membership_is_voter(p_state, id)) {
+      continue;
+    }
+    if (type == MSG_TYPE_PRE_VOTE) {
+      send_pre_vote(p_state, id, &args);
+    } else {
+      send_request_vote(p_state, id, &args);
+    }
+  }
+
+  return RAFT_STATUS_OK;
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ******************************************************************************/
+
+static raft_status_t send_request_vote(raft_state_t* p_state,
+                                       raft_nodeid_t recipient_id,
+                                       raft_request_vote_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_request_vote_rpc) {
+    status = p_config->cb.pf_request_vote_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_request_vote_envelope(&envelope, recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
+
+static raft_status_t send_pre_vote(raft_state_t* p_state,
+                                   raft_nodeid_t recipient_id,
+                                   raft_request_vote_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_pre_vote_rpc) {
+    status = p_config->cb.pf_pre_vote_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_pre_vote_envelope(&envelope, recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
+
+static raft_status_t send_timeout_now(raft_state_t* p_state,
+                                      raft_nodeid_t recipient_id,
+                                      raft_timeout_now_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_timeout_now_rpc) {
+    status = p_config->cb.pf_timeout_now_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_timeout_now_envelope(&envelope, recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "raft_erasure.h"
+#include "raft_util.h"
+
+/* Exponents and logarithms of GF(2^8) with polynomial 0x11d and generator
+ * 2. Exponents are doubled up so products need no reduction. */
+static uint8_t s_exp[510];
+static uint8_t s_log[256];
+static raft_bool_t s_tables_ready = RAFT_FALSE;
+
+static void init_tables(void) {
+  if (s_tables_ready) {
+    return;
+  }
+  uint32_t x = 1;
+  for (uint32_t i = 0; i < 255; ++i) {
+    s_exp[i] = s_exp[i + 255] = x;
+    s_log[x] = i;
+    x <<= 1;
+    if (x & 0x100) {
+      x ^= 0x11d;
+    }
+  }
+  s_tables_ready = RAFT_TRUE;
+}
+
+static uint8_t gf_mul(uint8_t a, uint8_t b) {
+  return (a && b) ? s_exp[s_log[a] + s_log[b]] : 0;
+}
+
+static uint8_t gf_inv(uint8_t a) {
+  return s_exp[255 - s_log[a]];
+}
+
+/**
+ * Weight of data fragment column in fragment row: the identity for data
+ * fragments and a Cauchy matrix for parity, so that any square selection of
+ * rows is invertible.
+ */
+static uint8_t coefficient(uint32_t row,
+                           uint32_t column,
+                           uint32_t fragments_needed) {
+  if (row < fragments_needed) {
+    return row == column;
+  }
+  return gf_inv(row ^ column);
+}
+
+/**
+ * Multiplies data fragment column, read from p_data, by weight and
+ * adds it to p_out.
+ */
+static void add_column(uint8_t* p_out,
+                       uint8_t const* p_data,
+                       uint32_t size,
+                       uint32_t fragment_size,
+                       uint32_t column,
+                       uint8_t weight) {
+  uint32_t const start = column * fragment_size;
+  if (weight == 0 || start >= size) {
+    return;
+  }
+  uint32_t const count = MIN(size - start, fragment_size);
+  for (uint32_t b = 0; b < count; ++b) {
+    p_out[b] ^= gf_mul(weight, p_data[start + b]);
+  }
+}
+
+uint32_t raft_erasure_fragment_size(uint32_t size, uint32_t fragments_needed) {
+  return (size + fragments_needed - 1) / fragments_needed;
+}
+
+void raft_erasure_encode(void const* p_data,
+                         uint32_t size,
+                         uint32_t fragments_needed,
+                         uint32_t fragment_index,
+                         void* p_fragment) {
+  init_tables();
+
+  uint32_t const fragment_size = raft_erasure_fragment_size(size,
+                                                            fragments_needed);
+  memset(p_fragment, 0, fragment_size);
+  for (uint32_t column = 0; column < fragments_needed; ++column) {
+    add_column(p_fragment, p_data, size, fragment_size, column,
+               coefficient(fragment_index, column, fragments_needed));
+  }
+}
+
+raft_status_t raft_erasure_decode(void const* const* pp_fragments,
+                                  uint32_t const* p_indexes,
+                                  uint32_t fragments_needed,
+                                  uint32_t size,
+                                  void* p_data) {
+  init_tables();
+
+  uint32_t const k = fragments_needed;
+  for (uint32_t i = 0; i < k; ++i) {
+    if (p_indexes[i] >= RAFT_ERASURE_MAX_FRAGMENTS) {
+      return RAFT_STATUS_INVALID_ARGS;
+    }
+    for (uint32_t j = 0; j < i; ++j) {
+      if (p_indexes[i] == p_indexes[j]) {
+        return RAFT_STATUS_INVALID_ARGS;
+      }
+    }
+  }
+
+  /* Invert the rows of the fragments given, alongside the identity. */
+  uint8_t* p_matrix = malloc(2 * k * k);
+  if (p_matrix == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  uint8_t* p_inverse = p_matrix + k * k;
+  memset(p_inverse, 0, k * k);
+  for (uint32_t row = 0; row < k; ++row) {
+    for (uint32_t column = 0; column < k; ++column) {
+      p_matrix[row * k + column] = coefficient(p_indexes[row], column, k);
+    }
+    p_inverse[row * k + row] = 1;
+  }
+
+  for (uint32_t column = 0; column < k; ++column) {
+    uint32_t pivot = column;
+    while (p_matrix[pivot * k + column] == 0) {
+      ++pivot;
+    }
+    for (uint32_t c = 0; c < k; ++c) {
+      uint8_t t = p_matrix[pivot * k + c];
+      p_matrix[pivot * k + c] = p_matrix[column * k + c];
+      p_matrix[column * k + c] = t;
+      t = p_inverse[pivot * k + c];
+      p_inverse[pivot * k + c] = p_inverse[column * k + c];
+      p_inverse[column * k + c] = t;
+    }
+
+    uint8_t const scale = gf_inv(p_matrix[column * k + column]);
+    for (uint32_t c = 0; c < k; ++c) {
+      p_matrix[column * k + c] = gf_mul(scale, p_matrix[column * k + c]);
+      p_inverse[column * k + c] = gf_mul(scale, p_inverse[column * k + c]);
+    }
+
+    for (uint32_t row = 0; row < k; ++row) {
+      uint8_t const factor = p_matrix[row * k + column];
+      if (row == column || factor == 0) {
+        continue;
+      }
+      for (uint32_t c = 0; c < k; ++c) {
+        p_matrix[row * k + c] ^= gf_mul(factor, p_matrix[column * k + c]);
+        p_inverse[row * k + c] ^= gf_mul(factor, p_inverse[column * k + c]);
+      }
+    }
+  }
+
+  /* Data fragment j is row j of the inverse applied to the fragments. */
+  uint32_t const fragment_size = raft_erasure_fragment_size(size, k);
+  uint8_t* p_out = p_data;
+  for (uint32_t j = 0; j < k; ++j) {
+    uint32_t const start = j * fragment_size;
+    if (start >= size) {
+      break;
+    }
+    uint32_t const count = MIN(size - start, fragment_size);
+    memset(p_out + start, 0, count);
+    for (uint32_t r = 0; r < k; ++r) {
+      uint8_t const factor = p_inverse[j * k + r];
+      uint8_t const* p_fragment = pp_fragments[r];
+      if (factor == 0) {
+        continue;
+      }
+      for (uint32_t b = 0; b < count; ++b) {
+        p_out[start + b] ^= gf_mul(factor, p_fragment[b]);
+      }
+    }
+  }
+
+  free(p_matrix);
+  return RAFT_STATUS_OK;
+}
@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "raft_hard_state.h"
+#include "raft_util.h"
+
+/**
+ * Slot layout, in network (big-endian) order:
+ *
+ * Bytes | Semantics
+ * =============================================================================
+ *   0-3 | Magic number
+ *  4-11 | Sequence number, one more than the previous update's
+ * 12-15 | Current term
+ * 16-19 | Voted for
+ * 20-27 | Reserved, zero
+ * 28-31 | CRC-32C of bytes 0-27
+ * =============================================================================
+ */
+
+#define HARD_STATE_MAGIC 0x52414648 /* "RAFH" */
+#define CRC_OFFSET       (RAFT_HARD_STATE_SIZE - 4)
+
+struct raft_hard_state_file {
+  int      fd;
+  uint64_t sequence;
+};
+
+static uint8_t* write_u32(uint8_t* p_b, uint32_t v) {
+  for (int32_t ii = 3; ii >= 0; --ii) {
+    (*p_b++) = RAFT_LSBYTE(v, ii);
+  }
+  return p_b;
+}
+
+static uint8_t const* read_u32(uint32_t* p_v, uint8_t const* p_b) {
+  *p_v = 0;
+  for (uint32_t ii = 0; ii < 4; ++ii) {
+    *p_v = (*p_v << 8) | (*p_b++);
+  }
+  return p_b;
+}
+
+void raft_hard_state_encode(raft_hard_state_t const* p_hard_state,
+                            uint64_t sequence,
+                            uint8_t* p_slot) {
+  memset(p_slot, 0, RAFT_HARD_STATE_SIZE);
+
+  uint8_t* p_b = write_u32(p_slot, HARD_STATE_MAGIC);
+  p_b = write_u32(p_b, sequence >> 32);
+  p_b = write_u32(p_b, sequence & 0xffffffff);
+  p_b = write_u32(p_b, p_hard_state->current_term);
+  write_u32(p_b, p_hard_state->voted_for);
+
+  write_u32(p_slot + CRC_OFFSET, raft_crc32c(0, p_slot, CRC_OFFSET));
+}
+
+raft_status_t raft_hard_state_decode(uint8_t const* p_slot,
+                                     raft_hard_state_t* p_hard_state,
+                                     uint64_t* p_sequence) {
+  uint32_t crc;
+  read_u32(&crc, p_slot + CRC_OFFSET);
+  if (crc != raft_crc32c(0, p_slot, CRC_OFFSET)) {
+    return RAFT_STATUS_INVALID_MESSAGE;
+  }
+
+  uint32_t magic, sequence_high, sequence_low;
+  uint8_t const* p_b = read_u32(&magic, p_slot);
+  if (magic != HARD_STATE_MAGIC) {
+    return RAFT_STATUS_INVALID_MESSAGE;
+  }
+  p_b = read_u32(&sequence_high, p_b);
+  p_b = read_u32(&sequence_low, p_b);
+  p_b = read_u32(&p_hard_state->current_term, p_b);
+  read_u32(&p_hard_state->voted_for, p_b);
+
+  *p_sequence = ((uint64_t)sequence_high << 32) | sequence_low;
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * fsyncs the directory holding p_path, so that a file just created there
+ * survives a crash.
+ */
+static raft_status_t sync_parent(char const* p_path) {
+  char* p_copy = strdup(p_path);
+  if (p_copy == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  int const fd = open(dirname(p_copy), O_RDONLY);
+  free(p_copy);
+  if (fd < 0 || fsync(fd) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return RAFT_STATUS_IO_ERROR;
+  }
+  close(fd);
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_hard_state_open(char const* p_path,
+                                   raft_hard_state_file_t** pp_file,
+                                   raft_hard_state_t* p_hard_state) {
+  *pp_file = NULL;
+  memset(p_hard_state, 0, sizeof(*p_hard_state));
+
+  raft_hard_state_file_t* p_file = calloc(1, sizeof(*p_file));
+  if (p_file == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+
+  p_file->fd = open(p_path, O_RDWR | O_CREAT | O_EXCL | O_DSYNC, 0644);
+  if (p_file->fd >= 0) {
+    raft_status_t const status = sync_parent(p_path);
+    if (RAFT_FAILURE(status)) {
+      raft_hard_state_close(p_file);
+      return status;
+    }
+  } else if (errno == EEXIST) {
+    p_file->fd = open(p_path, O_RDWR | O_DSYNC);
+  }
+  if (p_file->fd < 0) {
+    free(p_file);
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  /* Short reads leave the missing slots zero, which fail to decode. */
+  uint8_t a_slots[2 * RAFT_HARD_STATE_SIZE] = { 0 };
+  ssize_t const size = pread(p_file->fd, a_slots, sizeof(a_slots), 0);
+  if (size < 0) {
+    raft_hard_state_close(p_file);
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  raft_bool_t found = RAFT_FALSE;
+  for (uint32_t ii = 0; ii < 2; ++ii) {
+    raft_hard_state_t hard_state;
+    uint64_t sequence;
+    if (RAFT_SUCCESS(raft_hard_state_decode(
+            &a_slots[ii * RAFT_HARD_STATE_SIZE], &hard_state, &sequence)) &&
+        (!found || sequence > p_file->sequence)) {
+      *p_hard_state = hard_state;
+      p_file->sequence = sequence;
+      found = RAFT_TRUE;
+    }
+  }
+
+  /* Starting over from term 0 could cast a second vote in a term. */
+  if (!found && size > 0) {
+    raft_hard_state_close(p_file);
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  *pp_file = p_file;
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_hard_state_save(raft_hard_state_file_t* p_file,
+                                   raft_hard_state_t const* p_hard_state) {
+  uint64_t const sequence = p_file->sequence + 1;
+  uint8_t a_slot[RAFT_HARD_STATE_SIZE];
+  raft_hard_state_encode(p_hard_state, sequence, a_slot);
+
+  off_t const offset = (sequence % 2) * RAFT_HARD_STATE_SIZE;
+  if (pwrite(p_file->fd, a_slot, sizeof(a_slot), offset) !=
+      sizeof(a_slot)) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  p_file->sequence = sequence;
+  return RAFT_STATUS_OK;
+}
+
+void raft_hard_state_close(raft_hard_state_file_t* p_file) {
+  if (p_file == NULL) {
+    return;
+  }
+  close(p_file->fd);
+  free(p_file);
+}
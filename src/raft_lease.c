@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "raft.h"
+#include "raft_lease.h"
+#include "raft_config.h"
+#include "raft_log.h"
+#include "raft_membership.h"
+#include "raft_state.h"
+#include "raft_util.h"
+
+static uint64_t lease_duration_ms(raft_config_t const* p_config) {
+  return p_config->election_timeout_min_ms - p_config->lease_drift_ms;
+}
+
+void raft_lease_start(raft_state_t* p_state) {
+  raft_lease_drop(p_state);
+  p_state->ls.first_seq = p_state->rd.seq + 1;
+}
+
+void raft_lease_sent(raft_state_t* p_state, uint32_t seq) {
+  p_state->ls.a_round_sent_ms[seq % RAFT_LEASE_ROUND_HISTORY] =
+      p_state->v.clock_ms;
+}
+
+void raft_lease_ack(raft_state_t* p_state,
+                    raft_nodeid_t follower_id,
+                    uint32_t seq) {
+  /* Rounds too old to remember simply do not extend the lease. */
+  if (seq < p_state->ls.first_seq ||
+      seq > p_state->rd.seq ||
+      p_state->rd.seq - seq >= RAFT_LEASE_ROUND_HISTORY) {
+    return;
+  }
+
+  uint64_t const expiry_ms = (
+      p_state->ls.a_round_sent_ms[seq % RAFT_LEASE_ROUND_HISTORY] +
+      lease_duration_ms(p_state->p_config));
+  uint64_t* p_expiry_ms = &p_state->ls.p_expiry_ms[follower_id - 1];
+  *p_expiry_ms = MAX(*p_expiry_ms, expiry_ms);
+}
+
+raft_bool_t raft_lease_valid(raft_state_t const* p_state) {
+  raft_config_t const* p_config = p_state->p_config;
+  if (!p_config->lease_reads || p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return RAFT_FALSE;
+  }
+
+  /* The transfer target's election ignores the lease. */
+  if (p_state->l.transfer_id != 0) {
+    return RAFT_FALSE;
+  }
+
+  /**
+   * The lease lasts until the majority-th latest expiry, counting this
+   * node's own as current.
+   */
+  uint64_t const clock_ms = p_state->v.clock_ms;
+  raft_tally_t later = { 0 };
+  raft_tally_add(p_state, &later, p_state->p.self);
+  for (uint32_t i = 0; i < p_state->m.peer_count; ++i) {
+    raft_nodeid_t const id = p_state->m.p_peers[i];
+    if (p_state->ls.p_expiry_ms[id - 1] > clock_ms) {
+      raft_tally_add(p_state, &later, id);
+    }
+  }
+  return raft_tally_is_quorum(p_state, &later);
+}
+
+void raft_lease_drop(raft_state_t* p_state) {
+  memset(p_state->ls.p_expiry_ms, 0,
+         p_state->m.capacity * sizeof(*p_state->ls.p_expiry_ms));
+}
+
+raft_status_t raft_lease_read(raft_state_t* p_state,
+                              raft_index_t* p_read_index) {
+  if (p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return RAFT_STATUS_NOT_LEADER;
+  }
+  if (!raft_lease_valid(p_state)) {
+    return RAFT_STATUS_LEASE_EXPIRED;
+  }
+
+  /* Local state must already cover everything earlier leaders committed. */
+  raft_index_t const commit_index = p_state->v.commit_index;
+  if (p_state->v.last_applied < commit_index ||
+      raft_log_entry(p_state->p.p_log, commit_index)->term !=
+      p_state->p.current_term) {
+    return RAFT_STATUS_LEASE_EXPIRED;
+  }
+
+  *p_read_index = commit_index;
+  return RAFT_STATUS_OK;
+}
@@ -4,20 +4,47 @@
 #include "raft_log.h"
 #include "raft_util.h"
 
+/* Payloads of up to RAFT_LOG_INLINE_SIZE bytes are copied into the node
+ * beside their entry rather than kept in an allocation of their own. */
+#define RAFT_LOG_INLINE_SIZE 64
+
+#define RAFT_LOG_NODE_SIZE 8192
+
+/* Larger payloads are copied into blocks of at least this size, owned by the
+ * node and freed along with it. */
+#define RAFT_LOG_BLOCK_SIZE 16384
+
 #define RAFT_LOG_NODE_ENTRY_COUNT \
-  ((2048 - 2*sizeof(struct raft_log_node*))/sizeof(raft_log_entry_t))
+  ((RAFT_LOG_NODE_SIZE - 2*sizeof(struct raft_log_block*)) / \
+   (sizeof(raft_log_entry_t) + RAFT_LOG_INLINE_SIZE))
+
+typedef struct raft_log_block {
+  struct raft_log_block* p_prev;
+  uint32_t size;
+  uint32_t used;
+  uint8_t a_data[];
+} raft_log_block_t;
 
 typedef struct raft_log_node {
   raft_log_entry_t a_entries[RAFT_LOG_NODE_ENTRY_COUNT];
-  struct raft_log_node* p_next;
+  uint8_t a_inline[RAFT_LOG_NODE_ENTRY_COUNT][RAFT_LOG_INLINE_SIZE];
+
+  /* The payload arena, newest block first. */
+  raft_log_block_t* p_blocks;
+
+  /* Payloads raft_log_restore() put in place of fragments, one per block.
+   * They come after the arena's entry order, so are kept out of it. */
+  raft_log_block_t* p_restored;
 } raft_log_node_t;
 
 typedef struct raft_log {
   raft_index_t num_entries;
   raft_index_t capacity;
 
-  raft_log_node_t* p_head;
-  raft_log_node_t* p_tail;
+  /* Node i holds the entries from i * RAFT_LOG_NODE_ENTRY_COUNT on. */
+  raft_log_node_t** pp_nodes;
+  uint32_t num_nodes;
+  uint32_t node_capacity;
 } raft_log_t;
 
 raft_log_t* raft_log_alloc() {
@@ -26,38 +53,141 @@ raft_log_t* raft_log_alloc() {
     return NULL;
   }
 
+  p_log->node_capacity = 8;
+  p_log->pp_nodes = malloc(p_log->node_capacity * sizeof(raft_log_node_t*));
   raft_log_node_t* p_entry_nodes = calloc(1, sizeof(raft_log_node_t));
-  if (p_entry_nodes == NULL) {
+  if (p_log->pp_nodes == NULL || p_entry_nodes == NULL) {
+    free(p_log->pp_nodes);
     free(p_log);
     return NULL;
   }
 
   p_entry_nodes->a_entries[0].type = RAFT_LOG_ENTRY_TYPE_SYSTEM;
-  p_log->p_head = p_log->p_tail = p_entry_nodes;
+  p_log->pp_nodes[0] = p_entry_nodes;
+  p_log->num_nodes = 1;
   p_log->num_entries = 1;
 
   return p_log;
 }
 
-void raft_log_free(raft_log_t* p_log) {
-  if (p_log == NULL) return;
+/**
+ * Copies the payload of the node's entry ii into the node, inline if it fits
+ * and into its arena otherwise. Returns the copy, or NULL if out of memory.
+ */
+static void* copy_data(raft_log_node_t* p_node,
+                       uint32_t ii,
+                       void const* p_data,
+                       uint32_t data_size) {
+  if (data_size <= RAFT_LOG_INLINE_SIZE) {
+    return memcpy(p_node->a_inline[ii], p_data, data_size);
+  }
 
-  raft_log_node_t* p_cur = p_log->p_head;
-  while (p_cur) {
-    for (uint32_t ii = 0; ii < RAFT_LOG_NODE_ENTRY_COUNT; ++ii) {
-      free(p_cur->a_entries[ii].p_data);
+  uint32_t const size = RAFT_ALIGN_UP(data_size, sizeof(void*));
+  raft_log_block_t* p_block = p_node->p_blocks;
+  if (p_block == NULL || p_block->size - p_block->used < size) {
+    uint32_t const block_size = MAX(RAFT_LOG_BLOCK_SIZE, size);
+    p_block = malloc(sizeof(raft_log_block_t) + block_size);
+    if (p_block == NULL) {
+      return NULL;
     }
-    raft_log_node_t* p_next = p_cur->p_next;
-    free(p_cur);
-    p_cur = p_next;
+    p_block->p_prev = p_node->p_blocks;
+    p_block->size = block_size;
+    p_block->used = 0;
+    p_node->p_blocks = p_block;
+  }
+
+  void* p_copy = p_block->a_data + p_block->used;
+  p_block->used += size;
+  return memcpy(p_copy, p_data, data_size);
+}
+
+/**
+ * Releases the node's arena from the payload at p_mark on. Payloads are
+ * allocated in entry order, so this frees those of the entries from the one
+ * p_mark belongs to.
+ */
+static void rewind_arena(raft_log_node_t* p_node, uint8_t const* p_mark) {
+  raft_log_block_t* p_block = p_node->p_blocks;
+  while (p_block &&
+         (p_mark < p_block->a_data ||
+          p_mark >= p_block->a_data + p_block->used)) {
+    raft_log_block_t* p_prev = p_block->p_prev;
+    free(p_block);
+    p_block = p_prev;
+  }
+  p_node->p_blocks = p_block;
+  if (p_block) {
+    p_block->used = p_mark - p_block->a_data;
+  }
+}
+
+static void free_blocks(raft_log_block_t* p_block) {
+  while (p_block) {
+    raft_log_block_t* p_prev = p_block->p_prev;
+    free(p_block);
+    p_block = p_prev;
   }
-  p_log->p_head = p_log->p_tail = NULL;
+}
+
+static void free_arena(raft_log_node_t* p_node) {
+  free_blocks(p_node->p_blocks);
+  free_blocks(p_node->p_restored);
+  p_node->p_blocks = NULL;
+  p_node->p_restored = NULL;
+}
+
+/**
+ * Frees the restored payload at p_data, returning RAFT_FALSE if p_data is
+ * not one.
+ */
+static raft_bool_t release_restored(raft_log_node_t* p_node,
+                                    void const* p_data) {
+  for (raft_log_block_t** pp_block = &p_node->p_restored;
+       *pp_block;
+       pp_block = &(*pp_block)->p_prev) {
+    raft_log_block_t* p_block = *pp_block;
+    if (p_block->a_data == p_data) {
+      *pp_block = p_block->p_prev;
+      free(p_block);
+      return RAFT_TRUE;
+    }
+  }
+  return RAFT_FALSE;
+}
+
+/**
+ * Frees the nodes from node_index on.
+ */
+static void free_nodes(raft_log_t* p_log, uint32_t node_index) {
+  for (uint32_t ii = node_index; ii < p_log->num_nodes; ++ii) {
+    free_arena(p_log->pp_nodes[ii]);
+    free(p_log->pp_nodes[ii]);
+  }
+  p_log->num_nodes = MIN(p_log->num_nodes, node_index);
+}
+
+void raft_log_free(raft_log_t* p_log) {
+  if (p_log == NULL) return;
+
+  free_nodes(p_log, 0);
+  free(p_log->pp_nodes);
   free(p_log);
 }
 
 static raft_log_node_t* get_vacant_node(raft_log_t* p_log) {
   if (raft_log_length(p_log) % RAFT_LOG_NODE_ENTRY_COUNT != 0) {
-    return p_log->p_tail;
+    return p_log->pp_nodes[p_log->num_nodes - 1];
+  }
+
+  if (p_log->num_nodes == p_log->node_capacity) {
+    uint32_t const capacity = 2 * p_log->node_capacity;
+    raft_log_node_t** pp_nodes =
+        realloc(p_log->pp_nodes, capacity * sizeof(raft_log_node_t*));
+    if (pp_nodes == NULL) {
+      return NULL;
+    }
+    p_log->pp_nodes = pp_nodes;
+    p_log->node_capacity = capacity;
   }
 
   raft_log_node_t* p_node = calloc(1, sizeof(raft_log_node_t));
@@ -65,9 +195,7 @@ static raft_log_node_t* get_vacant_node(raft_log_t* p_log) {
     return NULL;
   }
 
-  p_log->p_tail->p_next = p_node;
-  p_log->p_tail = p_node;
-
+  p_log->pp_nodes[p_log->num_nodes++] = p_node;
   return p_node;
 }
 
@@ -77,20 +205,16 @@ raft_index_t raft_log_length(raft_log_t const* p_log) {
 
 static raft_log_node_t* raft_log_node(raft_log_t const* p_log,
                                       raft_index_t index) {
-  raft_log_node_t* p_node = p_log->p_head;
-  for (; index > 0; --index) {
-    RAFT_ASSERT(p_node);
-    p_node = p_node->p_next;
-  }
-  return p_node;
+  RAFT_ASSERT(index < p_log->num_nodes);
+  return p_log->pp_nodes[index];
 }
 
 raft_log_entry_t const* raft_log_entry(raft_log_t const* p_log, int32_t index) {
   if (index < 0) {
-    index = p_log->num_entries + index;
+    index = (int32_t)p_log->num_entries + index;
   }
 
-  RAFT_ASSERT_STR(index >= 0 && index < p_log->num_entries,
+  RAFT_ASSERT_STR(index >= 0 && index < (int32_t)p_log->num_entries,
                   "index: %d", index);
 
   raft_index_t node_index = index / RAFT_LOG_NODE_ENTRY_COUNT;
@@ -111,13 +235,28 @@ raft_status_t raft_log_append_user(raft_log_t* p_log,
     return RAFT_STATUS_OUT_OF_MEMORY;
   }
 
+  /* The log keeps its own copy, so that payloads are freed with their node
+   * rather than one by one. */
   uint32_t const index = raft_log_length(p_log) % RAFT_LOG_NODE_ENTRY_COUNT;
+  if (p_data) {
+    void* p_copy = data_size ? copy_data(p_node, index, p_data, data_size)
+                             : NULL;
+    if (data_size && p_copy == NULL) {
+      return RAFT_STATUS_OUT_OF_MEMORY;
+    }
+    free(p_data);
+    p_data = p_copy;
+  }
+
   raft_log_entry_t* p_entry = &p_node->a_entries[index];
   p_entry->unique_id = unique_id;
   p_entry->term = term;
   p_entry->type = RAFT_LOG_ENTRY_TYPE_USER;
   p_entry->p_data = p_data;
   p_entry->data_size = data_size;
+  p_entry->coded_size = 0;
+  p_entry->fragments_needed = 0;
+  p_entry->fragment_index = 0;
   p_entry->replication_count = 0;
 
   ++p_log->num_entries;
@@ -125,11 +264,142 @@ raft_status_t raft_log_append_user(raft_log_t* p_log,
   return RAFT_STATUS_OK;
 }
 
+raft_status_t raft_log_append_coded(raft_log_t* p_log,
+                                    uint32_t unique_id,
+                                    raft_term_t term,
+                                    void* p_data,
+                                    uint32_t data_size,
+                                    uint32_t fragments_needed) {
+  raft_status_t const status = raft_log_append_user(p_log, unique_id, term,
+                                                    p_data, data_size);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  raft_index_t const index = raft_log_length(p_log) - 1;
+  raft_log_entry_t* p_entry =
+      &p_log->pp_nodes[p_log->num_nodes - 1]->a_entries[
+          index % RAFT_LOG_NODE_ENTRY_COUNT];
+  p_entry->coded_size = data_size;
+  p_entry->fragments_needed = fragments_needed;
+  p_entry->fragment_index = RAFT_FRAGMENT_WHOLE;
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_log_restore(raft_log_t* p_log,
+                               raft_index_t index,
+                               void const* p_data) {
+  raft_log_node_t* p_node = raft_log_node(p_log,
+                                          index / RAFT_LOG_NODE_ENTRY_COUNT);
+  uint32_t const ii = index % RAFT_LOG_NODE_ENTRY_COUNT;
+  raft_log_entry_t* p_entry = &p_node->a_entries[ii];
+  RAFT_ASSERT(p_entry->fragments_needed != 0 &&
+              p_entry->fragment_index != RAFT_FRAGMENT_WHOLE);
+
+  /* The fragment's own space is left to be freed with the rest of the
+   * arena. */
+  uint32_t const size = p_entry->coded_size;
+  void* p_copy = p_node->a_inline[ii];
+  if (size > RAFT_LOG_INLINE_SIZE) {
+    raft_log_block_t* p_block = malloc(sizeof(raft_log_block_t) + size);
+    if (p_block == NULL) {
+      return RAFT_STATUS_OUT_OF_MEMORY;
+    }
+    p_block->p_prev = p_node->p_restored;
+    p_block->size = p_block->used = size;
+    p_node->p_restored = p_block;
+    p_copy = p_block->a_data;
+  }
+
+  p_entry->p_data = memcpy(p_copy, p_data, size);
+  p_entry->data_size = size;
+  p_entry->fragment_index = RAFT_FRAGMENT_WHOLE;
+  return RAFT_STATUS_OK;
+}
+
+static raft_status_t append(raft_log_t* p_log,
+                            raft_log_entry_t const* p_entries,
+                            uint32_t num_entries,
+                            raft_bool_t keep_user_data) {
+  for (uint32_t ii = 0; ii < num_entries; ++ii) {
+    raft_log_entry_t const* p_src = &p_entries[ii];
+
+    raft_log_node_t* p_node = get_vacant_node(p_log);
+    if (p_node == NULL) {
+      return RAFT_STATUS_OUT_OF_MEMORY;
+    }
+
+    uint32_t const index = raft_log_length(p_log) % RAFT_LOG_NODE_ENTRY_COUNT;
+    void* p_data = NULL;
+    if (p_src->data_size && p_src->p_data &&
+        (keep_user_data || p_src->type != RAFT_LOG_ENTRY_TYPE_USER)) {
+      p_data = copy_data(p_node, index, p_src->p_data, p_src->data_size);
+      if (p_data == NULL) {
+        return RAFT_STATUS_OUT_OF_MEMORY;
+      }
+    }
+
+    raft_log_entry_t* p_entry = &p_node->a_entries[index];
+    *p_entry = *p_src;
+    p_entry->p_data = p_data;
+    p_entry->replication_count = 0;
+
+    ++p_log->num_entries;
+  }
+
+  return RAFT_STATUS_OK;
+}
+
 raft_status_t raft_log_append(raft_log_t* p_log,
-                              raft_log_entry_t* p_entries,
+                              raft_log_entry_t const* p_entries,
                               uint32_t num_entries) {
-  if (p_entries) {
-    RAFT_ASSERT(RAFT_FALSE);
+  return append(p_log, p_entries, num_entries, RAFT_TRUE);
+}
+
+raft_status_t raft_log_append_metadata(raft_log_t* p_log,
+                                       raft_log_entry_t const* p_entries,
+                                       uint32_t num_entries) {
+  return append(p_log, p_entries, num_entries, RAFT_FALSE);
+}
+
+void raft_log_truncate(raft_log_t* p_log, raft_index_t index) {
+  /* The sentinel entry at index 0 is never removed. */
+  RAFT_ASSERT(index > 0);
+  if (index >= p_log->num_entries) {
+    return;
   }
-  return RAFT_STATUS_OK;
+
+  uint32_t const tail_index = (index - 1) / RAFT_LOG_NODE_ENTRY_COUNT;
+  raft_log_node_t* p_tail = raft_log_node(p_log, tail_index);
+  uint8_t const* p_mark = NULL;
+  for (uint32_t ii = (index - 1) % RAFT_LOG_NODE_ENTRY_COUNT + 1;
+       ii < RAFT_LOG_NODE_ENTRY_COUNT;
+       ++ii) {
+    raft_log_entry_t* p_entry = &p_tail->a_entries[ii];
+    if (p_mark == NULL && p_entry->p_data &&
+        p_entry->p_data != p_tail->a_inline[ii] &&
+        !release_restored(p_tail, p_entry->p_data)) {
+      p_mark = p_entry->p_data;
+    }
+    memset(p_entry, 0, sizeof(raft_log_entry_t));
+  }
+  if (p_mark) {
+    rewind_arena(p_tail, p_mark);
+  }
+
+  free_nodes(p_log, tail_index + 1);
+  p_log->num_entries = index;
+}
+
+uint32_t raft_log_entries(raft_log_t const* p_log,
+                          raft_index_t index,
+                          raft_log_entry_t const** pp_entries) {
+  if (index >= p_log->num_entries) {
+    *pp_entries = NULL;
+    return 0;
+  }
+
+  *pp_entries = raft_log_entry(p_log, index);
+  return MIN(RAFT_LOG_NODE_ENTRY_COUNT - index % RAFT_LOG_NODE_ENTRY_COUNT,
+             p_log->num_entries - index);
 }
@@ -0,0 +1,595 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "raft_membership.h"
+#include "raft_config.h"
+#include "raft_election.h"
+#include "raft_log.h"
+#include "raft_replication.h"
+#include "raft_state.h"
+#include "raft_util.h"
+
+#define ROLES_MEMBER (RAFT_ROLE_MEMBER | RAFT_ROLE_MEMBER_NEW)
+#define ROLES_VOTER  (RAFT_ROLE_VOTER | RAFT_ROLE_VOTER_NEW)
+#define ROLES_NEW    (RAFT_ROLE_MEMBER_NEW | RAFT_ROLE_VOTER_NEW)
+
+#define GROW(_p_array, _old_count, _new_count)                          \
+  grow((void**)&(_p_array), sizeof(*(_p_array)), (_old_count), (_new_count))
+
+static raft_status_t reserve(raft_state_t* p_state, uint32_t capacity);
+static raft_status_t apply_entry(raft_state_t* p_state,
+                                 raft_log_entry_t const* p_entry);
+static raft_status_t append_config(raft_state_t* p_state,
+                                   raft_member_t const* p_members,
+                                   uint32_t num_members);
+static raft_bool_t is_config_entry(raft_log_entry_t const* p_entry);
+static raft_bool_t quorum_sizes(raft_config_t const* p_config,
+                                uint32_t weight,
+                                uint32_t* p_replication,
+                                uint32_t* p_election);
+static raft_bool_t tally_is_quorum(raft_state_t const* p_state,
+                                   raft_tally_t const* p_tally,
+                                   raft_bool_t election);
+
+raft_status_t raft_membership_init(raft_state_t* p_state) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  uint32_t const num_members = p_config->node_count;
+  raft_member_t* p_members = calloc(num_members, sizeof(*p_members));
+  if (p_members == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+
+  p_members[0].id = p_state->p.self;
+  for (uint32_t i = 1; i < num_members; ++i) {
+    p_members[i].id = p_config->p_nodeids[i - 1];
+  }
+  for (uint32_t i = 0; i < num_members; ++i) {
+    p_members[i].roles = RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER;
+  }
+
+  raft_status_t status = RAFT_STATUS_OK;
+  for (uint32_t i = 0; i < p_config->learner_count; ++i) {
+    raft_nodeid_t const id = p_config->p_learner_ids[i];
+    uint32_t j = 0;
+    while (j < num_members && p_members[j].id != id) ++j;
+    if (j == num_members) {
+      RAFT_LOG(p_state, "Invalid learner id: %u", id);
+      status = RAFT_STATUS_INVALID_ARGS;
+      break;
+    }
+    p_members[j].roles = RAFT_ROLE_MEMBER;
+  }
+  for (uint32_t i = 0;
+       i < p_config->witness_count && RAFT_SUCCESS(status);
+       ++i) {
+    raft_nodeid_t const id = p_config->p_witness_ids[i];
+    uint32_t j = 0;
+    while (j < num_members && p_members[j].id != id) ++j;
+    if (j == num_members) {
+      RAFT_LOG(p_state, "Invalid witness id: %u", id);
+      status = RAFT_STATUS_INVALID_ARGS;
+      break;
+    }
+    p_members[j].roles |= RAFT_ROLE_WITNESS;
+  }
+
+  if (RAFT_SUCCESS(status)) {
+    status = raft_membership_apply(p_state, p_members, num_members);
+    p_state->m.config_index = 0;
+  }
+  free(p_members);
+
+  uint32_t replication, election;
+  if (RAFT_SUCCESS(status) &&
+      !quorum_sizes(p_config, p_state->m.a_weights[0],
+                    &replication, &election)) {
+    RAFT_LOG(p_state,
+             "Invalid quorum settings: replication_quorum (%u) and "
+             "election_quorum (%u) do not intersect, or election quorums "
+             "do not intersect each other, among voters of weight %u",
+             p_config->replication_quorum,
+             p_config->election_quorum,
+             p_state->m.a_weights[0]);
+    status = RAFT_STATUS_INVALID_ARGS;
+  }
+  return status;
+}
+
+void raft_membership_free(raft_state_t* p_state) {
+  free(p_state->m.p_roles);
+  free(p_state->m.p_weights);
+  free(p_state->m.p_peers);
+}
+
+raft_status_t raft_membership_apply(raft_state_t* p_state,
+                                    raft_member_t const* p_members,
+                                    uint32_t num_members) {
+  raft_nodeid_t max_id = p_state->p.self;
+  for (uint32_t i = 0; i < num_members; ++i) {
+    if (p_members[i].id == 0) {
+      return RAFT_STATUS_INVALID_ARGS;
+    }
+    max_id = MAX(max_id, p_members[i].id);
+  }
+
+  raft_status_t status = reserve(p_state, max_id);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  uint8_t* p_roles = p_state->m.p_roles;
+  if (p_state->type == RAFT_NODE_TYPE_LEADER) {
+    raft_index_t const log_length = raft_log_length(p_state->p.p_log);
+    for (uint32_t i = 0; i < num_members; ++i) {
+      raft_nodeid_t const id = p_members[i].id;
+      if (id == p_state->p.self || (p_roles[id - 1] & ROLES_MEMBER)) {
+        continue;
+      }
+      p_state->l.p_next_index[id - 1] = log_length;
+      p_state->l.p_match_index[id - 1] = 0;
+      p_state->l.p_last_ack_ms[id - 1] = p_state->v.clock_ms;
+      p_state->l.p_ping_due_ms[id - 1] = 0;
+      p_state->l.p_rtt_seq[id - 1] = 0;
+      p_state->l.p_rtt_pending[id - 1] = RAFT_FALSE;
+      p_state->l.p_rtt_count[id - 1] = 0;
+      p_state->l.p_hint_ms[id - 1] = 0;
+      p_state->rd.p_acked_seq[id - 1] = 0;
+      p_state->ls.p_expiry_ms[id - 1] = 0;
+    }
+  }
+
+  memset(p_roles, 0, p_state->m.capacity * sizeof(*p_roles));
+  for (raft_nodeid_t id = 1; id <= p_state->m.capacity; ++id) {
+    p_state->m.p_weights[id - 1] =
+        raft_membership_node_weight(p_state->p_config, id);
+  }
+  memset(p_state->m.a_weights, 0, sizeof(p_state->m.a_weights));
+  p_state->m.peer_count = 0;
+  p_state->m.joint = RAFT_FALSE;
+
+  for (uint32_t i = 0; i < num_members; ++i) {
+    raft_nodeid_t const id = p_members[i].id;
+    uint32_t const roles = p_members[i].roles;
+    p_roles[id - 1] = roles;
+
+    if (id != p_state->p.self && (roles & ROLES_MEMBER)) {
+      p_state->m.p_peers[p_state->m.peer_count++] = id;
+    }
+    if (roles & RAFT_ROLE_VOTER) {
+      p_state->m.a_weights[0] += p_state->m.p_weights[id - 1];
+    }
+    if (roles & RAFT_ROLE_VOTER_NEW) {
+      p_state->m.a_weights[1] += p_state->m.p_weights[id - 1];
+    }
+    if (roles & ROLES_NEW) {
+      p_state->m.joint = RAFT_TRUE;
+    }
+  }
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_membership_propose(raft_state_t* p_state,
+                                      raft_nodeid_t const* p_voter_ids,
+                                      uint32_t voter_count,
+                                      raft_nodeid_t const* p_learner_ids,
+                                      uint32_t learner_count) {
+  raft_config_t const* p_config = p_state->p_config;
+  uint32_t weight = 0;
+  for (uint32_t i = 0; i < voter_count; ++i) {
+    weight += raft_membership_node_weight(p_config, p_voter_ids[i]);
+  }
+  uint32_t replication, election;
+  if (voter_count == 0 ||
+      !quorum_sizes(p_config, weight, &replication, &election)) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  uint32_t const new_count = voter_count + learner_count;
+  raft_member_t* p_members = calloc(p_state->m.peer_count + 1 + new_count,
+                                    sizeof(*p_members));
+  if (p_members == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+
+  /* Start from the current configuration... */
+  uint32_t num_members = 0;
+  for (raft_nodeid_t id = 1; id <= p_state->m.capacity; ++id) {
+    if (p_state->m.p_roles[id - 1] & RAFT_ROLE_MEMBER) {
+      p_members[num_members].id = id;
+      p_members[num_members++].roles = p_state->m.p_roles[id - 1];
+    }
+  }
+
+  /* ...and add the roles of the new one. */
+  raft_status_t status = RAFT_STATUS_OK;
+  for (uint32_t i = 0; i < new_count && RAFT_SUCCESS(status); ++i) {
+    raft_nodeid_t const id = (i < voter_count ?
+                              p_voter_ids[i] :
+                              p_learner_ids[i - voter_count]);
+    uint32_t j = 0;
+    while (j < num_members && p_members[j].id != id) ++j;
+    if (id == 0 || (j < num_members && (p_members[j].roles & ROLES_NEW))) {
+      status = RAFT_STATUS_INVALID_ARGS;
+      break;
+    }
+    if (j == num_members) {
+      p_members[num_members++].id = id;
+    }
+    p_members[j].roles |= (i < voter_count ?
+                           RAFT_ROLE_MEMBER_NEW | RAFT_ROLE_VOTER_NEW :
+                           RAFT_ROLE_MEMBER_NEW);
+  }
+
+  if (RAFT_SUCCESS(status)) {
+    status = append_config(p_state, p_members, num_members);
+  }
+  free(p_members);
+  return status;
+}
+
+raft_bool_t raft_membership_changing(raft_state_t const* p_state) {
+  return (p_state->m.joint ||
+          p_state->m.config_index > p_state->v.commit_index);
+}
+
+raft_status_t raft_membership_appended(raft_state_t* p_state,
+                                       raft_index_t index) {
+  raft_log_t const* p_log = p_state->p.p_log;
+  for (raft_index_t i = raft_log_length(p_log); i-- > MAX(index, 1);) {
+    raft_log_entry_t const* p_entry = raft_log_entry(p_log, i);
+    if (is_config_entry(p_entry)) {
+      raft_status_t const status = apply_entry(p_state, p_entry);
+      if (RAFT_SUCCESS(status)) {
+        p_state->m.config_index = i;
+      }
+      return status;
+    }
+  }
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_membership_truncated(raft_state_t* p_state,
+                                        raft_index_t index) {
+  if (p_state->m.config_index < index) {
+    return RAFT_STATUS_OK;
+  }
+
+  RAFT_LOG(p_state, "Configuration at %u truncated.", p_state->m.config_index);
+
+  raft_log_t const* p_log = p_state->p.p_log;
+  for (raft_index_t i = MIN(index, raft_log_length(p_log)); i-- > 1;) {
+    raft_log_entry_t const* p_entry = raft_log_entry(p_log, i);
+    if (is_config_entry(p_entry)) {
+      raft_status_t const status = apply_entry(p_state, p_entry);
+      if (RAFT_SUCCESS(status)) {
+        p_state->m.config_index = i;
+      }
+      return status;
+    }
+  }
+  return raft_membership_init(p_state);
+}
+
+void raft_membership_committed(raft_state_t* p_state) {
+  if (p_state->type != RAFT_NODE_TYPE_LEADER ||
+      p_state->m.config_index == 0 ||
+      p_state->m.config_index > p_state->v.commit_index) {
+    return;
+  }
+
+  if (!p_state->m.joint) {
+    if (!raft_membership_is_voter(p_state, p_state->p.self)) {
+      RAFT_LOG(p_state, "No longer a voter; stepping down.");
+      raft_state_set_type(p_state, RAFT_NODE_TYPE_FOLLOWER);
+      p_state->v.leader_id = 0;
+      raft_reset_election_timer(p_state);
+    }
+    return;
+  }
+
+  /* The joint configuration is committed; move on to the new one. */
+  raft_member_t* p_members = calloc(p_state->m.capacity, sizeof(*p_members));
+  if (p_members == NULL) {
+    /* Retried as the commit index next advances. */
+    return;
+  }
+
+  uint32_t num_members = 0;
+  for (raft_nodeid_t id = 1; id <= p_state->m.capacity; ++id) {
+    uint8_t const roles = p_state->m.p_roles[id - 1];
+    if (roles & ROLES_NEW) {
+      p_members[num_members].id = id;
+      p_members[num_members++].roles = ((roles & ROLES_NEW) >> 2 |
+                                        (roles & RAFT_ROLE_WITNESS));
+    }
+  }
+
+  raft_status_t const status = append_config(p_state, p_members, num_members);
+  free(p_members);
+  if (RAFT_SUCCESS(status)) {
+    raft_replicate(p_state);
+    raft_advance_commit_index(p_state);
+  }
+}
+
+raft_bool_t raft_membership_is_member(raft_state_t const* p_state,
+                                      raft_nodeid_t node_id) {
+  return (node_id > 0 && node_id <= p_state->m.capacity &&
+          (p_state->m.p_roles[node_id - 1] & ROLES_MEMBER));
+}
+
+raft_bool_t raft_membership_is_voter(raft_state_t const* p_state,
+                                     raft_nodeid_t node_id) {
+  return (node_id > 0 && node_id <= p_state->m.capacity &&
+          (p_state->m.p_roles[node_id - 1] & ROLES_VOTER));
+}
+
+uint32_t raft_membership_node_weight(raft_config_t const* p_config,
+                                     raft_nodeid_t node_id) {
+  for (uint32_t i = 0; i < p_config->preference_count; ++i) {
+    if (p_config->p_preferences[i].id == node_id) {
+      return p_config->p_preferences[i].vote_weight;
+    }
+  }
+  return 1;
+}
+
+raft_bool_t raft_membership_is_witness(raft_state_t const* p_state,
+                                       raft_nodeid_t node_id) {
+  return (node_id > 0 && node_id <= p_state->m.capacity &&
+          (p_state->m.p_roles[node_id - 1] & RAFT_ROLE_WITNESS));
+}
+
+raft_bool_t raft_membership_can_lead(raft_state_t const* p_state,
+                                     raft_nodeid_t node_id) {
+  return (raft_membership_is_voter(p_state, node_id) &&
+          !raft_membership_is_witness(p_state, node_id));
+}
+
+void raft_tally_add(raft_state_t const* p_state,
+                    raft_tally_t* p_tally,
+                    raft_nodeid_t node_id) {
+  if (node_id == 0 || node_id > p_state->m.capacity) {
+    return;
+  }
+
+  uint8_t const roles = p_state->m.p_roles[node_id - 1];
+  uint32_t const weight = p_state->m.p_weights[node_id - 1];
+  if (roles & RAFT_ROLE_VOTER) {
+    p_tally->a_votes[0] += weight;
+  }
+  if (roles & RAFT_ROLE_VOTER_NEW) {
+    p_tally->a_votes[1] += weight;
+  }
+}
+
+raft_bool_t raft_tally_is_quorum(raft_state_t const* p_state,
+                                 raft_tally_t const* p_tally) {
+  return tally_is_quorum(p_state, p_tally, RAFT_FALSE);
+}
+
+raft_bool_t raft_membership_ballot_won(raft_state_t const* p_state) {
+  raft_tally_t tally = { 0 };
+  for (raft_nodeid_t id = 1; id <= p_state->m.capacity; ++id) {
+    if (p_state->l.p_ballot[id - 1]) {
+      raft_tally_add(p_state, &tally, id);
+    }
+  }
+  return tally_is_quorum(p_state, &tally, RAFT_TRUE);
+}
+
+uint32_t raft_membership_coded_quorum(raft_state_t const* p_state,
+                                      uint32_t fragments_needed) {
+  /* Fragments are counted by node, so every voter must weigh the same. */
+  if (p_state->m.joint) {
+    return 0;
+  }
+  uint32_t voter_count = 0;
+  for (raft_nodeid_t id = 1; id <= p_state->m.capacity; ++id) {
+    if (raft_membership_is_voter(p_state, id)) {
+      if (p_state->m.p_weights[id - 1] != 1) {
+        return 0;
+      }
+      ++voter_count;
+    }
+  }
+
+  uint32_t replication;
+  uint32_t election;
+  if (!quorum_sizes(p_state->p_config, p_state->m.a_weights[0],
+                    &replication, &election) ||
+      fragments_needed > election) {
+    return 0;
+  }
+  /* An election quorum misses at most voter_count - election holders. */
+  return MAX(replication, voter_count - election + fragments_needed);
+}
+
+raft_bool_t raft_membership_holds_fragment(raft_state_t const* p_state,
+                                           raft_nodeid_t node_id) {
+  return (raft_membership_is_voter(p_state, node_id) &&
+          !raft_membership_is_witness(p_state, node_id));
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ******************************************************************************/
+
+/**
+ * Resolves the replication and election quorum sizes among voters of the
+ * given total weight, returning RAFT_FALSE if they do not fit or do not
+ * intersect. Election quorums must also intersect each other, or two
+ * leaders could be elected in one term.
+ */
+static raft_bool_t quorum_sizes(raft_config_t const* p_config,
+                                uint32_t weight,
+                                uint32_t* p_replication,
+                                uint32_t* p_election) {
+  uint32_t replication = p_config->replication_quorum;
+  uint32_t election = p_config->election_quorum;
+  if (weight == 0 || replication > weight || election > weight) {
+    return RAFT_FALSE;
+  }
+
+  if (replication == 0 && election == 0) {
+    replication = election = weight / 2 + 1;
+  } else if (replication == 0) {
+    replication = weight - election + 1;
+  } else if (election == 0) {
+    election = MAX(weight - replication + 1, weight / 2 + 1);
+  }
+
+  *p_replication = replication;
+  *p_election = election;
+  return replication + election > weight && 2 * election > weight;
+}
+
+static raft_bool_t tally_is_quorum(raft_state_t const* p_state,
+                                   raft_tally_t const* p_tally,
+                                   raft_bool_t election) {
+  uint32_t const halves = p_state->m.joint ? 2 : 1;
+  for (uint32_t i = 0; i < halves; ++i) {
+    uint32_t a_sizes[2];
+    if (!quorum_sizes(p_state->p_config, p_state->m.a_weights[i],
+                      &a_sizes[0], &a_sizes[1]) ||
+        p_tally->a_votes[i] < a_sizes[election]) {
+      return RAFT_FALSE;
+    }
+  }
+  return RAFT_TRUE;
+}
+
+static raft_bool_t grow(void** pp_array,
+                        size_t element_size,
+                        uint32_t old_count,
+                        uint32_t new_count) {
+  uint8_t* p_array = realloc(*pp_array, new_count * element_size);
+  if (p_array == NULL) {
+    return RAFT_FALSE;
+  }
+  memset(p_array + old_count * element_size, 0,
+         (new_count - old_count) * element_size);
+  *pp_array = p_array;
+  return RAFT_TRUE;
+}
+
+/**
+ * Grows every array indexed by node id in place. A failure part way leaves
+ * the arrays grown so far larger than needed, which is harmless.
+ */
+static raft_status_t reserve(raft_state_t* p_state, uint32_t capacity) {
+  uint32_t const old = p_state->m.capacity;
+  if (capacity <= old) {
+    return RAFT_STATUS_OK;
+  }
+
+  if (!GROW(p_state->m.p_roles, old, capacity) ||
+      !GROW(p_state->m.p_weights, old, capacity) ||
+      !GROW(p_state->m.p_peers, old, capacity) ||
+      !GROW(p_state->l.p_ballot, old, capacity) ||
+      !GROW(p_state->l.p_next_index, old, capacity) ||
+      !GROW(p_state->l.p_match_index, old, capacity) ||
+      !GROW(p_state->l.p_last_ack_ms, old, capacity) ||
+      !GROW(p_state->l.p_ping_due_ms, old, capacity) ||
+      !GROW(p_state->l.p_relay_ids, old, capacity) ||
+      !GROW(p_state->l.p_rtt_seq, old, capacity) ||
+      !GROW(p_state->l.p_rtt_sent_ms, old, capacity) ||
+      !GROW(p_state->l.p_rtt_pending, old, capacity) ||
+      !GROW(p_state->l.p_rtt_ms, old * RAFT_RTT_SAMPLE_COUNT,
+            capacity * RAFT_RTT_SAMPLE_COUNT) ||
+      !GROW(p_state->l.p_rtt_count, old, capacity) ||
+      !GROW(p_state->l.p_hint_ms, old, capacity) ||
+      !GROW(p_state->b.p_replicate, old, capacity) ||
+      !GROW(p_state->b.p_respond, old, capacity) ||
+      !GROW(p_state->b.p_responses, old, capacity) ||
+      !GROW(p_state->rd.p_acked_seq, old, capacity) ||
+      !GROW(p_state->ls.p_expiry_ms, old, capacity)) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+
+  p_state->m.capacity = capacity;
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * Configuration entries are system entries with data: a big-endian member
+ * count followed by an (id, roles) pair per member. Empty system entries
+ * are no-ops.
+ */
+static raft_bool_t is_config_entry(raft_log_entry_t const* p_entry) {
+  return (p_entry->type == RAFT_LOG_ENTRY_TYPE_SYSTEM &&
+          p_entry->data_size > 0);
+}
+
+static void put_u32(uint8_t* p_buf, uint32_t value) {
+  for (uint32_t i = 0; i < 4; ++i) {
+    p_buf[i] = RAFT_LSBYTE(value, 3 - i);
+  }
+}
+
+static uint32_t get_u32(uint8_t const* p_buf) {
+  return ((uint32_t)p_buf[0] << 24 | (uint32_t)p_buf[1] << 16 |
+          (uint32_t)p_buf[2] << 8 | (uint32_t)p_buf[3]);
+}
+
+static raft_status_t apply_entry(raft_state_t* p_state,
+                                 raft_log_entry_t const* p_entry) {
+  uint8_t const* p_data = p_entry->p_data;
+  if (p_entry->data_size < 4) {
+    return RAFT_STATUS_INVALID_MESSAGE;
+  }
+  uint32_t const num_members = get_u32(p_data);
+  if (p_entry->data_size != 4 + 8 * (uint64_t)num_members) {
+    return RAFT_STATUS_INVALID_MESSAGE;
+  }
+
+  raft_member_t* p_members = calloc(num_members, sizeof(*p_members));
+  if (p_members == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  for (uint32_t i = 0; i < num_members; ++i) {
+    p_members[i].id = get_u32(p_data + 4 + 8 * i);
+    p_members[i].roles = get_u32(p_data + 8 + 8 * i);
+  }
+
+  raft_status_t const status = raft_membership_apply(p_state,
+                                                     p_members,
+                                                     num_members);
+  free(p_members);
+  return status;
+}
+
+static raft_status_t append_config(raft_state_t* p_state,
+                                   raft_member_t const* p_members,
+                                   uint32_t num_members) {
+  uint32_t const data_size = 4 + 8 * num_members;
+  uint8_t* p_data = malloc(data_size);
+  if (p_data == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  put_u32(p_data, num_members);
+  for (uint32_t i = 0; i < num_members; ++i) {
+    put_u32(p_data + 4 + 8 * i, p_members[i].id);
+    put_u32(p_data + 8 + 8 * i, p_members[i].roles);
+  }
+
+  raft_log_t* p_log = p_state->p.p_log;
+  raft_log_entry_t const entry = {
+    .term = p_state->p.current_term,
+    .type = RAFT_LOG_ENTRY_TYPE_SYSTEM,
+    .p_data = p_data,
+    .data_size = data_size,
+  };
+  raft_status_t status = raft_log_append(p_log, &entry, 1);
+  free(p_data);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  RAFT_LOG(p_state, "Appended %s configuration at %u.",
+           p_state->m.joint ? "final" : "joint",
+           raft_log_length(p_log) - 1);
+  return raft_membership_appended(p_state, raft_log_length(p_log) - 1);
+}
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "raft_proposal.h"
+#include "raft_state.h"
+#include "raft_util.h"
+
+#define SLOT(_p_state, _i)                                              \
+  (&(_p_state)->q.p_slots[((_p_state)->q.head + (_i)) &                 \
+                          ((_p_state)->q.capacity - 1)])
+
+static raft_status_t reserve(raft_state_t* p_state, uint32_t count) {
+  if (count <= p_state->q.capacity) {
+    return RAFT_STATUS_OK;
+  }
+
+  /* Capacity stays a power of two so slots can be found with a mask. */
+  uint32_t capacity = MAX(16, p_state->q.capacity);
+  while (capacity < count) {
+    capacity *= 2;
+  }
+
+  raft_proposal_t* p_slots = malloc(capacity * sizeof(*p_slots));
+  if (p_slots == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  for (uint32_t i = 0; i < p_state->q.count; ++i) {
+    p_slots[i] = *SLOT(p_state, i);
+  }
+
+  free(p_state->q.p_slots);
+  p_state->q.p_slots = p_slots;
+  p_state->q.capacity = capacity;
+  p_state->q.head = 0;
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_proposals_push(raft_state_t* p_state,
+                                  raft_index_t index,
+                                  raft_proposal_t const* p_proposal) {
+  if (p_state->q.count == 0) {
+    if (p_proposal->pf_completion == NULL) {
+      return RAFT_STATUS_OK;
+    }
+    p_state->q.first_index = index;
+  }
+
+  RAFT_ASSERT(index >= p_state->q.first_index + p_state->q.count);
+  uint32_t const count = index - p_state->q.first_index + 1;
+  raft_status_t status = reserve(p_state, count);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  /* Entries appended without a completion leave empty slots. */
+  while (p_state->q.count < count - 1) {
+    memset(SLOT(p_state, p_state->q.count++), 0, sizeof(raft_proposal_t));
+  }
+  *SLOT(p_state, p_state->q.count++) = *p_proposal;
+
+  return RAFT_STATUS_OK;
+}
+
+void raft_proposals_cancel(raft_state_t* p_state, raft_index_t index) {
+  if (p_state->q.count > 0 &&
+      p_state->q.first_index + p_state->q.count - 1 == index) {
+    --p_state->q.count;
+  }
+}
+
+void raft_proposals_committed(raft_state_t* p_state) {
+  raft_index_t const first_index = p_state->q.first_index;
+  raft_index_t const end_index = MIN(p_state->v.commit_index + 1,
+                                     first_index + p_state->q.count);
+
+  for (raft_index_t index = MAX(p_state->q.committed_index + 1, first_index);
+       index < end_index;
+       ++index) {
+    raft_proposal_t const* p_slot = SLOT(p_state, index - first_index);
+    if (p_slot->pf_completion) {
+      p_slot->pf_completion(p_slot->p_context, index, p_slot->unique_id,
+                            RAFT_PROPOSAL_COMMITTED);
+    }
+  }
+  p_state->q.committed_index = MAX(p_state->q.committed_index,
+                                   p_state->v.commit_index);
+}
+
+void raft_proposals_applied(raft_state_t* p_state) {
+  while (p_state->q.count > 0 &&
+         p_state->q.first_index <= p_state->v.last_applied) {
+    raft_proposal_t const* p_slot = SLOT(p_state, 0);
+    if (p_slot->pf_completion) {
+      p_slot->pf_completion(p_slot->p_context, p_state->q.first_index,
+                            p_slot->unique_id, RAFT_PROPOSAL_APPLIED);
+    }
+    p_state->q.head = (p_state->q.head + 1) & (p_state->q.capacity - 1);
+    ++p_state->q.first_index;
+    --p_state->q.count;
+  }
+}
+
+void raft_proposals_fail(raft_state_t* p_state) {
+  /* Committed proposals still complete once they are applied. */
+  uint32_t keep = 0;
+  if (p_state->v.commit_index >= p_state->q.first_index) {
+    keep = MIN(p_state->q.count,
+               p_state->v.commit_index - p_state->q.first_index + 1);
+  }
+
+  for (uint32_t i = keep; i < p_state->q.count; ++i) {
+    raft_proposal_t const* p_slot = SLOT(p_state, i);
+    if (p_slot->pf_completion) {
+      p_slot->pf_completion(p_slot->p_context, p_state->q.first_index + i,
+                            p_slot->unique_id, RAFT_PROPOSAL_FAILED);
+    }
+  }
+  p_state->q.count = keep;
+}
+
+void raft_proposals_free(raft_state_t* p_state) {
+  free(p_state->q.p_slots);
+  memset(&p_state->q, 0, sizeof(p_state->q));
+}
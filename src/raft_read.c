@@ -0,0 +1,313 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "raft_read.h"
+#include "raft_config.h"
+#include "raft_log.h"
+#include "raft_membership.h"
+#include "raft_replication.h"
+#include "raft_state.h"
+#include "raft_util.h"
+#include "raft_wire.h"
+
+static raft_index_t leader_read_index(raft_state_t const* p_state);
+static raft_status_t start_round(raft_state_t* p_state);
+static raft_bool_t round_confirmed(raft_state_t const* p_state, uint32_t seq);
+static void confirm_round(raft_state_t* p_state,
+                          uint32_t seq,
+                          raft_index_t read_index);
+static void complete(raft_state_t* p_state,
+                     raft_read_t const* p_read,
+                     raft_status_t status);
+
+static raft_status_t send_read_index(raft_state_t* p_state,
+                                     raft_nodeid_t recipient_id,
+                                     raft_read_index_args_t* p_args);
+static raft_status_t send_read_index_response(
+    raft_state_t* p_state,
+    raft_nodeid_t recipient_id,
+    raft_read_index_response_args_t* p_args);
+
+raft_status_t raft_reads_push(raft_state_t* p_state,
+                              raft_read_t const* p_template) {
+  /* Followers learn the read index from the leader. */
+  raft_index_t const read_index =
+      p_state->type == RAFT_NODE_TYPE_LEADER ? leader_read_index(p_state) : 0;
+
+  if (p_state->rd.count == p_state->rd.capacity) {
+    if (p_state->rd.head > 0) {
+      memmove(p_state->rd.p_reads,
+              p_state->rd.p_reads + p_state->rd.head,
+              (p_state->rd.count - p_state->rd.head) * sizeof(raft_read_t));
+      p_state->rd.count -= p_state->rd.head;
+      p_state->rd.head = 0;
+    } else {
+      uint32_t const capacity = MAX(16, 2 * p_state->rd.capacity);
+      raft_read_t* p_reads = realloc(p_state->rd.p_reads,
+                                     capacity * sizeof(*p_reads));
+      if (p_reads == NULL) {
+        return RAFT_STATUS_OUT_OF_MEMORY;
+      }
+      p_state->rd.p_reads = p_reads;
+      p_state->rd.capacity = capacity;
+    }
+  }
+
+  raft_read_t* p_read = &p_state->rd.p_reads[p_state->rd.count++];
+  *p_read = *p_template;
+  p_read->read_index = read_index;
+  p_read->seq = p_state->rd.seq + 1;
+
+  return raft_reads_start(p_state);
+}
+
+raft_status_t raft_reads_start(raft_state_t* p_state) {
+  if (p_state->b.active) {
+    return RAFT_STATUS_OK;
+  }
+
+  /* Heartbeat rounds confirm themselves in a single node cluster. */
+  if (p_state->type == RAFT_NODE_TYPE_LEADER &&
+      p_state->rd.confirmed_seq != p_state->rd.seq &&
+      round_confirmed(p_state, p_state->rd.seq)) {
+    confirm_round(p_state, p_state->rd.seq, 0);
+  }
+
+  if (p_state->rd.confirmed_seq != p_state->rd.seq ||
+      p_state->rd.head == p_state->rd.count ||
+      p_state->rd.p_reads[p_state->rd.count - 1].seq <= p_state->rd.seq) {
+    return RAFT_STATUS_OK;
+  }
+
+  return start_round(p_state);
+}
+
+raft_status_t raft_reads_retry(raft_state_t* p_state) {
+  if (p_state->type != RAFT_NODE_TYPE_FOLLOWER ||
+      p_state->v.leader_id == 0 ||
+      p_state->rd.confirmed_seq == p_state->rd.seq) {
+    return RAFT_STATUS_OK;
+  }
+
+  raft_read_index_args_t args = {
+    .term = p_state->p.current_term,
+    .follower_id = p_state->p.self,
+    .request_id = p_state->rd.seq,
+  };
+  return send_read_index(p_state, p_state->v.leader_id, &args);
+}
+
+void raft_reads_ack(raft_state_t* p_state,
+                    raft_nodeid_t follower_id,
+                    uint32_t seq) {
+  uint32_t* p_acked_seq = &p_state->rd.p_acked_seq[follower_id - 1];
+  *p_acked_seq = MAX(*p_acked_seq, seq);
+
+  if (p_state->rd.confirmed_seq == p_state->rd.seq ||
+      !round_confirmed(p_state, p_state->rd.seq)) {
+    return;
+  }
+
+  confirm_round(p_state, p_state->rd.seq, 0);
+
+  /* Reads that arrived during the round share the next one. */
+  raft_reads_start(p_state);
+}
+
+void raft_reads_release(raft_state_t* p_state) {
+  while (p_state->rd.head < p_state->rd.count) {
+    raft_read_t const* p_read = &p_state->rd.p_reads[p_state->rd.head];
+    if (p_read->seq > p_state->rd.confirmed_seq ||
+        p_read->read_index > p_state->v.last_applied) {
+      break;
+    }
+
+    ++p_state->rd.head;
+    complete(p_state, p_read, RAFT_STATUS_OK);
+  }
+
+  if (p_state->rd.head == p_state->rd.count) {
+    p_state->rd.head = p_state->rd.count = 0;
+  }
+}
+
+void raft_reads_fail(raft_state_t* p_state) {
+  while (p_state->rd.head < p_state->rd.count) {
+    raft_read_t const* p_read = &p_state->rd.p_reads[p_state->rd.head++];
+    complete(p_state, p_read, RAFT_STATUS_NOT_LEADER);
+  }
+  p_state->rd.head = p_state->rd.count = 0;
+  p_state->rd.confirmed_seq = p_state->rd.seq;
+}
+
+void raft_reads_free(raft_state_t* p_state) {
+  free(p_state->rd.p_reads);
+  free(p_state->rd.p_acked_seq);
+  memset(&p_state->rd, 0, sizeof(p_state->rd));
+}
+
+raft_status_t raft_recv_read_index(raft_state_t* p_state,
+                                   raft_read_index_args_t* p_args) {
+  if (p_args->term != p_state->p.current_term ||
+      p_state->type != RAFT_NODE_TYPE_LEADER) {
+    raft_read_index_response_args_t response = {
+      .term = p_state->p.current_term,
+      .request_id = p_args->request_id,
+      .success = RAFT_FALSE,
+    };
+    return send_read_index_response(p_state, p_args->follower_id, &response);
+  }
+
+  if (p_args->follower_id == 0 ||
+      p_args->follower_id > p_state->m.capacity) {
+    RAFT_LOG(p_state, "Received read index request from unknown node.");
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  raft_read_t const read = {
+    .requester_id = p_args->follower_id,
+    .request_id = p_args->request_id,
+  };
+  return raft_reads_push(p_state, &read);
+}
+
+raft_status_t
+raft_recv_read_index_response(raft_state_t* p_state,
+                              raft_read_index_response_args_t* p_args) {
+  /* Only the answer to the outstanding request counts. */
+  if (p_args->term != p_state->p.current_term ||
+      p_state->type != RAFT_NODE_TYPE_FOLLOWER ||
+      p_args->request_id != p_state->rd.seq ||
+      p_state->rd.confirmed_seq == p_state->rd.seq) {
+    return RAFT_STATUS_OK;
+  }
+
+  if (!p_args->success) {
+    raft_reads_fail(p_state);
+    return RAFT_STATUS_OK;
+  }
+
+  confirm_round(p_state, p_args->request_id, p_args->read_index);
+  return raft_reads_start(p_state);
+}
+
+/**
+ * The commit index only covers every earlier leader's entries once the
+ * entry appended on taking office has committed. Until then, read behind it.
+ */
+static raft_index_t leader_read_index(raft_state_t const* p_state) {
+  return MAX(p_state->v.commit_index, p_state->l.noop_index);
+}
+
+static raft_status_t start_round(raft_state_t* p_state) {
+  if (p_state->type != RAFT_NODE_TYPE_LEADER) {
+    ++p_state->rd.seq;
+    return raft_reads_retry(p_state);
+  }
+
+  raft_status_t const status = raft_heartbeat(p_state);
+  if (round_confirmed(p_state, p_state->rd.seq)) {
+    confirm_round(p_state, p_state->rd.seq, 0);
+  }
+  return status;
+}
+
+static raft_bool_t round_confirmed(raft_state_t const* p_state, uint32_t seq) {
+  raft_tally_t acks = { 0 };
+  raft_tally_add(p_state, &acks, p_state->p.self);
+  for (uint32_t i = 0; i < p_state->m.peer_count; ++i) {
+    raft_nodeid_t const id = p_state->m.p_peers[i];
+    if (p_state->rd.p_acked_seq[id - 1] >= seq) {
+      raft_tally_add(p_state, &acks, id);
+    }
+  }
+  return raft_tally_is_quorum(p_state, &acks);
+}
+
+/**
+ * Marks reads waiting on rounds up to seq as confirmed. On a follower,
+ * read_index is what the leader returned for them.
+ */
+static void confirm_round(raft_state_t* p_state,
+                          uint32_t seq,
+                          raft_index_t read_index) {
+  if (p_state->type != RAFT_NODE_TYPE_LEADER) {
+    for (uint32_t i = p_state->rd.head; i < p_state->rd.count; ++i) {
+      raft_read_t* p_read = &p_state->rd.p_reads[i];
+      if (p_read->seq > seq) {
+        break;
+      }
+      p_read->read_index = read_index;
+    }
+  }
+
+  p_state->rd.confirmed_seq = seq;
+  raft_reads_release(p_state);
+}
+
+static void complete(raft_state_t* p_state,
+                     raft_read_t const* p_read,
+                     raft_status_t status) {
+  if (p_read->requester_id == 0) {
+    p_read->pf_read(p_read->p_context, p_read->read_index, status);
+    return;
+  }
+
+  raft_read_index_response_args_t response = {
+    .term = p_state->p.current_term,
+    .request_id = p_read->request_id,
+    .success = RAFT_SUCCESS(status),
+    .read_index = p_read->read_index,
+  };
+  send_read_index_response(p_state, p_read->requester_id, &response);
+}
+
+static raft_status_t send_read_index(raft_state_t* p_state,
+                                     raft_nodeid_t recipient_id,
+                                     raft_read_index_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_read_index_rpc) {
+    status = p_config->cb.pf_read_index_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_read_index_envelope(&envelope, recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
+
+static raft_status_t send_read_index_response(
+    raft_state_t* p_state,
+    raft_nodeid_t recipient_id,
+    raft_read_index_response_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_read_index_response_rpc) {
+    status = p_config->cb.pf_read_index_response_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_read_index_response_envelope(&envelope,
+                                                     recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
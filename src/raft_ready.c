@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "raft_ready.h"
+#include "raft_config.h"
+#include "raft_log.h"
+#include "raft_proposal.h"
+#include "raft_read.h"
+#include "raft_recovery.h"
+#include "raft_state.h"
+#include "raft_util.h"
+
+raft_bool_t raft_has_ready(raft_state_t const* p_state) {
+  return (p_state->r.message_count > 0 ||
+          p_state->r.unstable_index < raft_log_length(p_state->p.p_log) ||
+          p_state->r.persisted_term != p_state->p.current_term ||
+          p_state->r.persisted_voted_for != p_state->p.voted_for ||
+          (p_state->v.last_applied < p_state->v.commit_index &&
+           p_state->v.last_applied + 1 != p_state->rc.index));
+}
+
+raft_status_t raft_ready(raft_state_t* p_state, raft_ready_t* p_ready) {
+  if (!p_state->p_config->use_ready) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  memset(p_ready, 0, sizeof(*p_ready));
+
+  /* Entries held only as fragments are rebuilt before they are applied,
+   * and the requests for them go out with the next batch. */
+  raft_log_t const* p_log = p_state->p.p_log;
+  raft_index_t apply_end = p_state->v.last_applied + 1;
+  for (; apply_end <= p_state->v.commit_index; ++apply_end) {
+    if (raft_recovery_needed(raft_log_entry(p_log, apply_end))) {
+      raft_status_t const status = raft_recovery_start(p_state, apply_end);
+      if (RAFT_FAILURE(status)) {
+        return status;
+      }
+      break;
+    }
+  }
+
+  p_ready->p_messages = p_state->r.p_messages;
+  p_ready->num_messages = p_state->r.message_count;
+  p_state->r.p_messages = NULL;
+  p_state->r.message_count = p_state->r.message_capacity = 0;
+
+  p_ready->current_term = p_state->p.current_term;
+  p_ready->voted_for = p_state->p.voted_for;
+  p_ready->hard_state_changed =
+      (p_state->r.persisted_term != p_state->p.current_term ||
+       p_state->r.persisted_voted_for != p_state->p.voted_for);
+
+  raft_index_t const log_length = raft_log_length(p_log);
+  p_ready->first_persist_index = p_state->r.unstable_index;
+  if (p_state->r.unstable_index < log_length) {
+    p_ready->num_persist_entries = log_length - p_state->r.unstable_index;
+  }
+
+  p_ready->first_apply_index = p_state->v.last_applied + 1;
+  p_ready->num_apply_entries = apply_end - p_ready->first_apply_index;
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_advance(raft_state_t* p_state, raft_ready_t* p_ready) {
+  for (uint32_t i = 0; i < p_ready->num_messages; ++i) {
+    raft_dealloc_envelope(&p_ready->p_messages[i]);
+  }
+  free(p_ready->p_messages);
+
+  p_state->r.persisted_term = p_ready->current_term;
+  p_state->r.persisted_voted_for = p_ready->voted_for;
+  p_state->r.unstable_index = MAX(p_state->r.unstable_index,
+                                  p_ready->first_persist_index +
+                                  p_ready->num_persist_entries);
+  p_state->v.last_applied = MAX(p_state->v.last_applied,
+                                p_ready->first_apply_index +
+                                p_ready->num_apply_entries - 1);
+  raft_proposals_applied(p_state);
+  raft_reads_release(p_state);
+
+  memset(p_ready, 0, sizeof(*p_ready));
+  return RAFT_STATUS_OK;
+}
@@ -0,0 +1,428 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "raft_recovery.h"
+#include "raft_config.h"
+#include "raft_erasure.h"
+#include "raft_log.h"
+#include "raft_membership.h"
+#include "raft_proposal.h"
+#include "raft_read.h"
+#include "raft_replication.h"
+#include "raft_state.h"
+#include "raft_util.h"
+#include "raft_wire.h"
+
+static raft_status_t ask_peers(raft_state_t* p_state);
+static raft_status_t decode(raft_state_t* p_state);
+static raft_status_t rebuilt(raft_state_t* p_state, void const* p_data);
+static raft_status_t start_next(raft_state_t* p_state, raft_index_t index);
+static raft_status_t drop_if_lost(raft_state_t* p_state);
+static void forget(raft_state_t* p_state);
+
+static raft_status_t send_fragment(raft_state_t* p_state,
+                                   raft_nodeid_t recipient_id,
+                                   raft_fragment_args_t* p_args);
+static raft_status_t send_fragment_response(
+    raft_state_t* p_state,
+    raft_nodeid_t recipient_id,
+    raft_fragment_response_args_t* p_args);
+
+raft_bool_t raft_recovery_needed(raft_log_entry_t const* p_entry) {
+  return (p_entry->fragments_needed != 0 &&
+          p_entry->fragment_index != RAFT_FRAGMENT_WHOLE);
+}
+
+raft_status_t raft_recovery_start(raft_state_t* p_state, raft_index_t index) {
+  if (p_state->rc.index == index) {
+    return raft_recovery_retry(p_state);
+  }
+  forget(p_state);
+
+  raft_log_entry_t const* p_entry = raft_log_entry(p_state->p.p_log, index);
+  RAFT_ASSERT(raft_recovery_needed(p_entry));
+
+  uint32_t const fragments_needed = p_entry->fragments_needed;
+  p_state->rc.pp_fragments = calloc(fragments_needed, sizeof(void*));
+  p_state->rc.p_indexes = calloc(fragments_needed, sizeof(uint32_t));
+  p_state->rc.p_answered = calloc(p_state->m.capacity, sizeof(raft_bool_t));
+  void* p_own = malloc(p_entry->data_size);
+  if (p_state->rc.pp_fragments == NULL || p_state->rc.p_indexes == NULL ||
+      p_state->rc.p_answered == NULL || p_own == NULL) {
+    free(p_own);
+    forget(p_state);
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+
+  /* This node's own fragment is the first of those needed. */
+  p_state->rc.pp_fragments[0] = memcpy(p_own, p_entry->p_data,
+                                       p_entry->data_size);
+  p_state->rc.p_indexes[0] = p_entry->fragment_index;
+  p_state->rc.count = 1;
+  p_state->rc.answered_capacity = p_state->m.capacity;
+  p_state->rc.lacking = 0;
+  p_state->rc.index = index;
+  p_state->rc.term = p_entry->term;
+
+  /* A single fragment may be all the entry was split into. */
+  if (fragments_needed == 1) {
+    return decode(p_state);
+  }
+  return ask_peers(p_state);
+}
+
+raft_status_t raft_recovery_promoted(raft_state_t* p_state) {
+  return start_next(p_state, p_state->v.last_applied + 1);
+}
+
+raft_status_t raft_recovery_retry(raft_state_t* p_state) {
+  if (p_state->rc.index == 0 ||
+      (p_state->v.clock_ms - p_state->rc.sent_ms <
+       p_state->p_config->leader_ping_interval_ms)) {
+    return RAFT_STATUS_OK;
+  }
+
+  /* Enough fragments may be in hand already if rebuilding ran out of
+   * memory. */
+  raft_log_entry_t const* p_entry = raft_log_entry(p_state->p.p_log,
+                                                   p_state->rc.index);
+  if (p_state->rc.count >= p_entry->fragments_needed) {
+    p_state->rc.sent_ms = p_state->v.clock_ms;
+    return decode(p_state);
+  }
+  return ask_peers(p_state);
+}
+
+raft_index_t raft_recovery_limit(raft_state_t const* p_state) {
+  if (p_state->rc.index != 0) {
+    return p_state->rc.index;
+  }
+  return raft_log_length(p_state->p.p_log);
+}
+
+void raft_recovery_truncated(raft_state_t* p_state, raft_index_t index) {
+  if (p_state->rc.index >= index) {
+    forget(p_state);
+  }
+}
+
+void raft_recovery_free(raft_state_t* p_state) {
+  forget(p_state);
+}
+
+raft_status_t raft_recv_fragment(raft_state_t* p_state,
+                                 raft_fragment_args_t* p_args) {
+  raft_log_t const* p_log = p_state->p.p_log;
+
+  if (p_args->sender_id == 0 || p_args->sender_id == p_state->p.self) {
+    RAFT_LOG(p_state, "Received fragment request from unknown node.");
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  raft_fragment_response_args_t response = {
+    .sender_id = p_state->p.self,
+    .index = p_args->index,
+    .entry_term = p_args->entry_term,
+    .held = RAFT_FALSE,
+  };
+  /* Witnesses keep no data to answer with. */
+  raft_log_entry_t const* p_entry = NULL;
+  if (p_args->index > 0 &&
+      p_args->index < raft_log_length(p_log) &&
+      !raft_membership_is_witness(p_state, p_state->p.self)) {
+    p_entry = raft_log_entry(p_log, p_args->index);
+    if (p_entry->term != p_args->entry_term ||
+        p_entry->fragments_needed == 0) {
+      p_entry = NULL;
+    }
+  }
+  if (p_entry == NULL) {
+    return send_fragment_response(p_state, p_args->sender_id, &response);
+  }
+
+  response.held = RAFT_TRUE;
+  response.fragment_index = p_entry->fragment_index;
+  response.p_data = p_entry->p_data;
+  response.data_size = p_entry->data_size;
+
+  /* Nodes holding the whole entry answer with the fragment they would have
+   * been sent, sharing the load of the rebuild with the others. */
+  void* p_fragment = NULL;
+  if (p_entry->fragment_index == RAFT_FRAGMENT_WHOLE &&
+      p_state->p.self <= RAFT_ERASURE_MAX_FRAGMENTS) {
+    response.fragment_index = p_state->p.self - 1;
+    response.data_size = raft_erasure_fragment_size(p_entry->coded_size,
+                                                    p_entry->fragments_needed);
+    response.p_data = p_fragment = malloc(response.data_size);
+    if (p_fragment == NULL) {
+      return RAFT_STATUS_OUT_OF_MEMORY;
+    }
+    raft_erasure_encode(p_entry->p_data, p_entry->coded_size,
+                        p_entry->fragments_needed, response.fragment_index,
+                        p_fragment);
+  }
+
+  raft_status_t const status = send_fragment_response(p_state,
+                                                      p_args->sender_id,
+                                                      &response);
+  free(p_fragment);
+  return status;
+}
+
+raft_status_t
+raft_recv_fragment_response(raft_state_t* p_state,
+                            raft_fragment_response_args_t* p_args) {
+  raft_nodeid_t const sender_id = p_args->sender_id;
+  if (p_state->rc.index == 0 ||
+      p_args->index != p_state->rc.index ||
+      p_args->entry_term != p_state->rc.term ||
+      sender_id == 0 || sender_id == p_state->p.self) {
+    return RAFT_STATUS_OK;
+  }
+  if (sender_id <= p_state->rc.answered_capacity) {
+    if (p_state->rc.p_answered[sender_id - 1]) {
+      return RAFT_STATUS_OK;
+    }
+    p_state->rc.p_answered[sender_id - 1] = RAFT_TRUE;
+  }
+
+  if (!p_args->held) {
+    p_state->rc.lacking += raft_membership_holds_fragment(p_state, sender_id);
+    return drop_if_lost(p_state);
+  }
+
+  raft_log_entry_t const* p_entry = raft_log_entry(p_state->p.p_log,
+                                                   p_state->rc.index);
+  uint32_t const fragments_needed = p_entry->fragments_needed;
+  if (p_args->fragment_index == RAFT_FRAGMENT_WHOLE) {
+    if (p_args->data_size != p_entry->coded_size) {
+      return RAFT_STATUS_INVALID_MESSAGE;
+    }
+    return rebuilt(p_state, p_args->p_data);
+  }
+
+  if (p_args->fragment_index >= RAFT_ERASURE_MAX_FRAGMENTS ||
+      p_args->data_size != raft_erasure_fragment_size(p_entry->coded_size,
+                                                      fragments_needed)) {
+    return RAFT_STATUS_INVALID_MESSAGE;
+  }
+  /* Rebuilding from those in hand failed, and is left to
+   * raft_recovery_retry(). */
+  if (p_state->rc.count >= fragments_needed) {
+    return RAFT_STATUS_OK;
+  }
+  for (uint32_t i = 0; i < p_state->rc.count; ++i) {
+    if (p_state->rc.p_indexes[i] == p_args->fragment_index) {
+      return RAFT_STATUS_OK;
+    }
+  }
+
+  void* p_fragment = malloc(p_args->data_size);
+  if (p_fragment == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  memcpy(p_fragment, p_args->p_data, p_args->data_size);
+  p_state->rc.pp_fragments[p_state->rc.count] = p_fragment;
+  p_state->rc.p_indexes[p_state->rc.count++] = p_args->fragment_index;
+  if (p_state->rc.count < fragments_needed) {
+    return RAFT_STATUS_OK;
+  }
+  return decode(p_state);
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ******************************************************************************/
+
+static raft_status_t ask_peers(raft_state_t* p_state) {
+  raft_index_t const index = p_state->rc.index;
+  raft_fragment_args_t args = {
+    .sender_id = p_state->p.self,
+    .index = index,
+    .entry_term = p_state->rc.term,
+  };
+  p_state->rc.sent_ms = p_state->v.clock_ms;
+
+  /* Answers may finish the rebuild before every peer was asked. */
+  raft_status_t status = RAFT_STATUS_OK;
+  for (uint32_t i = 0;
+       i < p_state->m.peer_count && p_state->rc.index == index;
+       ++i) {
+    raft_nodeid_t const id = p_state->m.p_peers[i];
+    if (id <= p_state->rc.answered_capacity && p_state->rc.p_answered[id - 1]) {
+      continue;
+    }
+    raft_status_t const send_status = send_fragment(p_state, id, &args);
+    if (RAFT_FAILURE(send_status)) {
+      status = send_status;
+    }
+  }
+  return status;
+}
+
+static raft_status_t decode(raft_state_t* p_state) {
+  raft_log_entry_t const* p_entry = raft_log_entry(p_state->p.p_log,
+                                                   p_state->rc.index);
+  void* p_data = malloc(p_entry->coded_size);
+  if (p_data == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  raft_status_t status =
+      raft_erasure_decode((void const* const*)p_state->rc.pp_fragments,
+                          p_state->rc.p_indexes,
+                          p_entry->fragments_needed,
+                          p_entry->coded_size,
+                          p_data);
+  if (RAFT_SUCCESS(status)) {
+    status = rebuilt(p_state, p_data);
+  }
+  free(p_data);
+  return status;
+}
+
+/**
+ * Puts the whole entry in place of the fragment, then applies what that
+ * unblocked. A leader moves on to the next entry it holds a fragment of,
+ * and resumes replicating once there are none.
+ */
+static raft_status_t rebuilt(raft_state_t* p_state, void const* p_data) {
+  raft_index_t const index = p_state->rc.index;
+  raft_status_t status = raft_log_restore(p_state->p.p_log, index, p_data);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+  forget(p_state);
+
+  if (p_state->type == RAFT_NODE_TYPE_LEADER &&
+      RAFT_FAILURE(status = start_next(p_state, index + 1))) {
+    return status;
+  }
+  if (RAFT_FAILURE(status = raft_apply_committed(p_state))) {
+    return status;
+  }
+  if (p_state->type == RAFT_NODE_TYPE_LEADER && p_state->rc.index == 0) {
+    return raft_replicate(p_state);
+  }
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * Starts rebuilding the first entry from index on held only as a fragment.
+ */
+static raft_status_t start_next(raft_state_t* p_state, raft_index_t index) {
+  raft_log_t const* p_log = p_state->p.p_log;
+  for (; index < raft_log_length(p_log); ++index) {
+    if (raft_recovery_needed(raft_log_entry(p_log, index))) {
+      return raft_recovery_start(p_state, index);
+    }
+  }
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * A leader waiting on an entry that too many nodes lack for it to have
+ * committed, as fragments_durable() counts, would wait forever. It drops
+ * the entry and everything after it, which it had not yet replicated.
+ */
+static raft_status_t drop_if_lost(raft_state_t* p_state) {
+  raft_index_t const index = p_state->rc.index;
+  if (p_state->type != RAFT_NODE_TYPE_LEADER ||
+      index <= p_state->v.commit_index) {
+    return RAFT_STATUS_OK;
+  }
+
+  uint32_t total = raft_membership_holds_fragment(p_state, p_state->p.self);
+  for (uint32_t i = 0; i < p_state->m.peer_count; ++i) {
+    total += raft_membership_holds_fragment(p_state, p_state->m.p_peers[i]);
+  }
+  raft_log_t* p_log = p_state->p.p_log;
+  uint32_t const quorum = raft_membership_coded_quorum(
+      p_state, raft_log_entry(p_log, index)->fragments_needed);
+  if (total - p_state->rc.lacking >= (quorum ? quorum : total)) {
+    return RAFT_STATUS_OK;
+  }
+
+  RAFT_LOG(p_state, "Entry %u cannot have committed; dropping it.", index);
+  forget(p_state);
+  raft_log_truncate(p_log, index);
+  p_state->r.unstable_index = MIN(p_state->r.unstable_index, index);
+  for (uint32_t i = 0; i < p_state->m.capacity; ++i) {
+    p_state->l.p_next_index[i] = MIN(p_state->l.p_next_index[i], index);
+    p_state->l.p_match_index[i] = MIN(p_state->l.p_match_index[i], index - 1);
+  }
+  raft_find_coded(p_state);
+  raft_proposals_fail(p_state);
+  raft_reads_fail(p_state);
+
+  raft_status_t status = raft_membership_truncated(p_state, index);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  /* Reads still need an entry of this term to commit. */
+  if (index <= p_state->l.noop_index &&
+      RAFT_FAILURE(status = raft_append_noop(p_state))) {
+    return status;
+  }
+  return raft_replicate(p_state);
+}
+
+static void forget(raft_state_t* p_state) {
+  for (uint32_t i = 0; i < p_state->rc.count; ++i) {
+    free(p_state->rc.pp_fragments[i]);
+  }
+  free(p_state->rc.pp_fragments);
+  free(p_state->rc.p_indexes);
+  free(p_state->rc.p_answered);
+  memset(&p_state->rc, 0, sizeof(p_state->rc));
+}
+
+static raft_status_t send_fragment(raft_state_t* p_state,
+                                   raft_nodeid_t recipient_id,
+                                   raft_fragment_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_fragment_rpc) {
+    status = p_config->cb.pf_fragment_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_fragment_envelope(&envelope, recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
+
+static raft_status_t send_fragment_response(
+    raft_state_t* p_state,
+    raft_nodeid_t recipient_id,
+    raft_fragment_response_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_fragment_response_rpc) {
+    status = p_config->cb.pf_fragment_response_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_fragment_response_envelope(&envelope,
+                                                   recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
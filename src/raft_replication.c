@@ -0,0 +1,528 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "raft_replication.h"
+#include "raft_config.h"
+#include "raft_election.h"
+#include "raft_erasure.h"
+#include "raft_lease.h"
+#include "raft_log.h"
+#include "raft_membership.h"
+#include "raft_proposal.h"
+#include "raft_read.h"
+#include "raft_recovery.h"
+#include "raft_state.h"
+#include "raft_util.h"
+#include "raft_wire.h"
+
+static raft_status_t send_append_entries(raft_state_t* p_state,
+                                         raft_nodeid_t recipient_id,
+                                         raft_append_entries_args_t* p_args);
+static raft_status_t send_heartbeat(raft_state_t* p_state,
+                                    raft_nodeid_t recipient_id,
+                                    raft_heartbeat_args_t* p_args);
+static raft_status_t code_entries(raft_append_entries_args_t* p_args,
+                                  uint32_t fragment_index);
+static void free_coded_entries(raft_append_entries_args_t* p_args,
+                               raft_log_entry_t const* p_entries);
+static raft_bool_t has_whole_coded_entries(
+    raft_append_entries_args_t const* p_args);
+static raft_bool_t fragments_durable(raft_state_t const* p_state,
+                                     raft_index_t index,
+                                     uint32_t fragments_needed);
+static raft_status_t replicate_through_relays(raft_state_t* p_state);
+static raft_status_t fan_out(raft_state_t* p_state,
+                             raft_append_entries_args_t* p_args,
+                             raft_nodeid_t* p_ids,
+                             uint32_t count);
+
+raft_status_t raft_replicate_to(raft_state_t* p_state,
+                                raft_nodeid_t follower_id) {
+  RAFT_ASSERT(p_state->type == RAFT_NODE_TYPE_LEADER);
+
+  if (p_state->b.active) {
+    p_state->b.p_replicate[follower_id - 1] = RAFT_TRUE;
+    return RAFT_STATUS_OK;
+  }
+
+  raft_log_t const* p_log = p_state->p.p_log;
+  raft_index_t* p_next_index = &p_state->l.p_next_index[follower_id - 1];
+  raft_index_t const log_length = raft_log_length(p_log);
+
+  p_state->l.p_ping_due_ms[follower_id - 1] =
+      p_state->v.clock_ms + p_state->p_config->leader_ping_interval_ms;
+  raft_election_rtt_sent(p_state, follower_id);
+
+  /* A follower known to hold the whole log only needs the commit index. */
+  if (*p_next_index == log_length &&
+      p_state->l.p_match_index[follower_id - 1] == log_length - 1) {
+    raft_heartbeat_args_t heartbeat = {
+      .term = p_state->p.current_term,
+      .leader_id = p_state->p.self,
+      .leader_commit = p_state->v.commit_index,
+      .seq = p_state->rd.seq,
+      .election_timeout_hint_ms = p_state->l.p_hint_ms[follower_id - 1],
+    };
+    return send_heartbeat(p_state, follower_id, &heartbeat);
+  }
+
+  raft_log_entry_t const* p_entries = NULL;
+  raft_append_entries_args_t args = {
+    .term = p_state->p.current_term,
+    .leader_id = p_state->p.self,
+    .prev_log_index = *p_next_index - 1,
+    .prev_log_term = raft_log_entry(p_log, *p_next_index - 1)->term,
+    .num_entries = raft_log_entries(p_log, *p_next_index, &p_entries),
+    .leader_commit = p_state->v.commit_index,
+    .seq = p_state->rd.seq,
+    .election_timeout_hint_ms = p_state->l.p_hint_ms[follower_id - 1],
+    .metadata_only = raft_membership_is_witness(p_state, follower_id),
+  };
+  args.p_log_entries = (raft_log_entry_t*)p_entries;
+
+  /* Nothing is sent from an entry still being rebuilt on. */
+  raft_index_t const limit = raft_recovery_limit(p_state);
+  if (*p_next_index + args.num_entries > limit) {
+    args.num_entries = limit > *p_next_index ? limit - *p_next_index : 0;
+  }
+
+  /* Followers are sent only their own fragment of coded entries. */
+  if (!args.metadata_only && follower_id <= RAFT_ERASURE_MAX_FRAGMENTS) {
+    raft_status_t const status = code_entries(&args, follower_id - 1);
+    if (RAFT_FAILURE(status)) {
+      return status;
+    }
+  }
+
+  *p_next_index += args.num_entries;
+
+  raft_status_t const status = send_append_entries(p_state, follower_id, &args);
+  free_coded_entries(&args, p_entries);
+  return status;
+}
+
+raft_status_t raft_replicate(raft_state_t* p_state) {
+  if (p_state->p_config->relay_fanout != 0 && !p_state->b.active &&
+      raft_recovery_limit(p_state) == raft_log_length(p_state->p.p_log)) {
+    return replicate_through_relays(p_state);
+  }
+
+  raft_status_t status = RAFT_STATUS_OK;
+  /* A response may commit a configuration that steps this node down. */
+  for (uint32_t i = 0;
+       i < p_state->m.peer_count && p_state->type == RAFT_NODE_TYPE_LEADER;
+       ++i) {
+    raft_status_t const send_status =
+        raft_replicate_to(p_state, p_state->m.p_peers[i]);
+    if (RAFT_FAILURE(send_status)) {
+      status = send_status;
+    }
+  }
+  return status;
+}
+
+raft_status_t raft_relay(raft_state_t* p_state,
+                         raft_append_entries_args_t* p_args) {
+  raft_nodeid_t* p_relay_ids = p_args->p_relay_ids;
+  uint32_t const num_relay_ids = p_args->num_relay_ids;
+  raft_status_t const status = fan_out(p_state, p_args,
+                                       p_relay_ids, num_relay_ids);
+  p_args->p_relay_ids = p_relay_ids;
+  p_args->num_relay_ids = num_relay_ids;
+  return status;
+}
+
+raft_status_t raft_heartbeat(raft_state_t* p_state) {
+  raft_lease_sent(p_state, ++p_state->rd.seq);
+  return raft_replicate(p_state);
+}
+
+raft_status_t raft_heartbeat_idle(raft_state_t* p_state) {
+  raft_lease_sent(p_state, ++p_state->rd.seq);
+
+  raft_status_t status = RAFT_STATUS_OK;
+  for (uint32_t i = 0;
+       i < p_state->m.peer_count && p_state->type == RAFT_NODE_TYPE_LEADER;
+       ++i) {
+    raft_nodeid_t const id = p_state->m.p_peers[i];
+    if (p_state->v.clock_ms < p_state->l.p_ping_due_ms[id - 1]) {
+      continue;
+    }
+    raft_status_t const send_status = raft_replicate_to(p_state, id);
+    if (RAFT_FAILURE(send_status)) {
+      status = send_status;
+    }
+  }
+  return status;
+}
+
+void raft_advance_commit_index(raft_state_t* p_state) {
+  raft_log_t const* p_log = p_state->p.p_log;
+
+  if (p_state->b.active) {
+    p_state->b.commit_dirty = RAFT_TRUE;
+    return;
+  }
+
+  /* Coded entries need enough fragments held on top of a quorum. */
+  raft_index_t first_coded = raft_log_length(p_log);
+  uint32_t fragments_needed = 0;
+  if (p_state->l.first_coded_index != 0) {
+    first_coded = p_state->l.first_coded_index;
+    for (raft_index_t index = first_coded;
+         index < raft_log_length(p_log);
+         ++index) {
+      fragments_needed = MAX(fragments_needed,
+                             raft_log_entry(p_log, index)->fragments_needed);
+    }
+  }
+
+  for (raft_index_t index = raft_log_length(p_log) - 1;
+       index > p_state->v.commit_index;
+       --index) {
+    /* Only entries from the current term are committed by counting. */
+    if (raft_log_entry(p_log, index)->term != p_state->p.current_term) {
+      break;
+    }
+
+    raft_tally_t replicas = { 0 };
+    raft_tally_add(p_state, &replicas, p_state->p.self);
+    for (uint32_t i = 0; i < p_state->m.peer_count; ++i) {
+      raft_nodeid_t const id = p_state->m.p_peers[i];
+      if (p_state->l.p_match_index[id - 1] >= index) {
+        raft_tally_add(p_state, &replicas, id);
+      }
+    }
+
+    if (raft_tally_is_quorum(p_state, &replicas) &&
+        (index < first_coded ||
+         fragments_durable(p_state, index, fragments_needed))) {
+      p_state->v.commit_index = index;
+      break;
+    }
+  }
+  if (p_state->l.first_coded_index != 0 &&
+      p_state->l.first_coded_index <= p_state->v.commit_index) {
+    raft_find_coded(p_state);
+  }
+
+  raft_proposals_committed(p_state);
+  raft_membership_committed(p_state);
+}
+
+raft_status_t raft_append_noop(raft_state_t* p_state) {
+  raft_log_t* p_log = p_state->p.p_log;
+  raft_log_entry_t const noop = {
+    .term = p_state->p.current_term,
+    .type = RAFT_LOG_ENTRY_TYPE_SYSTEM,
+  };
+  raft_status_t const status = raft_log_append(p_log, &noop, 1);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+  p_state->l.noop_index = raft_log_length(p_log) - 1;
+
+  /* A single node cluster commits it as soon as it is appended. */
+  raft_advance_commit_index(p_state);
+  return raft_apply_committed(p_state);
+}
+
+void raft_find_coded(raft_state_t* p_state) {
+  raft_log_t const* p_log = p_state->p.p_log;
+  p_state->l.first_coded_index = 0;
+  for (raft_index_t index = p_state->v.commit_index + 1;
+       index < raft_log_length(p_log);
+       ++index) {
+    if (raft_log_entry(p_log, index)->fragments_needed) {
+      p_state->l.first_coded_index = index;
+      break;
+    }
+  }
+}
+
+raft_status_t raft_apply_committed(raft_state_t* p_state) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  /* Witnesses have nothing to apply. */
+  if (raft_membership_is_witness(p_state, p_state->p.self)) {
+    p_state->v.last_applied = p_state->v.commit_index;
+  }
+
+  if (p_config->use_ready || p_state->b.active) {
+    return RAFT_STATUS_OK;
+  }
+
+  raft_status_t status = RAFT_STATUS_OK;
+  while (p_state->v.last_applied < p_state->v.commit_index) {
+    raft_index_t const index = p_state->v.last_applied + 1;
+    raft_log_entry_t const* p_entry = raft_log_entry(p_state->p.p_log, index);
+
+    /* A fragment is no command; the whole entry is rebuilt first. */
+    if (raft_recovery_needed(p_entry)) {
+      status = raft_recovery_start(p_state, index);
+      break;
+    }
+    if (p_config->cb.pf_apply_log_entry) {
+      status = p_config->cb.pf_apply_log_entry(index, p_entry);
+      if (RAFT_FAILURE(status)) {
+        /* Left unapplied, to be retried on the next call. */
+        break;
+      }
+    }
+    p_state->v.last_applied = index;
+  }
+
+  raft_proposals_applied(p_state);
+  raft_reads_release(p_state);
+  return status;
+}
+
+/**
+ * Points p_args at copies of its entries in which those the leader holds
+ * whole for coding carry only fragment fragment_index instead. Released
+ * with free_coded_entries().
+ */
+static raft_status_t code_entries(raft_append_entries_args_t* p_args,
+                                  uint32_t fragment_index) {
+  if (!has_whole_coded_entries(p_args)) {
+    return RAFT_STATUS_OK;
+  }
+
+  uint32_t const num_entries = p_args->num_entries;
+  raft_log_entry_t* p_coded = malloc(num_entries * sizeof(*p_coded));
+  if (p_coded == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  memcpy(p_coded, p_args->p_log_entries, num_entries * sizeof(*p_coded));
+
+  raft_log_entry_t const* p_entries = p_args->p_log_entries;
+  p_args->p_log_entries = p_coded;
+  for (uint32_t ii = 0; ii < num_entries; ++ii) {
+    raft_log_entry_t* p_entry = &p_coded[ii];
+    if (p_entry->fragment_index != RAFT_FRAGMENT_WHOLE) {
+      continue;
+    }
+
+    uint32_t const size = raft_erasure_fragment_size(p_entry->coded_size,
+                                                     p_entry->fragments_needed);
+    void* p_fragment = malloc(size);
+    if (p_fragment == NULL) {
+      free_coded_entries(p_args, p_entries);
+      return RAFT_STATUS_OUT_OF_MEMORY;
+    }
+    raft_erasure_encode(p_entry->p_data, p_entry->coded_size,
+                        p_entry->fragments_needed, fragment_index,
+                        p_fragment);
+    p_entry->p_data = p_fragment;
+    p_entry->data_size = size;
+    p_entry->fragment_index = fragment_index;
+  }
+  return RAFT_STATUS_OK;
+}
+
+static void free_coded_entries(raft_append_entries_args_t* p_args,
+                               raft_log_entry_t const* p_entries) {
+  raft_log_entry_t* p_coded = p_args->p_log_entries;
+  if (p_coded == p_entries) {
+    return;
+  }
+  for (uint32_t ii = 0; ii < p_args->num_entries; ++ii) {
+    if (p_coded[ii].p_data != p_entries[ii].p_data) {
+      free(p_coded[ii].p_data);
+    }
+  }
+  free(p_coded);
+  p_args->p_log_entries = (raft_log_entry_t*)p_entries;
+}
+
+static raft_bool_t has_whole_coded_entries(
+    raft_append_entries_args_t const* p_args) {
+  for (uint32_t ii = 0; ii < p_args->num_entries; ++ii) {
+    if (p_args->p_log_entries[ii].fragment_index == RAFT_FRAGMENT_WHOLE) {
+      return RAFT_TRUE;
+    }
+  }
+  return RAFT_FALSE;
+}
+
+/**
+ * Whether enough nodes hold the entries up to index to commit the coded
+ * ones among them. Configurations that cannot count fragments wait for
+ * every node that holds them.
+ */
+static raft_bool_t fragments_durable(raft_state_t const* p_state,
+                                     raft_index_t index,
+                                     uint32_t fragments_needed) {
+  uint32_t holders = raft_membership_holds_fragment(p_state, p_state->p.self);
+  uint32_t total = holders;
+  for (uint32_t i = 0; i < p_state->m.peer_count; ++i) {
+    raft_nodeid_t const id = p_state->m.p_peers[i];
+    if (raft_membership_holds_fragment(p_state, id)) {
+      ++total;
+      holders += p_state->l.p_match_index[id - 1] >= index;
+    }
+  }
+
+  uint32_t const quorum = raft_membership_coded_quorum(p_state,
+                                                       fragments_needed);
+  return holders >= (quorum ? quorum : total);
+}
+
+static raft_status_t replicate_through_relays(raft_state_t* p_state) {
+  raft_log_t const* p_log = p_state->p.p_log;
+  raft_index_t const log_length = raft_log_length(p_log);
+  raft_nodeid_t* p_relay_ids = p_state->l.p_relay_ids;
+  uint32_t relay_count = 0;
+  raft_index_t next_index = 0;
+
+  raft_status_t status = RAFT_STATUS_OK;
+  for (uint32_t i = 0;
+       i < p_state->m.peer_count && p_state->type == RAFT_NODE_TYPE_LEADER;
+       ++i) {
+    raft_nodeid_t const id = p_state->m.p_peers[i];
+    raft_index_t const next = p_state->l.p_next_index[id - 1];
+    if (next < log_length &&
+        !raft_membership_is_witness(p_state, id) &&
+        (relay_count == 0 || next == next_index)) {
+      next_index = next;
+      p_relay_ids[relay_count++] = id;
+      continue;
+    }
+
+    raft_status_t const send_status = raft_replicate_to(p_state, id);
+    if (RAFT_FAILURE(send_status)) {
+      status = send_status;
+    }
+  }
+  if (relay_count == 0 || p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return status;
+  }
+
+  raft_log_entry_t const* p_entries = NULL;
+  raft_append_entries_args_t args = {
+    .term = p_state->p.current_term,
+    .leader_id = p_state->p.self,
+    .prev_log_index = next_index - 1,
+    .prev_log_term = raft_log_entry(p_log, next_index - 1)->term,
+    .num_entries = raft_log_entries(p_log, next_index, &p_entries),
+    .leader_commit = p_state->v.commit_index,
+    .seq = p_state->rd.seq,
+  };
+  args.p_log_entries = (raft_log_entry_t*)p_entries;
+
+  /* Relays would forward their own fragment; code for each directly. */
+  if (has_whole_coded_entries(&args)) {
+    for (uint32_t i = 0;
+         i < relay_count && p_state->type == RAFT_NODE_TYPE_LEADER;
+         ++i) {
+      raft_status_t const send_status =
+          raft_replicate_to(p_state, p_relay_ids[i]);
+      if (RAFT_FAILURE(send_status)) {
+        status = send_status;
+      }
+    }
+    return status;
+  }
+
+  for (uint32_t i = 0; i < relay_count; ++i) {
+    p_state->l.p_next_index[p_relay_ids[i] - 1] += args.num_entries;
+  }
+
+  raft_status_t const send_status = fan_out(p_state, &args,
+                                            p_relay_ids, relay_count);
+  return RAFT_SUCCESS(status) ? send_status : status;
+}
+
+/**
+ * Splits p_ids into relay_fanout subtrees of near equal size, and sends
+ * p_args to the first node of each with the rest of its subtree to forward
+ * to. Only those first nodes count as pinged.
+ */
+static raft_status_t fan_out(raft_state_t* p_state,
+                             raft_append_entries_args_t* p_args,
+                             raft_nodeid_t* p_ids,
+                             uint32_t count) {
+  raft_config_t const* p_config = p_state->p_config;
+  uint32_t const fanout = MAX(1, p_config->relay_fanout);
+
+  raft_status_t status = RAFT_STATUS_OK;
+  uint32_t start = 0;
+  for (uint32_t i = 0; i < fanout && start < count; ++i) {
+    uint32_t const end = start + (count - start + fanout - i - 1) / (fanout - i);
+    raft_nodeid_t const recipient_id = p_ids[start];
+    p_args->p_relay_ids = p_ids + start + 1;
+    p_args->num_relay_ids = end - start - 1;
+
+    /* The leader times and hints each subtree as a whole; relays pass on
+     * what they were sent. */
+    if (p_state->type == RAFT_NODE_TYPE_LEADER) {
+      p_state->l.p_ping_due_ms[recipient_id - 1] =
+          p_state->v.clock_ms + p_config->leader_ping_interval_ms;
+      p_args->election_timeout_hint_ms = 0;
+      for (uint32_t j = start; j < end; ++j) {
+        raft_election_rtt_sent(p_state, p_ids[j]);
+        p_args->election_timeout_hint_ms =
+            MAX(p_args->election_timeout_hint_ms,
+                p_state->l.p_hint_ms[p_ids[j] - 1]);
+      }
+    }
+    raft_status_t const send_status = send_append_entries(p_state,
+                                                          recipient_id,
+                                                          p_args);
+    if (RAFT_FAILURE(send_status)) {
+      status = send_status;
+    }
+    start = end;
+  }
+  return status;
+}
+
+static raft_status_t send_append_entries(raft_state_t* p_state,
+                                         raft_nodeid_t recipient_id,
+                                         raft_append_entries_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_append_entries_rpc) {
+    status = p_config->cb.pf_append_entries_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_append_entries_envelope(&envelope,
+                                                recipient_id,
+                                                p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
+
+static raft_status_t send_heartbeat(raft_state_t* p_state,
+                                    raft_nodeid_t recipient_id,
+                                    raft_heartbeat_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_heartbeat_rpc) {
+    status = p_config->cb.pf_heartbeat_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_heartbeat_envelope(&envelope, recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
@@ -1,19 +1,42 @@
 #include <stdlib.h>
 
 #include "raft_rpc.h"
+#include "raft_election.h"
+#include "raft_lease.h"
 #include "raft_log.h"
+#include "raft_membership.h"
+#include "raft_read.h"
+#include "raft_recovery.h"
 #include "raft_config.h"
+#include "raft_replication.h"
 #include "raft_state.h"
 #include "raft_util.h"
 #include "raft_wire.h"
 
-static raft_status_t promote_to_leader(raft_state_t* p_state);
+static raft_status_t flush_batch(raft_state_t* p_state);
+static raft_status_t heed_leader(
+    raft_state_t* p_state,
+    raft_term_t term,
+    raft_nodeid_t leader_id,
+    uint32_t election_timeout_hint_ms,
+    raft_append_entries_response_args_t* p_response);
 static void on_leader_ping(raft_state_t* p_state);
+static raft_bool_t log_is_current(raft_state_t const* p_state,
+                                  raft_request_vote_args_t const* p_args);
+static raft_bool_t heard_from_leader(raft_state_t const* p_state);
 
+static raft_status_t send_append_entries_response(
+    raft_state_t* p_state,
+    raft_nodeid_t recipient_id,
+    raft_append_entries_response_args_t* p_args);
 static raft_status_t send_request_vote_response(
     raft_state_t* p_state,
     raft_nodeid_t recipient_id,
     raft_request_vote_response_args_t* p_args);
+static raft_status_t send_pre_vote_response(
+    raft_state_t* p_state,
+    raft_nodeid_t recipient_id,
+    raft_request_vote_response_args_t* p_args);
 
 
 raft_status_t raft_recv_message(raft_state_t* p_state,
@@ -32,6 +55,7 @@ raft_status_t raft_recv_message(raft_state_t* p_state,
         return status;
       }
       status = raft_recv_append_entries(p_state, &args);
+      raft_dealloc_append_entries_args(&args);
       break;
     }
     case MSG_TYPE_APPEND_ENTRIES_RESPONSE:
@@ -46,6 +70,16 @@ raft_status_t raft_recv_message(raft_state_t* p_state,
       status = raft_recv_append_entries_response(p_state, &args);
       break;
     }
+    case MSG_TYPE_HEARTBEAT:
+    {
+      raft_heartbeat_args_t args;
+      status = raft_read_heartbeat_args(&args, p_message_bytes, buffer_size);
+      if (RAFT_FAILURE(status)) {
+        return status;
+      }
+      status = raft_recv_heartbeat(p_state, &args);
+      break;
+    }
     case MSG_TYPE_REQUEST_VOTE:
     {
       raft_request_vote_args_t args;
@@ -68,6 +102,82 @@ raft_status_t raft_recv_message(raft_state_t* p_state,
       status = raft_recv_request_vote_response(p_state, &args);
       break;
     }
+    case MSG_TYPE_PRE_VOTE:
+    {
+      raft_request_vote_args_t args;
+      status = raft_read_request_vote_args(&args, p_message_bytes, buffer_size);
+      if (RAFT_FAILURE(status)) {
+        return status;
+      }
+      status = raft_recv_pre_vote(p_state, &args);
+      break;
+    }
+    case MSG_TYPE_PRE_VOTE_RESPONSE:
+    {
+      raft_request_vote_response_args_t args;
+      status = raft_read_request_vote_response_args(&args,
+                                                    p_message_bytes,
+                                                    buffer_size);
+      if (RAFT_FAILURE(status)) {
+        return status;
+      }
+      status = raft_recv_pre_vote_response(p_state, &args);
+      break;
+    }
+    case MSG_TYPE_TIMEOUT_NOW:
+    {
+      raft_timeout_now_args_t args;
+      status = raft_read_timeout_now_args(&args, p_message_bytes, buffer_size);
+      if (RAFT_FAILURE(status)) {
+        return status;
+      }
+      status = raft_recv_timeout_now(p_state, &args);
+      break;
+    }
+    case MSG_TYPE_READ_INDEX:
+    {
+      raft_read_index_args_t args;
+      status = raft_read_read_index_args(&args, p_message_bytes, buffer_size);
+      if (RAFT_FAILURE(status)) {
+        return status;
+      }
+      status = raft_recv_read_index(p_state, &args);
+      break;
+    }
+    case MSG_TYPE_READ_INDEX_RESPONSE:
+    {
+      raft_read_index_response_args_t args;
+      status = raft_read_read_index_response_args(&args,
+                                                  p_message_bytes,
+                                                  buffer_size);
+      if (RAFT_FAILURE(status)) {
+        return status;
+      }
+      status = raft_recv_read_index_response(p_state, &args);
+      break;
+    }
+    case MSG_TYPE_FRAGMENT:
+    {
+      raft_fragment_args_t args;
+      status = raft_read_fragment_args(&args, p_message_bytes, buffer_size);
+      if (RAFT_FAILURE(status)) {
+        return status;
+      }
+      status = raft_recv_fragment(p_state, &args);
+      break;
+    }
+    case MSG_TYPE_FRAGMENT_RESPONSE:
+    {
+      raft_fragment_response_args_t args;
+      status = raft_read_fragment_response_args(&args,
+                                                p_message_bytes,
+                                                buffer_size);
+      if (RAFT_FAILURE(status)) {
+        return status;
+      }
+      status = raft_recv_fragment_response(p_state, &args);
+      break;
+    }
     default:
     {
       RAFT_ASSERT(RAFT_FALSE);
@@ -77,49 +187,253 @@ raft_status_t raft_recv_message(raft_state_t* p_state,
   return status;
 }
 
+raft_status_t raft_recv_messages(raft_state_t* p_state,
+                                 void** pp_message_bytes,
+                                 uint32_t const* p_buffer_sizes,
+                                 uint32_t num_messages) {
+  raft_status_t status = RAFT_STATUS_OK;
+
+  p_state->b.active = RAFT_TRUE;
+  for (uint32_t i = 0; i < num_messages; ++i) {
+    raft_status_t const recv_status = raft_recv_message(p_state,
+                                                        pp_message_bytes[i],
+                                                        p_buffer_sizes[i]);
+    if (RAFT_SUCCESS(status)) {
+      status = recv_status;
+    }
+  }
+
+  raft_status_t const flush_status = flush_batch(p_state);
+  return RAFT_SUCCESS(status) ? flush_status : status;
+}
+
+static raft_status_t flush_batch(raft_state_t* p_state) {
+  raft_status_t status = RAFT_STATUS_OK;
+  p_state->b.active = RAFT_FALSE;
+
+  if (p_state->b.commit_dirty && p_state->type == RAFT_NODE_TYPE_LEADER) {
+    raft_advance_commit_index(p_state);
+  }
+  p_state->b.commit_dirty = RAFT_FALSE;
+
+  for (uint32_t i = 0; i < p_state->m.capacity; ++i) {
+    raft_status_t send_status = RAFT_STATUS_OK;
+    if (p_state->b.p_respond[i]) {
+      p_state->b.p_respond[i] = RAFT_FALSE;
+      send_status = send_append_entries_response(p_state, i + 1,
+                                                 &p_state->b.p_responses[i]);
+    }
+    if (p_state->b.p_replicate[i]) {
+      p_state->b.p_replicate[i] = RAFT_FALSE;
+      if (p_state->type == RAFT_NODE_TYPE_LEADER) {
+        send_status = raft_replicate_to(p_state, i + 1);
+      }
+    }
+    if (RAFT_SUCCESS(status)) {
+      status = send_status;
+    }
+  }
+
+  raft_status_t const apply_status = raft_apply_committed(p_state);
+  if (RAFT_SUCCESS(status)) {
+    status = apply_status;
+  }
+
+  raft_status_t const read_status = raft_reads_start(p_state);
+  return RAFT_SUCCESS(status) ? read_status : status;
+}
+
 raft_status_t
 raft_recv_append_entries(raft_state_t* p_state,
                          raft_append_entries_args_t* p_args) {
   raft_log_t* p_log = p_state->p.p_log;
+  raft_status_t status = RAFT_STATUS_OK;
 
-  if (p_args->term < p_state->p.current_term) {
-    return RAFT_STATUS_INVALID_TERM;
+  raft_append_entries_response_args_t response = {
+    .follower_id = p_state->p.self,
+    .term = p_state->p.current_term,
+    .success = RAFT_FALSE,
+    .seq = p_args->seq,
+  };
+
+  status = heed_leader(p_state,
+                       p_args->term,
+                       p_args->leader_id,
+                       p_args->election_timeout_hint_ms,
+                       &response);
+  if (RAFT_FAILURE(status)) {
+    return status;
   }
 
-  if (p_args->term > p_state->p.current_term) {
-    raft_state_set_type(p_state, RAFT_NODE_TYPE_FOLLOWER);
-    p_state->p.current_term = p_args->term;
-  } else if (p_state->type == RAFT_NODE_TYPE_LEADER) {
-    RAFT_LOG(p_state,
-             "Leader received invalid AppendEntries request for the current"
-             " term from another leader. Sender id: %u.",
-             p_args->leader_id);
-    return RAFT_STATUS_INVALID_ARGS;
+  /* Relays forward the entries whether or not they fit this node's log. */
+  if (p_args->num_relay_ids > 0 &&
+      RAFT_FAILURE(status = raft_relay(p_state, p_args))) {
+    return status;
   }
 
-  on_leader_ping(p_state);
+  raft_index_t const log_length = raft_log_length(p_log);
+  if (p_args->prev_log_index >= log_length) {
+    /* Hint at where the leader should resume. */
+    response.acknowledged_log_index = log_length - 1;
+    return send_append_entries_response(p_state, p_args->leader_id, &response);
+  }
 
-  raft_log_entry_t const* p_prev_entry;
-  p_prev_entry = raft_log_entry(p_log, p_args->prev_log_index);
-  if (p_prev_entry == NULL || p_prev_entry->term != p_args->prev_log_term) {
-    // TODO: Delete unexpected entries. Enqueue response.
-    return RAFT_STATUS_OK;
+  if (raft_log_entry(p_log, p_args->prev_log_index)->term !=
+      p_args->prev_log_term) {
+    response.acknowledged_log_index = p_args->prev_log_index - 1;
+    return send_append_entries_response(p_state, p_args->leader_id, &response);
   }
 
-  raft_log_append(p_state->p.p_log, p_args->p_log_entries, p_args->num_entries);
+  /* Skip entries already present and drop any that conflict. */
+  uint32_t skip = 0;
+  for (; skip < p_args->num_entries; ++skip) {
+    raft_index_t const index = p_args->prev_log_index + 1 + skip;
+    if (index >= raft_log_length(p_log)) {
+      break;
+    }
+    if (raft_log_entry(p_log, index)->term != p_args->p_log_entries[skip].term) {
+      raft_log_truncate(p_log, index);
+      raft_recovery_truncated(p_state, index);
+      p_state->r.unstable_index = MIN(p_state->r.unstable_index, index);
+      if (RAFT_FAILURE(status = raft_membership_truncated(p_state, index))) {
+        return status;
+      }
+      break;
+    }
+  }
+
+  /* Witnesses keep only the entries' metadata, whatever was sent. */
+  if (raft_membership_is_witness(p_state, p_state->p.self)) {
+    status = raft_log_append_metadata(p_log,
+                                      p_args->p_log_entries + skip,
+                                      p_args->num_entries - skip);
+  } else {
+    status = raft_log_append(p_log,
+                             p_args->p_log_entries + skip,
+                             p_args->num_entries - skip);
+  }
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+  status = raft_membership_appended(p_state,
+                                    p_args->prev_log_index + 1 + skip);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
 
-  p_state->v.commit_index = MIN(MAX(p_state->v.commit_index,
-                                    p_args->leader_commit),
-                                raft_log_length(p_log) - 1);
+  raft_index_t const last_new_index = (p_args->prev_log_index +
+                                       p_args->num_entries);
+  p_state->v.commit_index = MAX(p_state->v.commit_index,
+                                MIN(p_args->leader_commit, last_new_index));
+
+  response.success = RAFT_TRUE;
+  response.acknowledged_log_index = last_new_index;
+  response.acknowledged_log_term = raft_log_entry(p_log, last_new_index)->term;
+  status = send_append_entries_response(p_state, p_args->leader_id, &response);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
 
-  // TODO: Enqueue response.
-  return RAFT_STATUS_OK;
+  return raft_apply_committed(p_state);
+}
+
+raft_status_t
+raft_recv_heartbeat(raft_state_t* p_state,
+                    raft_heartbeat_args_t* p_args) {
+  raft_log_t const* p_log = p_state->p.p_log;
+
+  raft_append_entries_response_args_t response = {
+    .follower_id = p_state->p.self,
+    .term = p_state->p.current_term,
+    .success = RAFT_FALSE,
+    .seq = p_args->seq,
+  };
+
+  raft_status_t status = heed_leader(p_state,
+                                     p_args->term,
+                                     p_args->leader_id,
+                                     p_args->election_timeout_hint_ms,
+                                     &response);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  /* The leader only sends these once it has matched this node's whole log,
+   * so its commit index can be taken as far as the log goes. */
+  raft_index_t const index = MIN(p_args->leader_commit,
+                                 raft_log_length(p_log) - 1);
+  p_state->v.commit_index = MAX(p_state->v.commit_index, index);
+
+  response.success = RAFT_TRUE;
+  response.acknowledged_log_index = index;
+  response.acknowledged_log_term = raft_log_entry(p_log, index)->term;
+  status = send_append_entries_response(p_state, p_args->leader_id, &response);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  return raft_apply_committed(p_state);
 }
 
 raft_status_t
 raft_recv_append_entries_response(raft_state_t* p_state,
                                   raft_append_entries_response_args_t* p_args) {
-  return RAFT_STATUS_OK;
+  if (p_args->term > p_state->p.current_term) {
+    raft_state_set_type(p_state, RAFT_NODE_TYPE_FOLLOWER);
+    raft_state_set_term(p_state, p_args->term);
+    return RAFT_STATUS_OK;
+  }
+
+  if (p_args->term < p_state->p.current_term ||
+      p_state->type != RAFT_NODE_TYPE_LEADER) {
+    return RAFT_STATUS_OK;
+  }
+
+  if (p_args->follower_id == 0 ||
+      p_args->follower_id > p_state->m.capacity ||
+      p_args->follower_id == p_state->p.self) {
+    RAFT_LOG(p_state, "Received append entries response from unknown node.");
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  /* Any response for the current term confirms leadership. */
+  p_state->l.p_last_ack_ms[p_args->follower_id - 1] = p_state->v.clock_ms;
+  raft_lease_ack(p_state, p_args->follower_id, p_args->seq);
+  raft_reads_ack(p_state, p_args->follower_id, p_args->seq);
+  raft_election_rtt_ack(p_state, p_args->follower_id, p_args->seq);
+
+  raft_index_t* p_next_index = &p_state->l.p_next_index[p_args->follower_id - 1];
+  raft_index_t* p_match_index =
+      &p_state->l.p_match_index[p_args->follower_id - 1];
+
+  if (p_args->success) {
+    *p_match_index = MAX(*p_match_index, p_args->acknowledged_log_index);
+    *p_next_index = MAX(*p_next_index, *p_match_index + 1);
+
+    raft_advance_commit_index(p_state);
+    raft_status_t status = raft_apply_committed(p_state);
+    if (RAFT_FAILURE(status)) {
+      return status;
+    }
+    /* Committing a configuration without this node steps it down. */
+    if (p_state->type != RAFT_NODE_TYPE_LEADER) {
+      return RAFT_STATUS_OK;
+    }
+    if (RAFT_FAILURE(status = raft_transfer_check(p_state))) {
+      return status;
+    }
+
+    if (*p_next_index < raft_log_length(p_state->p.p_log)) {
+      return raft_replicate_to(p_state, p_args->follower_id);
+    }
+    return RAFT_STATUS_OK;
+  }
+
+  /* Back off to the follower's hint, but never below what it has matched. */
+  *p_next_index = MAX(*p_match_index + 1,
+                      MIN(*p_next_index - 1,
+                          p_args->acknowledged_log_index + 1));
+  return raft_replicate_to(p_state, p_args->follower_id);
 }
 
 raft_status_t
@@ -138,23 +452,31 @@ raft_recv_request_vote(raft_state_t* p_state,
     goto respond;
   }
 
+  /**
+   * With leases, a node that has heard from a leader within the minimum
+   * election timeout ignores candidates, or that leader's lease would not
+   * hold.
+   */
+  if (p_state->p_config->lease_reads && !p_args->leadership_transfer &&
+      (p_state->type == RAFT_NODE_TYPE_LEADER ?
+       raft_lease_valid(p_state) :
+       heard_from_leader(p_state))) {
+    RAFT_LOG(p_state, "Ignoring vote request from %u while in lease.",
+             p_args->candidate_id);
+    goto respond;
+  }
+
   if (p_args->term > p_state->p.current_term) {
-    response.term = p_state->p.current_term = p_args->term;
     raft_state_set_type(p_state, RAFT_NODE_TYPE_FOLLOWER);
-    p_state->p.voted_for = 0;
+    raft_state_set_term(p_state, p_args->term);
+    response.term = p_args->term;
   }
 
   if (p_state->p.voted_for && p_state->p.voted_for != p_args->candidate_id) {
     goto respond;
   }
 
-  raft_log_t const* p_log = p_state->p.p_log;
-  raft_log_entry_t const* p_entry = raft_log_entry(p_log, -1);
-  raft_term_t const latest_term = p_entry ? p_entry->term : 0;
-  if (p_args->last_log_term > latest_term ||
-      (p_args->last_log_term == latest_term &&
-       p_args->last_log_index + 1 >= raft_log_length(p_log))) {
-
+  if (log_is_current(p_state, p_args)) {
     RAFT_LOG(p_state, "Voting for nodeid: %u, term: %u.",
              p_args->candidate_id, p_args->term);
     p_state->p.voted_for = p_args->candidate_id;
@@ -190,13 +512,13 @@ raft_recv_request_vote_response(raft_state_t* p_state,
     return RAFT_STATUS_INVALID_ARGS;
   }
 
-  uint32_t const node_count = p_state->p_config->node_count;
-  if (p_args->follower_id > node_count) {
+  if (p_args->follower_id == 0 || p_args->follower_id > p_state->m.capacity) {
     RAFT_LOG(p_state, "Received request vote response from unknown node.");
     return RAFT_STATUS_INVALID_ARGS;
   }
 
-  if (p_state->type == RAFT_NODE_TYPE_LEADER) {
+  /* Leaders have already won; pre-candidates are not counting real votes. */
+  if (p_state->type != RAFT_NODE_TYPE_CANDIDATE) {
     return RAFT_STATUS_OK;
   }
 
@@ -205,38 +527,201 @@ raft_recv_request_vote_response(raft_state_t* p_state,
   raft_bool_t* p_ballot = p_state->l.p_ballot;
   p_ballot[p_args->follower_id - 1] = p_args->vote_granted;
 
-  if (raft_state_vote_count(p_state) > node_count / 2) {
-    promote_to_leader(p_state);
+  if (raft_membership_ballot_won(p_state)) {
+    raft_promote_to_leader(p_state);
   }
 
   return RAFT_STATUS_OK;
 }
 
-static raft_status_t promote_to_leader(raft_state_t* p_state) {
-  RAFT_LOG(p_state, "Leader for term %u.",
-           p_state->p.current_term);
+raft_status_t
+raft_recv_pre_vote(raft_state_t* p_state,
+                   raft_request_vote_args_t* p_args) {
+  RAFT_LOG(p_state, "Received pre-vote from nodeid: %u, term: %u",
+           p_args->candidate_id, p_args->term);
+
+  raft_request_vote_response_args_t response = {
+    .follower_id = p_state->p.self,
+    .vote_granted = RAFT_FALSE,
+    .term = p_state->p.current_term
+  };
+
+  /* Neither the term nor the vote changes, whatever the answer. */
+  if (p_args->term > p_state->p.current_term &&
+      p_state->type != RAFT_NODE_TYPE_LEADER &&
+      !heard_from_leader(p_state) &&
+      log_is_current(p_state, p_args)) {
+    response.vote_granted = RAFT_TRUE;
+    response.term = p_args->term;
+  }
+
+  return send_pre_vote_response(p_state, p_args->candidate_id, &response);
+}
+
+raft_status_t
+raft_recv_pre_vote_response(raft_state_t* p_state,
+                            raft_request_vote_response_args_t* p_args) {
+  if (p_state->type != RAFT_NODE_TYPE_PRE_CANDIDATE) {
+    return RAFT_STATUS_OK;
+  }
+
+  /* A refusal from a later term means this node has fallen behind. */
+  if (!p_args->vote_granted && p_args->term > p_state->p.current_term) {
+    raft_state_set_type(p_state, RAFT_NODE_TYPE_FOLLOWER);
+    raft_state_set_term(p_state, p_args->term);
+    return RAFT_STATUS_OK;
+  }
+
+  if (p_args->term != p_state->p.current_term + 1) {
+    return RAFT_STATUS_OK;
+  }
+
+  if (p_args->follower_id == 0 || p_args->follower_id > p_state->m.capacity) {
+    RAFT_LOG(p_state, "Received pre-vote response from unknown node.");
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  raft_bool_t* p_ballot = p_state->l.p_ballot;
+  p_ballot[p_args->follower_id - 1] = p_args->vote_granted;
+
+  if (raft_membership_ballot_won(p_state)) {
+    return raft_campaign(p_state, RAFT_FALSE);
+  }
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t
+raft_recv_timeout_now(raft_state_t* p_state,
+                      raft_timeout_now_args_t* p_args) {
+  if (p_args->term < p_state->p.current_term) {
+    return RAFT_STATUS_OK;
+  }
+
+  if (p_args->term > p_state->p.current_term) {
+    raft_state_set_type(p_state, RAFT_NODE_TYPE_FOLLOWER);
+    raft_state_set_term(p_state, p_args->term);
+  }
 
-  raft_state_set_type(p_state, RAFT_NODE_TYPE_LEADER);
+  if (p_state->type == RAFT_NODE_TYPE_LEADER ||
+      !raft_membership_can_lead(p_state, p_state->p.self)) {
+    return RAFT_STATUS_OK;
+  }
 
-  /* Send initial AppendEntries messages to establish leadership. */
-  uint32_t const node_count = p_state->p_config->node_count;
-  for (uint32_t i = 0; i < node_count; ++i) {
-    /* TODO: Actually send the damned messages! */
+  RAFT_LOG(p_state, "Leader %u handed over leadership.", p_args->leader_id);
+  return raft_campaign(p_state, RAFT_TRUE);
+}
+
+/**
+ * Follows the sender of an AppendEntries or heartbeat for term, or answers
+ * with this node's term and fails if term is stale.
+ */
+static raft_status_t heed_leader(
+    raft_state_t* p_state,
+    raft_term_t term,
+    raft_nodeid_t leader_id,
+    uint32_t election_timeout_hint_ms,
+    raft_append_entries_response_args_t* p_response) {
+  if (term < p_state->p.current_term) {
+    send_append_entries_response(p_state, leader_id, p_response);
+    return RAFT_STATUS_INVALID_TERM;
   }
 
+  if (term > p_state->p.current_term) {
+    raft_state_set_type(p_state, RAFT_NODE_TYPE_FOLLOWER);
+    raft_state_set_term(p_state, term);
+    p_response->term = term;
+  } else if (p_state->type == RAFT_NODE_TYPE_LEADER) {
+    RAFT_LOG(p_state,
+             "Leader received invalid AppendEntries request for the current"
+             " term from another leader. Sender id: %u.",
+             leader_id);
+    return RAFT_STATUS_INVALID_ARGS;
+  } else {
+    /* A candidate that hears from the leader of its term concedes. */
+    raft_state_set_type(p_state, RAFT_NODE_TYPE_FOLLOWER);
+  }
+
+  p_state->v.leader_id = leader_id;
+  p_state->v.election_timeout_hint_ms = election_timeout_hint_ms;
+  on_leader_ping(p_state);
   return RAFT_STATUS_OK;
 }
 
 static void on_leader_ping(raft_state_t* p_state) {
-  raft_config_t* p_config = p_state->p_config;
+  raft_reset_election_timer(p_state);
+}
+
+/**
+ * Whether the candidate's log is at least as up to date as this node's.
+ */
+static raft_bool_t log_is_current(raft_state_t const* p_state,
+                                  raft_request_vote_args_t const* p_args) {
+  raft_log_t const* p_log = p_state->p.p_log;
+  raft_log_entry_t const* p_entry = raft_log_entry(p_log, -1);
+  raft_term_t const latest_term = p_entry ? p_entry->term : 0;
+  return (p_args->last_log_term > latest_term ||
+          (p_args->last_log_term == latest_term &&
+           p_args->last_log_index + 1 >= raft_log_length(p_log)));
+}
 
-  p_state->v.ms_since_last_leader_ping = 0;
-  uint32_t range = (p_config->election_timeout_max_ms -
-                    p_config->election_timeout_min_ms);
-  p_state->v.election_timeout_ms = ((rand() % range) +
-                                    p_config->election_timeout_min_ms);
+/**
+ * Whether a follower has heard from a leader within the minimum election
+ * timeout, so that no election could be needed yet.
+ */
+static raft_bool_t heard_from_leader(raft_state_t const* p_state) {
+  return (p_state->v.leader_id != 0 &&
+          p_state->v.ms_since_last_leader_ping <
+          p_state->p_config->election_timeout_min_ms);
 }
 
+static raft_status_t send_append_entries_response(
+    raft_state_t* p_state,
+    raft_nodeid_t recipient_id,
+    raft_append_entries_response_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  if (p_state->b.active &&
+      recipient_id > 0 && recipient_id <= p_state->m.capacity) {
+    /* Keep the most informative response to each leader. */
+    raft_append_entries_response_args_t* p_pending =
+        &p_state->b.p_responses[recipient_id - 1];
+    if (!p_state->b.p_respond[recipient_id - 1] ||
+        p_args->term > p_pending->term ||
+        !p_pending->success ||
+        (p_args->success &&
+         p_args->acknowledged_log_index >= p_pending->acknowledged_log_index)) {
+      uint32_t const seq = (p_state->b.p_respond[recipient_id - 1] ?
+                            MAX(p_pending->seq, p_args->seq) :
+                            p_args->seq);
+      *p_pending = *p_args;
+      p_pending->seq = seq;
+    } else {
+      p_pending->seq = MAX(p_pending->seq, p_args->seq);
+    }
+    p_state->b.p_respond[recipient_id - 1] = RAFT_TRUE;
+    return RAFT_STATUS_OK;
+  }
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_append_entries_response_rpc) {
+    status = p_config->cb.pf_append_entries_response_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_append_entries_response_envelope(&envelope,
+                                                         recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
 
 static raft_status_t send_request_vote_response(
     raft_state_t* p_state,
@@ -244,17 +729,45 @@ static raft_status_t send_request_vote_response(
     raft_request_vote_response_args_t* p_args) {
   raft_config_t const* p_config = p_state->p_config;
 
-  raft_status_t status;
-  if (p_config->cb.pf_request_vote_response_rpc) {
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_request_vote_response_rpc) {
     status = p_config->cb.pf_request_vote_response_rpc(recipient_id, p_args);
   } else {
     raft_envelope_t envelope = { 0 };
     status = raft_write_request_vote_response_envelope(&envelope,
                                                        recipient_id, p_args);
     if (RAFT_SUCCESS(status)) {
-      status = p_config->cb.pf_send_message(recipient_id,
-                                            envelope.p_message,
-                                            envelope.message_size);
+      status = raft_state_send_envelope(p_state, &envelope);
+    } else {
+      raft_dealloc_envelope(&envelope);
+    }
+  }
+  return status;
+}
+
+static raft_status_t send_pre_vote_response(
+    raft_state_t* p_state,
+    raft_nodeid_t recipient_id,
+    raft_request_vote_response_args_t* p_args) {
+  raft_config_t const* p_config = p_state->p_config;
+
+  raft_status_t status = raft_state_persist_hard_state(p_state);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  if (!p_config->use_ready && p_config->cb.pf_pre_vote_response_rpc) {
+    status = p_config->cb.pf_pre_vote_response_rpc(recipient_id, p_args);
+  } else {
+    raft_envelope_t envelope = { 0 };
+    status = raft_write_pre_vote_response_envelope(&envelope,
+                                                   recipient_id, p_args);
+    if (RAFT_SUCCESS(status)) {
+      status = raft_state_send_envelope(p_state, &envelope);
     } else {
       raft_dealloc_envelope(&envelope);
     }
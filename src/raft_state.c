@@ -1,31 +1,98 @@
-#include "string.h"
+#include <stdlib.h>
+#include <string.h>
 
 #include "raft_util.h"
 #include "raft_state.h"
 #include "raft_config.h"
+#include "raft_proposal.h"
+#include "raft_lease.h"
+#include "raft_membership.h"
+#include "raft_read.h"
 
 static char* a_type_strings[] = {
   "RAFT_NODE_TYPE_LEADER",
   "RAFT_NODE_TYPE_FOLLOWER",
   "RAFT_NODE_TYPE_CANDIDATE",
+  "RAFT_NODE_TYPE_PRE_CANDIDATE",
 };
 
 void raft_state_set_type(raft_state_t* p_state, raft_node_type_t type) {
-  if (p_state->type != type) {
+  raft_node_type_t const old_type = p_state->type;
+  p_state->type = type;
+
+  if (old_type != type) {
     RAFT_LOG(p_state, "%s -> %s.",
-             a_type_strings[p_state->type], a_type_strings[type]);
+             a_type_strings[old_type], a_type_strings[type]);
+    if (old_type == RAFT_NODE_TYPE_LEADER) {
+      raft_proposals_fail(p_state);
+      raft_reads_fail(p_state);
+      raft_lease_drop(p_state);
+      p_state->l.transfer_id = 0;
+    }
   }
-  p_state->type = type;
+}
+
+void raft_state_set_term(raft_state_t* p_state, raft_term_t term) {
+  p_state->p.current_term = term;
+  p_state->p.voted_for = 0;
+  p_state->v.leader_id = 0;
+
+  /* A follower's read index request died with the old term. */
+  raft_reads_fail(p_state);
 }
 
 uint32_t raft_state_vote_count(raft_state_t* p_state) {
-  uint32_t const node_count = p_state->p_config->node_count;
   raft_bool_t const* p_ballot = p_state->l.p_ballot;
   uint32_t sum = 0;
-  for (uint32_t i = 0; i < node_count; ++i) {
-    if (p_ballot[i])
+  for (uint32_t i = 0; i < p_state->m.capacity; ++i) {
+    if (p_ballot[i] && raft_membership_is_voter(p_state, i + 1))
       ++sum;
   }
 
   return sum;
 }
+
+raft_status_t raft_state_persist_hard_state(raft_state_t* p_state) {
+  raft_config_t const* p_config = p_state->p_config;
+  if (p_config->use_ready ||
+      p_config->cb.pf_persist_hard_state == NULL ||
+      (p_state->r.persisted_term == p_state->p.current_term &&
+       p_state->r.persisted_voted_for == p_state->p.voted_for)) {
+    return RAFT_STATUS_OK;
+  }
+
+  raft_status_t const status =
+      p_config->cb.pf_persist_hard_state(p_state->p.current_term,
+                                         p_state->p.voted_for);
+  if (RAFT_SUCCESS(status)) {
+    p_state->r.persisted_term = p_state->p.current_term;
+    p_state->r.persisted_voted_for = p_state->p.voted_for;
+  }
+  return status;
+}
+
+raft_status_t raft_state_send_envelope(raft_state_t* p_state,
+                                       raft_envelope_t* p_envelope) {
+  raft_config_t const* p_config = p_state->p_config;
+  if (!p_config->use_ready) {
+    return p_config->cb.pf_send_message(p_envelope->recipient_id,
+                                        p_envelope->p_message,
+                                        p_envelope->message_size);
+  }
+
+  if (p_state->r.message_count == p_state->r.message_capacity) {
+    uint32_t const capacity = MAX(8, 2 * p_state->r.message_capacity);
+    raft_envelope_t* p_messages = realloc(p_state->r.p_messages,
+                                          capacity * sizeof(*p_messages));
+    if (p_messages == NULL) {
+      raft_dealloc_envelope(p_envelope);
+      return RAFT_STATUS_OUT_OF_MEMORY;
+    }
+    p_state->r.p_messages = p_messages;
+    p_state->r.message_capacity = capacity;
+  }
+
+  p_state->r.p_messages[p_state->r.message_count++] = *p_envelope;
+  memset(p_envelope, 0, sizeof(*p_envelope));
+  return RAFT_STATUS_OK;
+}
@@ -1 +1,13 @@
 #include "raft_util.h"
+
+uint32_t raft_crc32c(uint32_t crc, void const* p_data, uint32_t size) {
+  uint8_t const* p_byte = p_data;
+  crc = ~crc;
+  for (uint32_t ii = 0; ii < size; ++ii) {
+    crc ^= p_byte[ii];
+    for (uint32_t bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
@@ -0,0 +1,1303 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "raft_wal.h"
+#include "raft_util.h"
+#include "raft_wal_uring.h"
+
+/**
+ * Segment layout, in network (big-endian) order:
+ *
+ * Bytes | Semantics
+ * =============================================================================
+ *   0-3 | Magic number                   -|
+ *   4-7 | Version                         | Segment header
+ *  8-11 | Index of the first entry        |
+ * 12-15 | Offset of the footer, zero     -|
+ *       | until the segment is sealed
+ * ========================================
+ *   0-3 | Data size                      -|
+ *   4-7 | CRC-32C of the rest of the      | Record, one per entry,
+ *       | record from byte 8              | padded to 8 bytes
+ *  8-11 | Index                           |
+ * 12-15 | Term                            |
+ * 16-19 | Unique id                       |
+ * 20-23 | Type                            |
+ * 24-27 | Coded size                      |
+ * 28-29 | Fragments needed                |
+ * 30-31 | Fragment index                  |
+ *  32-* | Data                           -|
+ * ========================================
+ *   0-7 | Offset and term of each record -| Footer, following the
+ *  8n-* | Entry count                     | records of a sealed segment
+ *   +4- | CRC-32C of the footer before it-|
+ * =============================================================================
+ */
+
+#define SEGMENT_MAGIC       0x52414653 /* "RAFS" */
+#define SEGMENT_VERSION     1
+#define SEGMENT_HEADER_SIZE 16
+#define RECORD_HEADER_SIZE  32
+#define RECORD_CRC_OFFSET   8
+#define RECORD_ALIGN        8
+#define FOOTER_OFFSET_POS   12
+#define FOOTER_ENTRY_SIZE   8
+#define FOOTER_TRAILER_SIZE 8
+#define SEGMENT_SUFFIX      "seg"
+#define SPARE_SUFFIX        "spare"
+
+typedef struct {
+  raft_index_t first_index;
+  uint32_t     num_entries;
+
+  /* Offset and term of each entry's record. Segments sealed by an earlier
+   * run are indexed when first read, see index_segment(). */
+  uint32_t*    p_offsets;
+  raft_term_t* p_terms;
+  uint32_t     entry_capacity;
+
+  /* Bytes up to the end of the last record. */
+  uint32_t size;
+
+  /* The last segment is written through fd; sealed ones are mapped. Neither
+   * is set for a segment not indexed yet. */
+  int      fd;
+  uint8_t* p_map;
+  uint32_t map_size;
+
+  /* Set once every record's CRC has been checked. */
+  raft_bool_t verified;
+} segment_t;
+
+struct raft_wal {
+  char*             p_dir;
+  raft_wal_config_t config;
+
+  /* Set when writes go through io_uring, see raft_wal_config_t.io_depth. */
+  raft_wal_uring_t* p_uring;
+
+  /* Entries before durable_index are known to be synced. */
+  raft_index_t durable_index;
+
+  segment_t* p_segments;
+  uint32_t   segment_count;
+  uint32_t   segment_capacity;
+
+  /* Ids of preallocated files ready to become segments, named after them. */
+  uint32_t* p_spares;
+  uint32_t  spare_count;
+  uint32_t  spare_capacity;
+  uint32_t  next_spare_id;
+
+  /* Set when segments were created or removed since the last sync. */
+  raft_bool_t dir_changed;
+
+  /* Records being written to the last segment. */
+  uint8_t* p_write_buf;
+  uint32_t write_size;
+  uint32_t write_capacity;
+
+  /* The last entry read from the last segment. */
+  uint8_t* p_read_buf;
+  uint32_t read_capacity;
+};
+
+static uint8_t* write_u32(uint8_t* p_b, uint32_t v) {
+  for (int32_t ii = 3; ii >= 0; --ii) {
+    (*p_b++) = RAFT_LSBYTE(v, ii);
+  }
+  return p_b;
+}
+
+static uint8_t const* read_u32(uint32_t* p_v, uint8_t const* p_b) {
+  *p_v = 0;
+  for (uint32_t ii = 0; ii < 4; ++ii) {
+    *p_v = (*p_v << 8) | (*p_b++);
+  }
+  return p_b;
+}
+
+static raft_status_t reserve(void** pp_buffer,
+                             uint32_t* p_capacity,
+                             uint32_t count,
+                             size_t element_size) {
+  if (count <= *p_capacity) {
+    return RAFT_STATUS_OK;
+  }
+
+  uint32_t const capacity = MAX(count, MAX(16, 2 * *p_capacity));
+  void* p_buffer = realloc(*pp_buffer, capacity * element_size);
+  if (p_buffer == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  *pp_buffer = p_buffer;
+  *p_capacity = capacity;
+  return RAFT_STATUS_OK;
+}
+
+static raft_status_t reserve_entries(segment_t* p_segment, uint32_t count) {
+  uint32_t capacity = p_segment->entry_capacity;
+  raft_status_t status = reserve((void**)&p_segment->p_offsets, &capacity,
+                                 count, sizeof(uint32_t));
+  if (RAFT_SUCCESS(status)) {
+    capacity = p_segment->entry_capacity;
+    status = reserve((void**)&p_segment->p_terms, &capacity,
+                     count, sizeof(raft_term_t));
+  }
+  if (RAFT_SUCCESS(status)) {
+    p_segment->entry_capacity = capacity;
+  }
+  return status;
+}
+
+static uint32_t record_size(uint32_t data_size) {
+  return RAFT_ALIGN_UP(RECORD_HEADER_SIZE + data_size, RECORD_ALIGN);
+}
+
+static void encode_record(uint8_t* p_record,
+                          raft_index_t index,
+                          raft_log_entry_t const* p_entry) {
+  uint32_t const data_size = p_entry->p_data ? p_entry->data_size : 0;
+  memset(p_record, 0, record_size(data_size));
+
+  uint8_t* p_b = write_u32(p_record, data_size);
+  p_b = write_u32(p_b, 0);
+  p_b = write_u32(p_b, index);
+  p_b = write_u32(p_b, p_entry->term);
+  p_b = write_u32(p_b, p_entry->unique_id);
+  p_b = write_u32(p_b, p_entry->type);
+  p_b = write_u32(p_b, p_entry->coded_size);
+  p_b = write_u32(p_b, ((uint32_t)p_entry->fragments_needed << 16) |
+                       p_entry->fragment_index);
+  if (data_size) {
+    memcpy(p_b, p_entry->p_data, data_size);
+  }
+
+  write_u32(p_record + 4,
+            raft_crc32c(0, p_record + RECORD_CRC_OFFSET,
+                        RECORD_HEADER_SIZE + data_size - RECORD_CRC_OFFSET));
+}
+
+static void decode_record(uint8_t const* p_record, raft_log_entry_t* p_entry) {
+  uint32_t crc, index, type, fragments;
+  memset(p_entry, 0, sizeof(*p_entry));
+
+  uint8_t const* p_b = read_u32(&p_entry->data_size, p_record);
+  p_b = read_u32(&crc, p_b);
+  p_b = read_u32(&index, p_b);
+  p_b = read_u32(&p_entry->term, p_b);
+  p_b = read_u32(&p_entry->unique_id, p_b);
+  p_b = read_u32(&type, p_b);
+  p_b = read_u32(&p_entry->coded_size, p_b);
+  p_b = read_u32(&fragments, p_b);
+
+  p_entry->type = type;
+  p_entry->fragments_needed = fragments >> 16;
+  p_entry->fragment_index = fragments & 0xffff;
+  p_entry->p_data = p_entry->data_size ? (void*)p_b : NULL;
+}
+
+/**
+ * Size of the intact record for index at p_record, or 0 if it is torn or
+ * holds another index.
+ */
+static uint32_t check_record(uint8_t const* p_record,
+                             uint32_t available,
+                             raft_index_t index) {
+  if (available < RECORD_HEADER_SIZE) {
+    return 0;
+  }
+
+  uint32_t data_size, crc, record_index;
+  read_u32(&data_size, p_record);
+  read_u32(&crc, p_record + 4);
+  read_u32(&record_index, p_record + 8);
+  if (data_size > available - RECORD_HEADER_SIZE ||
+      record_index != index ||
+      crc != raft_crc32c(0, p_record + RECORD_CRC_OFFSET,
+                         RECORD_HEADER_SIZE + data_size - RECORD_CRC_OFFSET)) {
+    return 0;
+  }
+  return MIN(record_size(data_size), available);
+}
+
+static char* file_path(raft_wal_t const* p_wal,
+                       uint32_t number,
+                       char const* p_suffix) {
+  size_t const length = strlen(p_wal->p_dir) + strlen(p_suffix) + 13;
+  char* p_path = malloc(length);
+  if (p_path) {
+    snprintf(p_path, length, "%s/%010u.%s", p_wal->p_dir, number, p_suffix);
+  }
+  return p_path;
+}
+
+static char* segment_path(raft_wal_t const* p_wal, raft_index_t first_index) {
+  return file_path(p_wal, first_index, SEGMENT_SUFFIX);
+}
+
+/**
+ * Overwrites bytes offset up to end with zeros.
+ */
+static raft_status_t zero_fill(int fd, uint32_t offset, uint32_t end) {
+  static uint8_t const a_zeros[4096];
+  while (offset < end) {
+    uint32_t const size = MIN(end - offset, (uint32_t)sizeof(a_zeros));
+    if (pwrite(fd, a_zeros, size, offset) != size) {
+      return RAFT_STATUS_IO_ERROR;
+    }
+    offset += size;
+  }
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * Allocates and zero-fills a whole segment's worth of blocks and syncs them,
+ * so that fdatasync() of writes into the segment flushes no block allocation
+ * or extent conversion.
+ */
+static raft_status_t preallocate(raft_wal_t const* p_wal, int fd) {
+  uint32_t const size = p_wal->config.segment_size;
+  if (posix_fallocate(fd, 0, size) != 0 ||
+      RAFT_FAILURE(zero_fill(fd, 0, size)) ||
+      fsync(fd) != 0) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+  return RAFT_STATUS_OK;
+}
+
+static raft_status_t create_spare(raft_wal_t* p_wal) {
+  raft_status_t status = reserve((void**)&p_wal->p_spares,
+                                 &p_wal->spare_capacity,
+                                 p_wal->spare_count + 1,
+                                 sizeof(uint32_t));
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  char* p_path = file_path(p_wal, p_wal->next_spare_id, SPARE_SUFFIX);
+  if (p_path == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  int const fd = open(p_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  status = fd < 0 ? RAFT_STATUS_IO_ERROR : preallocate(p_wal, fd);
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (RAFT_FAILURE(status)) {
+    unlink(p_path);
+  }
+  free(p_path);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  p_wal->p_spares[p_wal->spare_count++] = p_wal->next_spare_id++;
+  p_wal->dir_changed = RAFT_TRUE;
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * Tops the pool of spare segments up to raft_wal_config_t.spare_segments.
+ */
+static raft_status_t fill_spares(raft_wal_t* p_wal) {
+  raft_status_t status = RAFT_STATUS_OK;
+  while (p_wal->spare_count < p_wal->config.spare_segments &&
+         RAFT_SUCCESS(status)) {
+    status = create_spare(p_wal);
+  }
+  return status;
+}
+
+/**
+ * Whether the segment's bytes start with its header. Sets *p_footer_offset
+ * to the footer offset the header records.
+ */
+static raft_bool_t check_header(segment_t const* p_segment,
+                                uint8_t const* p_bytes,
+                                uint32_t size,
+                                uint32_t* p_footer_offset) {
+  uint32_t magic = 0, version = 0, first_index = 0;
+  *p_footer_offset = 0;
+  if (size >= SEGMENT_HEADER_SIZE) {
+    read_u32(&magic, p_bytes);
+    read_u32(&version, p_bytes + 4);
+    read_u32(&first_index, p_bytes + 8);
+    read_u32(p_footer_offset, p_bytes + FOOTER_OFFSET_POS);
+  }
+  return magic == SEGMENT_MAGIC &&
+         version == SEGMENT_VERSION &&
+         first_index == p_segment->first_index;
+}
+
+/**
+ * Indexes the records in the segment's bytes, stopping at the first that is
+ * not intact.
+ */
+static raft_status_t scan_segment(segment_t* p_segment,
+                                  uint8_t const* p_bytes,
+                                  uint32_t size) {
+  uint32_t footer_offset;
+  if (!check_header(p_segment, p_bytes, size, &footer_offset)) {
+    return RAFT_STATUS_INVALID_MESSAGE;
+  }
+
+  uint32_t offset = SEGMENT_HEADER_SIZE;
+  for (;;) {
+    uint32_t const length =
+        check_record(p_bytes + offset, size - offset,
+                     p_segment->first_index + p_segment->num_entries);
+    if (length == 0) {
+      break;
+    }
+
+    raft_status_t const status = reserve_entries(p_segment,
+                                                 p_segment->num_entries + 1);
+    if (RAFT_FAILURE(status)) {
+      return status;
+    }
+    read_u32(&p_segment->p_terms[p_segment->num_entries], p_bytes + offset + 12);
+    p_segment->p_offsets[p_segment->num_entries++] = offset;
+    offset += length;
+  }
+
+  p_segment->size = offset;
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * Indexes the num_entries records of a sealed segment from its footer,
+ * without reading them. Returns RAFT_STATUS_INVALID_MESSAGE if the footer is
+ * missing or damaged.
+ */
+static raft_status_t read_footer(segment_t* p_segment,
+                                 uint8_t const* p_bytes,
+                                 uint32_t size) {
+  uint32_t footer_offset;
+  uint32_t const footer_size =
+      p_segment->num_entries * FOOTER_ENTRY_SIZE + FOOTER_TRAILER_SIZE;
+  if (!check_header(p_segment, p_bytes, size, &footer_offset) ||
+      footer_offset < SEGMENT_HEADER_SIZE ||
+      footer_offset > size ||
+      size - footer_offset < footer_size) {
+    return RAFT_STATUS_INVALID_MESSAGE;
+  }
+
+  uint8_t const* p_footer = p_bytes + footer_offset;
+  uint32_t count, crc;
+  read_u32(&crc, read_u32(&count, p_footer + footer_size - FOOTER_TRAILER_SIZE));
+  if (count != p_segment->num_entries ||
+      crc != raft_crc32c(0, p_footer, footer_size - 4)) {
+    return RAFT_STATUS_INVALID_MESSAGE;
+  }
+
+  raft_status_t const status = reserve_entries(p_segment, count);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+  for (uint32_t ii = 0; ii < count; ++ii) {
+    p_footer = read_u32(&p_segment->p_offsets[ii], p_footer);
+    p_footer = read_u32(&p_segment->p_terms[ii], p_footer);
+    if (p_segment->p_offsets[ii] >= footer_offset) {
+      return RAFT_STATUS_INVALID_MESSAGE;
+    }
+  }
+  p_segment->size = footer_offset;
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * Waits for every write and sync submitted through io_uring.
+ */
+static raft_status_t settle(raft_wal_t* p_wal) {
+  if (p_wal->p_uring == NULL) {
+    return RAFT_STATUS_OK;
+  }
+  return raft_wal_uring_reap(p_wal->p_uring, RAFT_TRUE, &p_wal->durable_index);
+}
+
+/**
+ * Writes the segment's footer after its records and points its header at
+ * it.
+ */
+static raft_status_t write_footer(raft_wal_t* p_wal, segment_t* p_segment) {
+  uint32_t const size =
+      p_segment->num_entries * FOOTER_ENTRY_SIZE + FOOTER_TRAILER_SIZE;
+  raft_status_t const status = reserve((void**)&p_wal->p_write_buf,
+                                       &p_wal->write_capacity, size, 1);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  uint8_t* p_b = p_wal->p_write_buf;
+  for (uint32_t ii = 0; ii < p_segment->num_entries; ++ii) {
+    p_b = write_u32(p_b, p_segment->p_offsets[ii]);
+    p_b = write_u32(p_b, p_segment->p_terms[ii]);
+  }
+  p_b = write_u32(p_b, p_segment->num_entries);
+  write_u32(p_b, raft_crc32c(0, p_wal->p_write_buf, size - 4));
+
+  uint8_t a_offset[4];
+  write_u32(a_offset, p_segment->size);
+  if (pwrite(p_segment->fd, p_wal->p_write_buf, size, p_segment->size) !=
+          size ||
+      pwrite(p_segment->fd, a_offset, sizeof(a_offset), FOOTER_OFFSET_POS) !=
+          sizeof(a_offset)) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+  return RAFT_STATUS_OK;
+}
+
+static raft_status_t seal_segment(raft_wal_t* p_wal, segment_t* p_segment) {
+  raft_status_t status = settle(p_wal);
+  if (RAFT_SUCCESS(status)) {
+    status = write_footer(p_wal, p_segment);
+  }
+  if (RAFT_FAILURE(status) || fdatasync(p_segment->fd) != 0) {
+    return RAFT_FAILURE(status) ? status : RAFT_STATUS_IO_ERROR;
+  }
+
+  void* p_map = mmap(NULL, p_segment->size, PROT_READ, MAP_SHARED,
+                     p_segment->fd, 0);
+  if (p_map == MAP_FAILED) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+  /* Catch-up replication and replay read sealed segments in order. */
+  madvise(p_map, p_segment->size, MADV_SEQUENTIAL);
+
+  close(p_segment->fd);
+  p_segment->fd = -1;
+  p_segment->p_map = p_map;
+  p_segment->map_size = p_segment->size;
+  p_wal->durable_index = MAX(p_wal->durable_index,
+                             p_segment->first_index + p_segment->num_entries);
+  return RAFT_STATUS_OK;
+}
+
+static void release_segment(segment_t* p_segment) {
+  if (p_segment->p_map) {
+    madvise(p_segment->p_map, p_segment->map_size, MADV_DONTNEED);
+    munmap(p_segment->p_map, p_segment->map_size);
+  }
+  if (p_segment->fd >= 0) {
+    close(p_segment->fd);
+  }
+  free(p_segment->p_offsets);
+  free(p_segment->p_terms);
+  memset(p_segment, 0, sizeof(*p_segment));
+  p_segment->fd = -1;
+}
+
+/**
+ * Deletes the segment's file, or keeps it as a spare if recycle is set and
+ * the pool has room. Only segments compacted away may be recycled: their
+ * stale records hold indexes before any the file can later start at, so
+ * recovery never mistakes them for new ones.
+ */
+static raft_status_t remove_segment(raft_wal_t* p_wal,
+                                    segment_t* p_segment,
+                                    raft_bool_t recycle) {
+  recycle = recycle && p_wal->spare_count < p_wal->config.spare_segments;
+  raft_status_t status = RAFT_STATUS_OK;
+  if (recycle) {
+    status = reserve((void**)&p_wal->p_spares, &p_wal->spare_capacity,
+                     p_wal->spare_count + 1, sizeof(uint32_t));
+  }
+  char* p_path = segment_path(p_wal, p_segment->first_index);
+  char* p_spare_path = recycle
+      ? file_path(p_wal, p_wal->next_spare_id, SPARE_SUFFIX)
+      : NULL;
+  if (RAFT_SUCCESS(status) &&
+      (p_path == NULL || (recycle && p_spare_path == NULL))) {
+    status = RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  if (RAFT_FAILURE(status)) {
+    free(p_path);
+    free(p_spare_path);
+    return status;
+  }
+
+  release_segment(p_segment);
+  int const result = recycle ? rename(p_path, p_spare_path) : unlink(p_path);
+  if (recycle && result == 0) {
+    p_wal->p_spares[p_wal->spare_count++] = p_wal->next_spare_id++;
+  }
+  free(p_path);
+  free(p_spare_path);
+  p_wal->dir_changed = RAFT_TRUE;
+  return result == 0 ? RAFT_STATUS_OK : RAFT_STATUS_IO_ERROR;
+}
+
+static raft_status_t start_segment(raft_wal_t* p_wal, raft_index_t first_index) {
+  raft_status_t status = reserve((void**)&p_wal->p_segments,
+                                 &p_wal->segment_capacity,
+                                 p_wal->segment_count + 1,
+                                 sizeof(segment_t));
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  /* Take the most recently added spare, whose pages are likeliest cached. */
+  char* p_path = segment_path(p_wal, first_index);
+  char* p_spare_path = p_wal->spare_count
+      ? file_path(p_wal, p_wal->p_spares[p_wal->spare_count - 1], SPARE_SUFFIX)
+      : NULL;
+  if (p_path == NULL || (p_wal->spare_count && p_spare_path == NULL)) {
+    free(p_path);
+    free(p_spare_path);
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+
+  int fd = -1;
+  if (p_spare_path == NULL) {
+    fd = open(p_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0 && RAFT_FAILURE(preallocate(p_wal, fd))) {
+      close(fd);
+      unlink(p_path);
+      fd = -1;
+    }
+  } else if (rename(p_spare_path, p_path) == 0) {
+    --p_wal->spare_count;
+    fd = open(p_path, O_RDWR);
+  }
+  free(p_path);
+  free(p_spare_path);
+  if (fd < 0) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  uint8_t a_header[SEGMENT_HEADER_SIZE] = { 0 };
+  uint8_t* p_b = write_u32(a_header, SEGMENT_MAGIC);
+  p_b = write_u32(p_b, SEGMENT_VERSION);
+  write_u32(p_b, first_index);
+  if (pwrite(fd, a_header, sizeof(a_header), 0) != sizeof(a_header)) {
+    close(fd);
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  segment_t* p_segment = &p_wal->p_segments[p_wal->segment_count++];
+  memset(p_segment, 0, sizeof(*p_segment));
+  p_segment->first_index = first_index;
+  p_segment->size = SEGMENT_HEADER_SIZE;
+  p_segment->fd = fd;
+  p_segment->verified = RAFT_TRUE;
+  p_wal->dir_changed = RAFT_TRUE;
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * Maps a segment sealed by an earlier run and indexes it, from its footer
+ * if intact and by scanning its records otherwise. Does nothing if the
+ * segment is indexed already. Touches nothing shared between segments, so
+ * different segments may be indexed concurrently.
+ */
+static raft_status_t index_segment(raft_wal_t const* p_wal,
+                                   segment_t* p_segment) {
+  if (p_segment->p_map || p_segment->fd >= 0) {
+    return RAFT_STATUS_OK;
+  }
+
+  char* p_path = segment_path(p_wal, p_segment->first_index);
+  if (p_path == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  int const fd = open(p_path, O_RDONLY);
+  free(p_path);
+  struct stat st;
+  void* p_map = MAP_FAILED;
+  if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size) {
+    p_map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (p_map == MAP_FAILED) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  /* The entry count follows from the next segment's first index. */
+  uint32_t const num_entries = p_segment->num_entries;
+  raft_status_t status = read_footer(p_segment, p_map, st.st_size);
+  if (status == RAFT_STATUS_INVALID_MESSAGE) {
+    p_segment->num_entries = 0;
+    status = scan_segment(p_segment, p_map, st.st_size);
+    p_segment->verified = RAFT_SUCCESS(status);
+  }
+  if (RAFT_SUCCESS(status) && p_segment->num_entries != num_entries) {
+    status = RAFT_STATUS_INVALID_MESSAGE;
+  }
+  if (RAFT_FAILURE(status)) {
+    munmap(p_map, st.st_size);
+    p_segment->num_entries = num_entries;
+    p_segment->verified = RAFT_FALSE;
+    return status == RAFT_STATUS_INVALID_MESSAGE ? RAFT_STATUS_IO_ERROR
+                                                 : status;
+  }
+
+  madvise(p_map, st.st_size, MADV_SEQUENTIAL);
+  p_segment->p_map = p_map;
+  p_segment->map_size = st.st_size;
+  return RAFT_STATUS_OK;
+}
+
+static raft_status_t clear_footer_offset(int fd) {
+  uint8_t const a_zeros[4] = { 0 };
+  return pwrite(fd, a_zeros, sizeof(a_zeros), FOOTER_OFFSET_POS) ==
+                 sizeof(a_zeros)
+             ? RAFT_STATUS_OK
+             : RAFT_STATUS_IO_ERROR;
+}
+
+/**
+ * Makes a sealed segment writable again as the last one, dropping its
+ * footer.
+ */
+static raft_status_t reopen_segment(raft_wal_t* p_wal, segment_t* p_segment) {
+  raft_status_t status = index_segment(p_wal, p_segment);
+  if (RAFT_FAILURE(status) || p_segment->fd >= 0) {
+    return status;
+  }
+
+  char* p_path = segment_path(p_wal, p_segment->first_index);
+  if (p_path == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  int const fd = open(p_path, O_RDWR);
+  free(p_path);
+  if (fd < 0) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  uint32_t const footer_size =
+      p_segment->num_entries * FOOTER_ENTRY_SIZE + FOOTER_TRAILER_SIZE;
+  status = clear_footer_offset(fd);
+  if (RAFT_SUCCESS(status)) {
+    status = zero_fill(fd, p_segment->size, p_segment->size + footer_size);
+  }
+  if (RAFT_FAILURE(status)) {
+    close(fd);
+    return status;
+  }
+
+  munmap(p_segment->p_map, p_segment->map_size);
+  p_segment->p_map = NULL;
+  p_segment->map_size = 0;
+  p_segment->fd = fd;
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * Adds a sealed segment of num_entries entries, to be indexed when first
+ * read.
+ */
+static raft_status_t add_segment(raft_wal_t* p_wal,
+                                 raft_index_t first_index,
+                                 uint32_t num_entries) {
+  raft_status_t const status = reserve((void**)&p_wal->p_segments,
+                                       &p_wal->segment_capacity,
+                                       p_wal->segment_count + 1,
+                                       sizeof(segment_t));
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  segment_t* p_segment = &p_wal->p_segments[p_wal->segment_count++];
+  memset(p_segment, 0, sizeof(*p_segment));
+  p_segment->first_index = first_index;
+  p_segment->num_entries = num_entries;
+  p_segment->fd = -1;
+  return RAFT_STATUS_OK;
+}
+
+/**
+ * Loads the last segment, starting at first_index, scanning all of its
+ * records.
+ */
+static raft_status_t load_last_segment(raft_wal_t* p_wal,
+                                       raft_index_t first_index) {
+  raft_status_t status = reserve((void**)&p_wal->p_segments,
+                                 &p_wal->segment_capacity,
+                                 p_wal->segment_count + 1,
+                                 sizeof(segment_t));
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  char* p_path = segment_path(p_wal, first_index);
+  if (p_path == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  int const fd = open(p_path, O_RDWR);
+  free(p_path);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  segment_t* p_segment = &p_wal->p_segments[p_wal->segment_count];
+  memset(p_segment, 0, sizeof(*p_segment));
+  p_segment->first_index = first_index;
+  p_segment->fd = fd;
+
+  void* p_map = st.st_size ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED,
+                                  fd, 0)
+                           : NULL;
+  if (p_map == MAP_FAILED) {
+    release_segment(p_segment);
+    return RAFT_STATUS_IO_ERROR;
+  }
+  status = scan_segment(p_segment, p_map, st.st_size);
+  if (p_map) {
+    munmap(p_map, st.st_size);
+  }
+
+  if (status == RAFT_STATUS_INVALID_MESSAGE) {
+    /* Torn while being created. Writing resumes in the sealed segment
+     * before it, if any. */
+    status = remove_segment(p_wal, p_segment, RAFT_FALSE);
+    if (RAFT_SUCCESS(status) && p_wal->segment_count) {
+      status = reopen_segment(p_wal,
+                              &p_wal->p_segments[p_wal->segment_count - 1]);
+    }
+    return status;
+  }
+  if (RAFT_FAILURE(status)) {
+    release_segment(p_segment);
+    return status;
+  }
+
+  /* Writing resumes after the last intact record. Anything past it was
+   * never synced, and is cleared so that no stale record lines up with a
+   * new one; that includes a footer if the segment was sealed. */
+  ++p_wal->segment_count;
+  p_segment->verified = RAFT_TRUE;
+  status = clear_footer_offset(fd);
+  if (RAFT_SUCCESS(status)) {
+    status = zero_fill(fd, p_segment->size, st.st_size);
+  }
+  return status;
+}
+
+static int compare_indexes(void const* p_first, void const* p_second) {
+  raft_index_t const first = *(raft_index_t const*)p_first;
+  raft_index_t const second = *(raft_index_t const*)p_second;
+  return (first > second) - (first < second);
+}
+
+static raft_status_t load_segments(raft_wal_t* p_wal) {
+  DIR* p_dir = opendir(p_wal->p_dir);
+  if (p_dir == NULL) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  raft_index_t* p_first_indexes = NULL;
+  uint32_t count = 0, capacity = 0;
+  raft_status_t status = RAFT_STATUS_OK;
+  for (struct dirent* p_dirent = readdir(p_dir);
+       p_dirent && RAFT_SUCCESS(status);
+       p_dirent = readdir(p_dir)) {
+    raft_index_t first_index;
+    int length = 0;
+    if (sscanf(p_dirent->d_name, "%10u.%n", &first_index, &length) != 1 ||
+        length == 0) {
+      continue;
+    }
+    if (strcmp(p_dirent->d_name + length, SPARE_SUFFIX) == 0) {
+      /* Spares left by an earlier run, possibly not wholly zero-filled;
+       * their blocks still read as zeros. */
+      status = reserve((void**)&p_wal->p_spares, &p_wal->spare_capacity,
+                       p_wal->spare_count + 1, sizeof(uint32_t));
+      if (RAFT_SUCCESS(status)) {
+        p_wal->p_spares[p_wal->spare_count++] = first_index;
+        p_wal->next_spare_id = MAX(p_wal->next_spare_id, first_index + 1);
+      }
+      continue;
+    }
+    if (strcmp(p_dirent->d_name + length, SEGMENT_SUFFIX) != 0) {
+      continue;
+    }
+
+    status = reserve((void**)&p_first_indexes, &capacity, count + 1,
+                     sizeof(raft_index_t));
+    if (RAFT_SUCCESS(status)) {
+      p_first_indexes[count++] = first_index;
+    }
+  }
+  closedir(p_dir);
+
+  if (count) {
+    qsort(p_first_indexes, count, sizeof(raft_index_t), compare_indexes);
+  }
+  /* Only the last segment is read now; sealed ones are indexed on demand,
+   * so opening takes time in proportion to the last segment only. */
+  for (uint32_t ii = 0; ii + 1 < count && RAFT_SUCCESS(status); ++ii) {
+    status = add_segment(p_wal, p_first_indexes[ii],
+                         p_first_indexes[ii + 1] - p_first_indexes[ii]);
+  }
+  if (count && RAFT_SUCCESS(status)) {
+    status = load_last_segment(p_wal, p_first_indexes[count - 1]);
+  }
+
+  free(p_first_indexes);
+  return status;
+}
+
+/**
+ * Indexes a sealed segment and checks the CRC of each of its records.
+ */
+static raft_status_t verify_segment(raft_wal_t const* p_wal,
+                                    segment_t* p_segment) {
+  raft_status_t status = index_segment(p_wal, p_segment);
+  for (uint32_t ii = 0;
+       ii < p_segment->num_entries && RAFT_SUCCESS(status) &&
+           !p_segment->verified;
+       ++ii) {
+    uint32_t const offset = p_segment->p_offsets[ii];
+    if (check_record(p_segment->p_map + offset, p_segment->size - offset,
+                     p_segment->first_index + ii) == 0) {
+      status = RAFT_STATUS_IO_ERROR;
+    }
+  }
+  if (RAFT_SUCCESS(status)) {
+    p_segment->verified = RAFT_TRUE;
+  }
+  return status;
+}
+
+typedef struct {
+  raft_wal_t*   p_wal;
+  uint32_t      first;
+  uint32_t      step;
+  raft_status_t status;
+  pthread_t     thread;
+  raft_bool_t   started;
+} verify_job_t;
+
+/**
+ * Verifies every step-th sealed segment from first.
+ */
+static void* verify_segments(void* p_arg) {
+  verify_job_t* p_job = p_arg;
+  raft_wal_t* p_wal = p_job->p_wal;
+  for (uint32_t ii = p_job->first;
+       ii + 1 < p_wal->segment_count && RAFT_SUCCESS(p_job->status);
+       ii += p_job->step) {
+    p_job->status = verify_segment(p_wal, &p_wal->p_segments[ii]);
+  }
+  return NULL;
+}
+
+/**
+ * Verifies the sealed segments across raft_wal_config_t.verify_threads
+ * threads, the calling one included.
+ */
+static raft_status_t verify_sealed(raft_wal_t* p_wal) {
+  uint32_t const count =
+      MIN(p_wal->config.verify_threads, p_wal->segment_count - 1);
+  if (p_wal->segment_count < 2 || count == 0) {
+    return RAFT_STATUS_OK;
+  }
+
+  verify_job_t* p_jobs = calloc(count, sizeof(*p_jobs));
+  if (p_jobs == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  for (uint32_t ii = 0; ii < count; ++ii) {
+    p_jobs[ii].p_wal = p_wal;
+    p_jobs[ii].first = ii;
+    p_jobs[ii].step = count;
+    p_jobs[ii].started = ii > 0 && pthread_create(&p_jobs[ii].thread, NULL,
+                                                  verify_segments,
+                                                  &p_jobs[ii]) == 0;
+  }
+
+  raft_status_t status = RAFT_STATUS_OK;
+  for (uint32_t ii = 0; ii < count; ++ii) {
+    if (p_jobs[ii].started) {
+      pthread_join(p_jobs[ii].thread, NULL);
+    } else {
+      verify_segments(&p_jobs[ii]);
+    }
+    if (RAFT_SUCCESS(status)) {
+      status = p_jobs[ii].status;
+    }
+  }
+  free(p_jobs);
+  return status;
+}
+
+raft_status_t raft_wal_open(char const* p_dir,
+                            raft_wal_config_t const* p_config,
+                            raft_wal_t** pp_wal) {
+  *pp_wal = NULL;
+
+  raft_wal_t* p_wal = calloc(1, sizeof(*p_wal));
+  if (p_wal == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  p_wal->config = *p_config;
+  p_wal->p_dir = malloc(strlen(p_dir) + 1);
+  if (p_wal->p_dir == NULL) {
+    free(p_wal);
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  strcpy(p_wal->p_dir, p_dir);
+
+  raft_status_t status = load_segments(p_wal);
+  if (RAFT_SUCCESS(status)) {
+    status = verify_sealed(p_wal);
+  }
+  if (RAFT_SUCCESS(status)) {
+    status = fill_spares(p_wal);
+  }
+  if (RAFT_SUCCESS(status) && p_config->io_depth) {
+    /* Without io_uring, writes fall back to pwrite() and fdatasync(). */
+    status = raft_wal_uring_alloc(p_config->io_depth,
+                                  p_config->io_buffer_size,
+                                  &p_wal->p_uring);
+    if (status == RAFT_STATUS_INVALID_ARGS) {
+      status = RAFT_STATUS_OK;
+    }
+  }
+  if (RAFT_FAILURE(status)) {
+    raft_wal_close(p_wal);
+    return status;
+  }
+
+  /* Whatever survived on disk is as durable as it gets. */
+  p_wal->durable_index = raft_wal_end_index(p_wal);
+  *pp_wal = p_wal;
+  return RAFT_STATUS_OK;
+}
+
+void raft_wal_close(raft_wal_t* p_wal) {
+  if (p_wal == NULL) {
+    return;
+  }
+
+  settle(p_wal);
+  raft_wal_uring_free(p_wal->p_uring);
+  for (uint32_t ii = 0; ii < p_wal->segment_count; ++ii) {
+    release_segment(&p_wal->p_segments[ii]);
+  }
+  free(p_wal->p_segments);
+  free(p_wal->p_spares);
+  free(p_wal->p_write_buf);
+  free(p_wal->p_read_buf);
+  free(p_wal->p_dir);
+  free(p_wal);
+}
+
+raft_index_t raft_wal_first_index(raft_wal_t const* p_wal) {
+  if (p_wal->segment_count == 0) {
+    return 0;
+  }
+  return p_wal->p_segments[0].first_index;
+}
+
+raft_index_t raft_wal_end_index(raft_wal_t const* p_wal) {
+  if (p_wal->segment_count == 0) {
+    return 0;
+  }
+  segment_t const* p_last = &p_wal->p_segments[p_wal->segment_count - 1];
+  return p_last->first_index + p_last->num_entries;
+}
+
+/**
+ * The segment holding index, or NULL if none does.
+ */
+static segment_t* find_segment(raft_wal_t const* p_wal, raft_index_t index) {
+  uint32_t low = 0, high = p_wal->segment_count;
+  while (low < high) {
+    uint32_t const middle = low + (high - low) / 2;
+    segment_t* p_segment = &p_wal->p_segments[middle];
+    if (index < p_segment->first_index) {
+      high = middle;
+    } else if (index >= p_segment->first_index + p_segment->num_entries) {
+      low = middle + 1;
+    } else {
+      return p_segment;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Drops the entries at and after index, reopening the segment holding it
+ * for writing.
+ */
+static raft_status_t truncate_segments(raft_wal_t* p_wal, raft_index_t index) {
+  segment_t* p_segment = find_segment(p_wal, index);
+  RAFT_ASSERT(p_segment);
+
+  raft_status_t status = settle(p_wal);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+  p_wal->durable_index = MIN(p_wal->durable_index, index);
+  if (p_wal->p_uring) {
+    raft_wal_uring_truncated(p_wal->p_uring, index);
+  }
+
+  while (&p_wal->p_segments[p_wal->segment_count - 1] != p_segment) {
+    status = remove_segment(p_wal, &p_wal->p_segments[p_wal->segment_count - 1],
+                            RAFT_FALSE);
+    if (RAFT_FAILURE(status)) {
+      return status;
+    }
+    --p_wal->segment_count;
+  }
+
+  status = reopen_segment(p_wal, p_segment);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  /* The dropped records are cleared rather than cut off, keeping the file's
+   * blocks allocated while making sure none of them is read back. */
+  uint32_t const count = index - p_segment->first_index;
+  uint32_t const size = p_segment->size;
+  p_segment->size = p_segment->p_offsets[count];
+  p_segment->num_entries = count;
+  return zero_fill(p_segment->fd, p_segment->size, size);
+}
+
+static raft_status_t flush(raft_wal_t* p_wal, uint32_t* p_pending) {
+  segment_t* p_last = &p_wal->p_segments[p_wal->segment_count - 1];
+  raft_status_t status = RAFT_STATUS_OK;
+  if (p_wal->write_size == 0) {
+    return status;
+  }
+  if (p_wal->p_uring) {
+    status = raft_wal_uring_write(p_wal->p_uring, p_last->fd,
+                                  p_wal->p_write_buf, p_wal->write_size,
+                                  p_last->size);
+  } else if (pwrite(p_last->fd, p_wal->p_write_buf, p_wal->write_size,
+                    p_last->size) != p_wal->write_size) {
+    status = RAFT_STATUS_IO_ERROR;
+  }
+  if (RAFT_FAILURE(status)) {
+    p_wal->write_size = *p_pending = 0;
+    return status;
+  }
+
+  p_last->size += p_wal->write_size;
+  p_last->num_entries += *p_pending;
+  p_wal->write_size = *p_pending = 0;
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_wal_append(raft_wal_t* p_wal,
+                              raft_index_t first_index,
+                              raft_log_entry_t const* p_entries,
+                              uint32_t num_entries) {
+  if (num_entries == 0) {
+    return RAFT_STATUS_OK;
+  }
+
+  raft_status_t status = RAFT_STATUS_OK;
+  if (p_wal->segment_count) {
+    if (first_index < raft_wal_first_index(p_wal) ||
+        first_index > raft_wal_end_index(p_wal)) {
+      return RAFT_STATUS_INVALID_ARGS;
+    }
+    if (first_index < raft_wal_end_index(p_wal)) {
+      status = truncate_segments(p_wal, first_index);
+    }
+  }
+
+  uint32_t pending = 0;
+  for (uint32_t ii = 0; ii < num_entries && RAFT_SUCCESS(status); ++ii) {
+    segment_t* p_last = p_wal->segment_count
+        ? &p_wal->p_segments[p_wal->segment_count - 1]
+        : NULL;
+    if (p_last == NULL ||
+        (p_last->num_entries + pending > 0 &&
+         p_last->size + p_wal->write_size >= p_wal->config.segment_size)) {
+      if (p_last) {
+        status = flush(p_wal, &pending);
+        if (RAFT_SUCCESS(status)) {
+          status = seal_segment(p_wal, p_last);
+        }
+      }
+      if (RAFT_SUCCESS(status)) {
+        status = start_segment(p_wal, first_index + ii);
+        p_last = &p_wal->p_segments[p_wal->segment_count - 1];
+      }
+      if (RAFT_FAILURE(status)) {
+        break;
+      }
+    }
+
+    raft_log_entry_t const* p_entry = &p_entries[ii];
+    uint32_t const size =
+        record_size(p_entry->p_data ? p_entry->data_size : 0);
+    status = reserve((void**)&p_wal->p_write_buf, &p_wal->write_capacity,
+                     p_wal->write_size + size, 1);
+    if (RAFT_SUCCESS(status)) {
+      status = reserve_entries(p_last, p_last->num_entries + pending + 1);
+    }
+    if (RAFT_FAILURE(status)) {
+      break;
+    }
+
+    encode_record(p_wal->p_write_buf + p_wal->write_size,
+                  first_index + ii, p_entry);
+    p_last->p_terms[p_last->num_entries + pending] = p_entry->term;
+    p_last->p_offsets[p_last->num_entries + pending++] =
+        p_last->size + p_wal->write_size;
+    p_wal->write_size += size;
+  }
+
+  if (RAFT_SUCCESS(status)) {
+    return flush(p_wal, &pending);
+  }
+  p_wal->write_size = 0;
+  return status;
+}
+
+static raft_status_t sync_dir(raft_wal_t* p_wal) {
+  if (p_wal->dir_changed) {
+    int const fd = open(p_wal->p_dir, O_RDONLY);
+    if (fd < 0 || fsync(fd) != 0) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      return RAFT_STATUS_IO_ERROR;
+    }
+    close(fd);
+    p_wal->dir_changed = RAFT_FALSE;
+  }
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_wal_sync(raft_wal_t* p_wal) {
+  raft_status_t status = raft_wal_flush(p_wal);
+  if (RAFT_SUCCESS(status)) {
+    status = settle(p_wal);
+  }
+  return status;
+}
+
+raft_status_t raft_wal_flush(raft_wal_t* p_wal) {
+  raft_status_t const status = sync_dir(p_wal);
+  if (RAFT_FAILURE(status) || p_wal->segment_count == 0) {
+    return status;
+  }
+
+  int const fd = p_wal->p_segments[p_wal->segment_count - 1].fd;
+  raft_index_t const end_index = raft_wal_end_index(p_wal);
+  if (p_wal->p_uring) {
+    return raft_wal_uring_sync(p_wal->p_uring, fd, end_index);
+  }
+
+  if (fdatasync(fd) != 0) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+  p_wal->durable_index = MAX(p_wal->durable_index, end_index);
+  return RAFT_STATUS_OK;
+}
+
+raft_index_t raft_wal_durable_index(raft_wal_t* p_wal) {
+  if (p_wal->p_uring) {
+    raft_wal_uring_reap(p_wal->p_uring, RAFT_FALSE, &p_wal->durable_index);
+  }
+  return p_wal->durable_index;
+}
+
+raft_status_t raft_wal_entry(raft_wal_t* p_wal,
+                             raft_index_t index,
+                             raft_log_entry_t* p_entry) {
+  segment_t* p_segment = find_segment(p_wal, index);
+  if (p_segment == NULL) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+  raft_status_t status = index_segment(p_wal, p_segment);
+  if (RAFT_FAILURE(status)) {
+    return status;
+  }
+
+  uint32_t const position = index - p_segment->first_index;
+  uint32_t const offset = p_segment->p_offsets[position];
+  uint32_t const end = position + 1 < p_segment->num_entries
+      ? p_segment->p_offsets[position + 1]
+      : p_segment->size;
+  uint8_t const* p_record;
+  if (p_segment->p_map) {
+    p_record = p_segment->p_map + offset;
+  } else {
+    status = settle(p_wal);
+    if (RAFT_SUCCESS(status)) {
+      status = reserve((void**)&p_wal->p_read_buf, &p_wal->read_capacity,
+                       end - offset, 1);
+    }
+    if (RAFT_FAILURE(status)) {
+      return status;
+    }
+    if (pread(p_segment->fd, p_wal->p_read_buf, end - offset, offset) !=
+        end - offset) {
+      return RAFT_STATUS_IO_ERROR;
+    }
+    p_record = p_wal->p_read_buf;
+  }
+
+  /* Records of segments indexed from their footer are checked as read. */
+  if (!p_segment->verified && check_record(p_record, end - offset, index) == 0) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+  decode_record(p_record, p_entry);
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_wal_term(raft_wal_t* p_wal,
+                            raft_index_t index,
+                            raft_term_t* p_term) {
+  segment_t* p_segment = find_segment(p_wal, index);
+  if (p_segment == NULL) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+  raft_status_t const status = index_segment(p_wal, p_segment);
+  if (RAFT_SUCCESS(status)) {
+    *p_term = p_segment->p_terms[index - p_segment->first_index];
+  }
+  return status;
+}
+
+raft_status_t raft_wal_compact(raft_wal_t* p_wal, raft_index_t index) {
+  uint32_t count = 0;
+  raft_status_t status = RAFT_STATUS_OK;
+  while (count + 1 < p_wal->segment_count && RAFT_SUCCESS(status)) {
+    segment_t* p_segment = &p_wal->p_segments[count];
+    if (p_segment->first_index + p_segment->num_entries > index) {
+      break;
+    }
+    status = remove_segment(p_wal, p_segment, RAFT_TRUE);
+    if (RAFT_FAILURE(status)) {
+      break;
+    }
+    ++count;
+  }
+
+  p_wal->segment_count -= count;
+  memmove(p_wal->p_segments, p_wal->p_segments + count,
+          p_wal->segment_count * sizeof(segment_t));
+
+  /* Each spare costs a segment's worth of zero-filled, synced writes, so
+   * compaction adds at most one. */
+  if (RAFT_SUCCESS(status) &&
+      p_wal->spare_count < p_wal->config.spare_segments) {
+    status = create_spare(p_wal);
+  }
+  return status;
+}
@@ -0,0 +1,468 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+
+#include "raft_wal_uring.h"
+#include "raft_util.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* Syncs carry their slot in user_data, writes their buffer. */
+#define SYNC_USER_DATA (1ull << 63)
+
+#define BUFFER_ALIGN 4096
+
+/**
+ * A sync and the writes queued ahead of it. Chains from different flushes
+ * run concurrently, so a sync only counts once every earlier one has too.
+ */
+typedef struct {
+  raft_index_t end_index;
+  uint32_t     writes;
+  raft_bool_t  done;
+} pending_sync_t;
+
+struct raft_wal_uring {
+  int      ring_fd;
+  uint32_t entries;
+
+  void*                p_sq_ring;
+  size_t               sq_ring_size;
+  void*                p_cq_ring;
+  size_t               cq_ring_size;
+  struct io_uring_sqe* p_sqes;
+  size_t               sqes_size;
+
+  unsigned* p_sq_tail;
+  unsigned  sq_mask;
+  unsigned* p_sq_array;
+
+  unsigned*            p_cq_head;
+  unsigned*            p_cq_tail;
+  unsigned             cq_mask;
+  struct io_uring_cqe* p_cqes;
+
+  /* Entries queued since the last submission, and submitted but not yet
+   * completed. */
+  uint32_t queued;
+  uint32_t in_flight;
+
+  uint8_t*  p_buffers;
+  uint32_t  buffer_size;
+  uint32_t  buffer_count;
+  uint32_t* p_lengths;
+  /* Slot of the sync each buffer's write is queued ahead of. */
+  uint32_t* p_owners;
+  uint32_t* p_free_buffers;
+  uint32_t  free_count;
+
+  /* Syncs by serial, each in slot serial % (entries + 1). Those from
+   * sync_head on have not been counted yet, and sync_tail collects the
+   * writes of the next one. */
+  pending_sync_t* p_syncs;
+  uint64_t        sync_head;
+  uint64_t        sync_tail;
+
+  /* End index of the latest sync completed along with everything before
+   * it. */
+  raft_index_t synced_index;
+  raft_bool_t  failed;
+};
+
+static void unmap_rings(raft_wal_uring_t* p_uring) {
+  if (p_uring->p_sqes) {
+    munmap(p_uring->p_sqes, p_uring->sqes_size);
+  }
+  if (p_uring->p_cq_ring && p_uring->p_cq_ring != p_uring->p_sq_ring) {
+    munmap(p_uring->p_cq_ring, p_uring->cq_ring_size);
+  }
+  if (p_uring->p_sq_ring) {
+    munmap(p_uring->p_sq_ring, p_uring->sq_ring_size);
+  }
+}
+
+static raft_status_t map_rings(raft_wal_uring_t* p_uring,
+                               struct io_uring_params const* p_params) {
+  int const fd = p_uring->ring_fd;
+  p_uring->sq_ring_size = (p_params->sq_off.array +
+                           p_params->sq_entries * sizeof(unsigned));
+  p_uring->cq_ring_size = (p_params->cq_off.cqes +
+                           p_params->cq_entries * sizeof(struct io_uring_cqe));
+  raft_bool_t const single = p_params->features & IORING_FEAT_SINGLE_MMAP;
+  if (single) {
+    p_uring->sq_ring_size = p_uring->cq_ring_size =
+        MAX(p_uring->sq_ring_size, p_uring->cq_ring_size);
+  }
+
+  void* p_ring = mmap(NULL, p_uring->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, IORING_OFF_SQ_RING);
+  if (p_ring == MAP_FAILED) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+  p_uring->p_sq_ring = p_ring;
+
+  if (single) {
+    p_uring->p_cq_ring = p_ring;
+  } else {
+    p_ring = mmap(NULL, p_uring->cq_ring_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED, fd, IORING_OFF_CQ_RING);
+    if (p_ring == MAP_FAILED) {
+      return RAFT_STATUS_INVALID_ARGS;
+    }
+    p_uring->p_cq_ring = p_ring;
+  }
+
+  p_uring->sqes_size = p_params->sq_entries * sizeof(struct io_uring_sqe);
+  void* p_sqes = mmap(NULL, p_uring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, IORING_OFF_SQES);
+  if (p_sqes == MAP_FAILED) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+  p_uring->p_sqes = p_sqes;
+
+  uint8_t* p_sq = p_uring->p_sq_ring;
+  p_uring->p_sq_tail = (unsigned*)(p_sq + p_params->sq_off.tail);
+  p_uring->sq_mask = *(unsigned*)(p_sq + p_params->sq_off.ring_mask);
+  p_uring->p_sq_array = (unsigned*)(p_sq + p_params->sq_off.array);
+
+  uint8_t* p_cq = p_uring->p_cq_ring;
+  p_uring->p_cq_head = (unsigned*)(p_cq + p_params->cq_off.head);
+  p_uring->p_cq_tail = (unsigned*)(p_cq + p_params->cq_off.tail);
+  p_uring->cq_mask = *(unsigned*)(p_cq + p_params->cq_off.ring_mask);
+  p_uring->p_cqes = (struct io_uring_cqe*)(p_cq + p_params->cq_off.cqes);
+
+  p_uring->entries = p_params->sq_entries;
+  return RAFT_STATUS_OK;
+}
+
+static raft_status_t register_buffers(raft_wal_uring_t* p_uring,
+                                      uint32_t count,
+                                      uint32_t size) {
+  size = RAFT_ALIGN_UP(size, BUFFER_ALIGN);
+  void* p_buffers = NULL;
+  if (posix_memalign(&p_buffers, BUFFER_ALIGN, (size_t)count * size) != 0) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+  p_uring->p_buffers = p_buffers;
+  p_uring->buffer_size = size;
+  p_uring->buffer_count = count;
+
+  p_uring->p_lengths = calloc(count, sizeof(uint32_t));
+  p_uring->p_owners = calloc(count, sizeof(uint32_t));
+  p_uring->p_free_buffers = calloc(count, sizeof(uint32_t));
+  struct iovec* p_iovecs = calloc(count, sizeof(struct iovec));
+  if (p_uring->p_lengths == NULL ||
+      p_uring->p_owners == NULL ||
+      p_uring->p_free_buffers == NULL ||
+      p_iovecs == NULL) {
+    free(p_iovecs);
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+
+  for (uint32_t ii = 0; ii < count; ++ii) {
+    p_iovecs[ii].iov_base = p_uring->p_buffers + (size_t)ii * size;
+    p_iovecs[ii].iov_len = size;
+    p_uring->p_free_buffers[p_uring->free_count++] = count - 1 - ii;
+  }
+
+  int const result = syscall(__NR_io_uring_register, p_uring->ring_fd,
+                             IORING_REGISTER_BUFFERS, p_iovecs, count);
+  free(p_iovecs);
+  return result < 0 ? RAFT_STATUS_INVALID_ARGS : RAFT_STATUS_OK;
+}
+
+raft_status_t raft_wal_uring_alloc(uint32_t depth,
+                                   uint32_t buffer_size,
+                                   raft_wal_uring_t** pp_uring) {
+  *pp_uring = NULL;
+  if (depth == 0 || buffer_size == 0) {
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  raft_wal_uring_t* p_uring = calloc(1, sizeof(*p_uring));
+  if (p_uring == NULL) {
+    return RAFT_STATUS_OUT_OF_MEMORY;
+  }
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  p_uring->ring_fd = syscall(__NR_io_uring_setup, depth, &params);
+  if (p_uring->ring_fd < 0) {
+    free(p_uring);
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+
+  raft_status_t status = map_rings(p_uring, &params);
+  if (RAFT_SUCCESS(status)) {
+    p_uring->p_syncs = calloc(p_uring->entries + 1, sizeof(pending_sync_t));
+    if (p_uring->p_syncs == NULL) {
+      status = RAFT_STATUS_OUT_OF_MEMORY;
+    }
+  }
+  if (RAFT_SUCCESS(status)) {
+    status = register_buffers(p_uring, depth, buffer_size);
+  }
+  if (RAFT_FAILURE(status)) {
+    raft_wal_uring_free(p_uring);
+    return status;
+  }
+
+  *pp_uring = p_uring;
+  return RAFT_STATUS_OK;
+}
+
+void raft_wal_uring_free(raft_wal_uring_t* p_uring) {
+  if (p_uring == NULL) {
+    return;
+  }
+
+  RAFT_ASSERT(p_uring->in_flight == 0);
+  unmap_rings(p_uring);
+  close(p_uring->ring_fd);
+  free(p_uring->p_buffers);
+  free(p_uring->p_lengths);
+  free(p_uring->p_owners);
+  free(p_uring->p_free_buffers);
+  free(p_uring->p_syncs);
+  free(p_uring);
+}
+
+static uint32_t sync_slot(raft_wal_uring_t const* p_uring, uint64_t serial) {
+  return serial % (p_uring->entries + 1);
+}
+
+static void process_completions(raft_wal_uring_t* p_uring) {
+  unsigned head = *p_uring->p_cq_head;
+  unsigned const tail = __atomic_load_n(p_uring->p_cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head) {
+    struct io_uring_cqe const* p_cqe = &p_uring->p_cqes[head & p_uring->cq_mask];
+    if (p_cqe->user_data & SYNC_USER_DATA) {
+      if (p_cqe->res < 0) {
+        p_uring->failed = RAFT_TRUE;
+      }
+      p_uring->p_syncs[(uint32_t)p_cqe->user_data].done = RAFT_TRUE;
+    } else {
+      uint32_t const buffer = p_cqe->user_data;
+      if (p_cqe->res < 0 || (uint32_t)p_cqe->res != p_uring->p_lengths[buffer]) {
+        p_uring->failed = RAFT_TRUE;
+      }
+      --p_uring->p_syncs[p_uring->p_owners[buffer]].writes;
+      p_uring->p_free_buffers[p_uring->free_count++] = buffer;
+    }
+    --p_uring->in_flight;
+  }
+  __atomic_store_n(p_uring->p_cq_head, head, __ATOMIC_RELEASE);
+
+  /* Count syncs in submission order, each once it and every write and sync
+   * before it have completed. */
+  while (!p_uring->failed && p_uring->sync_head != p_uring->sync_tail) {
+    pending_sync_t const* p_sync =
+        &p_uring->p_syncs[sync_slot(p_uring, p_uring->sync_head)];
+    if (!p_sync->done || p_sync->writes > 0) {
+      break;
+    }
+    p_uring->synced_index = MAX(p_uring->synced_index, p_sync->end_index);
+    ++p_uring->sync_head;
+  }
+}
+
+/**
+ * Submits the queued entries and waits for min_complete completions.
+ */
+static raft_status_t enter(raft_wal_uring_t* p_uring,
+                           uint32_t min_complete) {
+  for (;;) {
+    int const submitted = syscall(__NR_io_uring_enter, p_uring->ring_fd,
+                                  p_uring->queued, min_complete,
+                                  IORING_ENTER_GETEVENTS, NULL, 0);
+    if (submitted < 0 && errno == EINTR) {
+      continue;
+    }
+    if (submitted < 0) {
+      p_uring->failed = RAFT_TRUE;
+      return RAFT_STATUS_IO_ERROR;
+    }
+
+    p_uring->queued -= submitted;
+    p_uring->in_flight += submitted;
+    break;
+  }
+
+  process_completions(p_uring);
+  return p_uring->failed ? RAFT_STATUS_IO_ERROR : RAFT_STATUS_OK;
+}
+
+/**
+ * Submits everything queued and waits for all of it, so that writes that
+ * cannot be linked to the next sync are complete before it is queued.
+ */
+static raft_status_t drain(raft_wal_uring_t* p_uring) {
+  raft_status_t status = RAFT_STATUS_OK;
+  while (RAFT_SUCCESS(status) && p_uring->queued + p_uring->in_flight > 0) {
+    status = enter(p_uring, 1);
+  }
+  return status;
+}
+
+static struct io_uring_sqe* next_sqe(raft_wal_uring_t* p_uring) {
+  if (p_uring->queued + p_uring->in_flight >= p_uring->entries &&
+      RAFT_FAILURE(drain(p_uring))) {
+    return NULL;
+  }
+
+  unsigned const index = *p_uring->p_sq_tail & p_uring->sq_mask;
+  struct io_uring_sqe* p_sqe = &p_uring->p_sqes[index];
+  memset(p_sqe, 0, sizeof(*p_sqe));
+  p_uring->p_sq_array[index] = index;
+  return p_sqe;
+}
+
+static void queue_sqe(raft_wal_uring_t* p_uring) {
+  __atomic_store_n(p_uring->p_sq_tail, *p_uring->p_sq_tail + 1,
+                   __ATOMIC_RELEASE);
+  ++p_uring->queued;
+}
+
+raft_status_t raft_wal_uring_write(raft_wal_uring_t* p_uring,
+                                   int fd,
+                                   void const* p_bytes,
+                                   uint32_t size,
+                                   uint64_t offset) {
+  uint8_t const* p_b = p_bytes;
+  while (size > 0) {
+    if (p_uring->free_count == 0 && RAFT_FAILURE(drain(p_uring))) {
+      return RAFT_STATUS_IO_ERROR;
+    }
+
+    struct io_uring_sqe* p_sqe = next_sqe(p_uring);
+    if (p_sqe == NULL) {
+      return RAFT_STATUS_IO_ERROR;
+    }
+
+    uint32_t const buffer = p_uring->p_free_buffers[--p_uring->free_count];
+    uint32_t const length = MIN(size, p_uring->buffer_size);
+    uint8_t* p_buffer = p_uring->p_buffers + (size_t)buffer * p_uring->buffer_size;
+    memcpy(p_buffer, p_b, length);
+    p_uring->p_lengths[buffer] = length;
+    p_uring->p_owners[buffer] = sync_slot(p_uring, p_uring->sync_tail);
+    ++p_uring->p_syncs[p_uring->p_owners[buffer]].writes;
+
+    p_sqe->opcode = IORING_OP_WRITE_FIXED;
+    p_sqe->flags = IOSQE_IO_LINK;
+    p_sqe->fd = fd;
+    p_sqe->addr = (uint64_t)(uintptr_t)p_buffer;
+    p_sqe->len = length;
+    p_sqe->off = offset;
+    p_sqe->buf_index = buffer;
+    p_sqe->user_data = buffer;
+    queue_sqe(p_uring);
+
+    p_b += length;
+    offset += length;
+    size -= length;
+  }
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_wal_uring_sync(raft_wal_uring_t* p_uring,
+                                  int fd,
+                                  raft_index_t end_index) {
+  /* Syncs that completed ahead of an earlier one still hold their slot. */
+  if (p_uring->sync_tail - p_uring->sync_head == p_uring->entries &&
+      RAFT_FAILURE(drain(p_uring))) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  struct io_uring_sqe* p_sqe = next_sqe(p_uring);
+  if (p_sqe == NULL) {
+    return RAFT_STATUS_IO_ERROR;
+  }
+
+  uint32_t const slot = sync_slot(p_uring, p_uring->sync_tail);
+  pending_sync_t* p_sync = &p_uring->p_syncs[slot];
+  p_sync->end_index = end_index;
+  p_sync->done = RAFT_FALSE;
+
+  p_sqe->opcode = IORING_OP_FSYNC;
+  p_sqe->fd = fd;
+  p_sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+  p_sqe->user_data = SYNC_USER_DATA | slot;
+  queue_sqe(p_uring);
+
+  /* Later writes are counted against the next sync. */
+  p_sync = &p_uring->p_syncs[sync_slot(p_uring, ++p_uring->sync_tail)];
+  p_sync->writes = 0;
+  p_sync->done = RAFT_FALSE;
+  return enter(p_uring, 0);
+}
+
+raft_status_t raft_wal_uring_reap(raft_wal_uring_t* p_uring,
+                                  raft_bool_t wait_all,
+                                  raft_index_t* p_durable_index) {
+  /* Without waiting, writes still queued are left for the sync they will
+   * be linked to. */
+  if (wait_all) {
+    drain(p_uring);
+  } else {
+    syscall(__NR_io_uring_enter, p_uring->ring_fd, 0, 0,
+            IORING_ENTER_GETEVENTS, NULL, 0);
+    process_completions(p_uring);
+  }
+
+  *p_durable_index = MAX(*p_durable_index, p_uring->synced_index);
+  return p_uring->failed ? RAFT_STATUS_IO_ERROR : RAFT_STATUS_OK;
+}
+
+void raft_wal_uring_truncated(raft_wal_uring_t* p_uring, raft_index_t index) {
+  p_uring->synced_index = MIN(p_uring->synced_index, index);
+}
+
+#else
+
+raft_status_t raft_wal_uring_alloc(uint32_t depth,
+                                   uint32_t buffer_size,
+                                   raft_wal_uring_t** pp_uring) {
+  *pp_uring = NULL;
+  return RAFT_STATUS_INVALID_ARGS;
+}
+
+void raft_wal_uring_free(raft_wal_uring_t* p_uring) {
+}
+
+raft_status_t raft_wal_uring_write(raft_wal_uring_t* p_uring,
+                                   int fd,
+                                   void const* p_bytes,
+                                   uint32_t size,
+                                   uint64_t offset) {
+  return RAFT_STATUS_INVALID_ARGS;
+}
+
+raft_status_t raft_wal_uring_sync(raft_wal_uring_t* p_uring,
+                                  int fd,
+                                  raft_index_t end_index) {
+  return RAFT_STATUS_INVALID_ARGS;
+}
+
+raft_status_t raft_wal_uring_reap(raft_wal_uring_t* p_uring,
+                                  raft_bool_t wait_all,
+                                  raft_index_t* p_durable_index) {
+  return RAFT_STATUS_INVALID_ARGS;
+}
+
+void raft_wal_uring_truncated(raft_wal_uring_t* p_uring, raft_index_t index) {
+}
+
+#endif
@@ -24,9 +24,12 @@ void raft_dealloc_envelope(raft_envelope_t* p_envelope) {
  * ========================================
  *       | Entry 0 Metadata               -|
  * - - - - - - - - - - - - - - - - - - - - | Log entry metadata
- *       | Entry 1 Metadata                | 8-byte entries
- * - - - - - - - - - - - - - - - - - - - - | (entry type, size,
- *         ...                             |  and unique id)
+ *       | Entry 1 Metadata                | 12-byte entries
+ * - - - - - - - - - - - - - - - - - - - - | (entry type, data
+ *         ...                             |  omitted and coded
+ *                                         |  flags, size, unique
+ *                                         |  id and term), and 8
+ *                                         |  more for coded ones
  * - - - - - - - - - - - - - - - - - - - - |
  *       | Entry n Metadata                |
  * ========================================|
@@ -38,6 +41,8 @@ void raft_dealloc_envelope(raft_envelope_t* p_envelope) {
  * - - - - - - - - - - - - - - - - - - - - |
  *       | Entry n data                    |
  *       |     ...                        -|
+ * ========================================
+ *       | Relay node ids                 -| AppendEntries relays
  * =============================================================================
  */
 
@@ -67,10 +72,18 @@ static uint8_t const* read(uint32_t* p_v, uint8_t const* p_b) {
 
 static uint32_t a_message_sizes[] = {
   0, /* UNKNOWN */
-  32, /* MSG_TYPE_APPEND_ENTRIES */
-  28, /* MSG_TYPE_APPEND_ENTRIES_RESPONSE */
-  24, /* MSG_TYPE_REQUEST_VOTE */
+  44, /* MSG_TYPE_APPEND_ENTRIES */
+  32, /* MSG_TYPE_APPEND_ENTRIES_RESPONSE */
+  28, /* MSG_TYPE_REQUEST_VOTE */
   20, /* MSG_TYPE_REQUEST_VOTE_RESPONSE */
+  20, /* MSG_TYPE_READ_INDEX */
+  24, /* MSG_TYPE_READ_INDEX_RESPONSE */
+  28, /* MSG_TYPE_PRE_VOTE */
+  20, /* MSG_TYPE_PRE_VOTE_RESPONSE */
+  16, /* MSG_TYPE_TIMEOUT_NOW */
+  28, /* MSG_TYPE_HEARTBEAT */
+  20, /* MSG_TYPE_FRAGMENT */
+  32, /* MSG_TYPE_FRAGMENT_RESPONSE */
 };
 
 #define MESSAGE_SIZE(_type) a_message_sizes[(_type)]
@@ -79,17 +92,19 @@ static uint32_t a_message_sizes[] = {
 #define WM_SETUP(_type, _dynamic_data_size)                             \
   uint8_t* p_buf = p_env->p_message;                                    \
   do {                                                                  \
+    uint32_t const _message_size =                                      \
+        MESSAGE_SIZE(_type) + (_dynamic_data_size);                     \
     p_env->recipient_id = recipient_id;                                 \
     if (p_buf == NULL ||                                                \
-        p_env->buffer_capacity < MESSAGE_SIZE(_type)) {                 \
-      uint32_t capacity = RAFT_ALIGN_UP(MESSAGE_SIZE(_type),            \
+        p_env->buffer_capacity < _message_size) {                       \
+      uint32_t capacity = RAFT_ALIGN_UP(_message_size,                  \
                                         MESSAGE_BUFFER_SIZE_ALIGN);     \
       p_env->p_message = p_buf = realloc(p_buf, capacity);              \
       if (p_buf == NULL)                                                \
         return RAFT_STATUS_OUT_OF_MEMORY;                               \
       p_env->buffer_capacity = capacity;                                \
     }                                                                   \
-    p_env->message_size = MESSAGE_SIZE(_type) + (_dynamic_data_size);   \
+    p_env->message_size = _message_size;                                \
     (*p_buf++) = RAFT_MSG_VERSION_BYTE(2);                              \
     (*p_buf++) = RAFT_MSG_VERSION_BYTE(1);                              \
     (*p_buf++) = RAFT_MSG_VERSION_BYTE(0);                              \
@@ -168,6 +183,7 @@ static uint32_t a_message_sizes[] = {
     RAFT_ASSERT(message_size >= (_size));                               \
     memcpy((_p_bytes), p_buf, (_size));                                 \
     p_buf = p_buf + (_size);                                            \
+    message_size -= (_size);                                            \
   } while (0)
 
 
@@ -175,14 +191,33 @@ static uint32_t a_message_sizes[] = {
  *******************************************************************************
  ******************************************************************************/
 
-static uint32_t raft_log_message_byte_count(raft_log_entry_t const* p_entries,
-                                            uint32_t num_entries) {
+#define ENTRY_TYPE_SHIFT    31
+#define ENTRY_OMITTED_SHIFT 30
+#define ENTRY_CODED_SHIFT   29
+#define ENTRY_SIZE_MASK     0x1fffffff
+
+/**
+ * Whether an entry's data is left out of the message. Configuration
+ * entries are always sent whole.
+ */
+static raft_bool_t data_omitted(raft_append_entries_args_t const* p_args,
+                                raft_log_entry_t const* p_entry) {
+  return (p_args->metadata_only &&
+          p_entry->type == RAFT_LOG_ENTRY_TYPE_USER);
+}
+
+static uint32_t raft_log_message_byte_count(
+    raft_append_entries_args_t const* p_args) {
+  raft_log_entry_t const* p_entries = p_args->p_log_entries;
   if (p_entries == NULL)
     return 0;
 
   uint32_t result = 0;
-  for (uint32_t ii = 0; ii < num_entries; ++ii) {
-    result += 12 + p_entries[ii].data_size;
+  for (uint32_t ii = 0; ii < p_args->num_entries; ++ii) {
+    result += p_entries[ii].fragments_needed ? 20 : 12;
+    if (!data_omitted(p_args, &p_entries[ii])) {
+      result += p_entries[ii].data_size;
+    }
   }
   return result;
 }
@@ -194,29 +229,48 @@ raft_status_t raft_write_append_entries_envelope(
   raft_log_entry_t const* p_entries = p_args->p_log_entries;
   uint32_t const num_entries = p_args->num_entries;
 
-  WM_SETUP(MSG_TYPE_APPEND_ENTRIES, raft_log_message_byte_count(p_entries,
-                                                                num_entries));
+  WM_SETUP(MSG_TYPE_APPEND_ENTRIES,
+           (raft_log_message_byte_count(p_args) +
+            p_args->num_relay_ids * sizeof(raft_nodeid_t)));
   WM(term);
   WM(leader_id);
   WM(prev_log_index);
   WM(prev_log_term);
   WM_IMMU32(num_entries);
   WM(leader_commit);
+  WM(seq);
+  WM(election_timeout_hint_ms);
+  WM(num_relay_ids);
 
   // TODO: Defer to the client about how to marshall the log entry data.
   //       For now, just copy the bytes directly.
   for (uint32_t ii = 0; ii < num_entries; ++ii) {
     raft_log_entry_t const* p_entry = &p_entries[ii];
     uint32_t size_and_type = p_entry->data_size;
-    size_and_type |= p_entry->type << 31;
+    size_and_type |= (uint32_t)p_entry->type << ENTRY_TYPE_SHIFT;
+    size_and_type |= ((uint32_t)data_omitted(p_args, p_entry) <<
+                      ENTRY_OMITTED_SHIFT);
+    size_and_type |= ((uint32_t)(p_entry->fragments_needed != 0) <<
+                      ENTRY_CODED_SHIFT);
     WM_IMMU32(size_and_type);
     WM_IMMU32(p_entry->unique_id);
     WM_IMMU32(p_entry->term);
+    if (p_entry->fragments_needed) {
+      WM_IMMU32(p_entry->coded_size);
+      WM_IMMU32(((uint32_t)p_entry->fragments_needed << 16) |
+                p_entry->fragment_index);
+    }
   }
 
   for (uint32_t ii = 0; ii < num_entries; ++ii) {
     raft_log_entry_t const* p_entry = &p_entries[ii];
-    WM_BYTES(p_entry->p_data, p_entry->data_size);
+    if (!data_omitted(p_args, p_entry)) {
+      WM_BYTES(p_entry->p_data, p_entry->data_size);
+    }
+  }
+
+  for (uint32_t ii = 0; ii < p_args->num_relay_ids; ++ii) {
+    WM_IMMU32(p_args->p_relay_ids[ii]);
   }
 
   return RAFT_STATUS_OK;
@@ -232,28 +286,48 @@ raft_status_t raft_write_append_entries_response_envelope(
   WM_BOOL(success);
   WM(acknowledged_log_index);
   WM(acknowledged_log_term);
+  WM(seq);
 
   return RAFT_STATUS_OK;
 }
 
-raft_status_t raft_write_request_vote_envelope(
+raft_status_t raft_write_heartbeat_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_heartbeat_args_t const* p_args) {
+  WM_SETUP(MSG_TYPE_HEARTBEAT, 0);
+  WM(term);
+  WM(leader_id);
+  WM(leader_commit);
+  WM(seq);
+  WM(election_timeout_hint_ms);
+
+  return RAFT_STATUS_OK;
+}
+
+/* PreVote shares the RequestVote layout, and is read with the same
+ * functions. */
+static raft_status_t write_vote_envelope(
     raft_envelope_t* p_env,
+    raft_message_type_t type,
     raft_nodeid_t recipient_id,
     raft_request_vote_args_t const* p_args) {
-  WM_SETUP(MSG_TYPE_REQUEST_VOTE, 0);
+  WM_SETUP(type, 0);
   WM(term);
   WM(candidate_id);
   WM(last_log_index);
   WM(last_log_term);
+  WM_BOOL(leadership_transfer);
 
   return RAFT_STATUS_OK;
 }
 
-raft_status_t raft_write_request_vote_response_envelope(
+static raft_status_t write_vote_response_envelope(
     raft_envelope_t* p_env,
+    raft_message_type_t type,
     raft_nodeid_t recipient_id,
     raft_request_vote_response_args_t const* p_args) {
-  WM_SETUP(MSG_TYPE_REQUEST_VOTE_RESPONSE, 0);
+  WM_SETUP(type, 0);
   WM(follower_id);
   WM(term);
   WM_BOOL(vote_granted);
@@ -261,6 +335,103 @@ raft_status_t raft_write_request_vote_response_envelope(
   return RAFT_STATUS_OK;
 }
 
+raft_status_t raft_write_request_vote_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_request_vote_args_t const* p_args) {
+  return write_vote_envelope(p_env, MSG_TYPE_REQUEST_VOTE,
+                             recipient_id, p_args);
+}
+
+raft_status_t raft_write_request_vote_response_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_request_vote_response_args_t const* p_args) {
+  return write_vote_response_envelope(p_env, MSG_TYPE_REQUEST_VOTE_RESPONSE,
+                                      recipient_id, p_args);
+}
+
+raft_status_t raft_write_pre_vote_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_request_vote_args_t const* p_args) {
+  return write_vote_envelope(p_env, MSG_TYPE_PRE_VOTE, recipient_id, p_args);
+}
+
+raft_status_t raft_write_pre_vote_response_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_request_vote_response_args_t const* p_args) {
+  return write_vote_response_envelope(p_env, MSG_TYPE_PRE_VOTE_RESPONSE,
+                                      recipient_id, p_args);
+}
+
+raft_status_t raft_write_timeout_now_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_timeout_now_args_t const* p_args) {
+  WM_SETUP(MSG_TYPE_TIMEOUT_NOW, 0);
+  WM(term);
+  WM(leader_id);
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_write_read_index_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_read_index_args_t const* p_args) {
+  WM_SETUP(MSG_TYPE_READ_INDEX, 0);
+  WM(term);
+  WM(follower_id);
+  WM(request_id);
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_write_read_index_response_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_read_index_response_args_t const* p_args) {
+  WM_SETUP(MSG_TYPE_READ_INDEX_RESPONSE, 0);
+  WM(term);
+  WM(request_id);
+  WM_BOOL(success);
+  WM(read_index);
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_write_fragment_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_fragment_args_t const* p_args) {
+  WM_SETUP(MSG_TYPE_FRAGMENT, 0);
+  WM(sender_id);
+  WM(index);
+  WM(entry_term);
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_write_fragment_response_envelope(
+    raft_envelope_t* p_env,
+    raft_nodeid_t recipient_id,
+    raft_fragment_response_args_t const* p_args) {
+  WM_SETUP(MSG_TYPE_FRAGMENT_RESPONSE, p_args->data_size);
+  WM(sender_id);
+  WM(index);
+  WM(entry_term);
+  WM_BOOL(held);
+  WM(fragment_index);
+  WM(data_size);
+  if (p_args->data_size) {
+    WM_BYTES(p_args->p_data, p_args->data_size);
+  }
+
+  return RAFT_STATUS_OK;
+}
+
 /*******************************************************************************
  *******************************************************************************
  ******************************************************************************/
@@ -269,7 +440,7 @@ raft_message_type_t raft_message_type(void* p_message_bytes) {
   uint32_t v;
   read(&v, p_message_bytes);
   v &= 0xff;
-  if (v >= 1 && v <= MSG_TYPE_REQUEST_VOTE_RESPONSE) {
+  if (v >= 1 && v <= MSG_TYPE_FRAGMENT_RESPONSE) {
     return v;
   }
 
@@ -282,6 +453,8 @@ raft_status_t raft_read_append_entries_args(raft_append_entries_args_t* p_args,
                                             void* p_message_bytes,
                                             uint32_t message_size) {
   uint32_t num_entries = 0;
+  raft_status_t status = RAFT_STATUS_OUT_OF_MEMORY;
+  uint8_t const* const p_end = (uint8_t const*)p_message_bytes + message_size;
 
   RM_SETUP;
   RM(term);
@@ -290,12 +463,18 @@ raft_status_t raft_read_append_entries_args(raft_append_entries_args_t* p_args,
   RM(prev_log_term);
   RM_U32(&num_entries);
   RM(leader_commit);
+  RM(seq);
+  RM(election_timeout_hint_ms);
+  RM(num_relay_ids);
+
+  p_args->metadata_only = RAFT_FALSE;
+  p_args->p_relay_ids = NULL;
 
   raft_log_entry_t* p_entries = NULL;
   if (num_entries > 0) {
     p_entries = calloc(num_entries, sizeof(raft_log_entry_t));
     if (p_entries == NULL) {
-      goto fail_oom;
+      goto fail;
     }
   }
 
@@ -304,12 +483,23 @@ raft_status_t raft_read_append_entries_args(raft_append_entries_args_t* p_args,
     RM_U32(&size_and_type);
     RM_U32(&p_entries[ii].unique_id);
     RM_U32(&p_entries[ii].term);
-    p_entries[ii].type = size_and_type >> 31;
-    uint32_t data_size = p_entries[ii].data_size = size_and_type & 0x7fffffff;
-    if (data_size) {
+    p_entries[ii].type = size_and_type >> ENTRY_TYPE_SHIFT;
+    uint32_t data_size = (p_entries[ii].data_size =
+                          size_and_type & ENTRY_SIZE_MASK);
+    if ((size_and_type >> ENTRY_CODED_SHIFT) & 1) {
+      uint32_t fragment;
+      RM_U32(&p_entries[ii].coded_size);
+      RM_U32(&fragment);
+      p_entries[ii].fragments_needed = fragment >> 16;
+      p_entries[ii].fragment_index = fragment & 0xffff;
+    }
+    /* Omitted data keeps its size but has no bytes in the message. */
+    if ((size_and_type >> ENTRY_OMITTED_SHIFT) & 1) {
+      p_args->metadata_only = RAFT_TRUE;
+    } else if (data_size) {
       p_entries[ii].p_data = malloc(p_entries[ii].data_size);
       if (p_entries[ii].p_data == NULL) {
-        goto fail_oom;
+        goto fail;
       }
       p_entries[ii].data_size = data_size;
     }
@@ -317,14 +507,35 @@ raft_status_t raft_read_append_entries_args(raft_append_entries_args_t* p_args,
 
   for (uint32_t ii = 0; ii < num_entries; ++ii) {
     raft_log_entry_t* p_entry = &p_entries[ii];
-    RM_BYTES(p_entry->p_data, p_entry->data_size);
+    if (p_entry->p_data) {
+      RM_BYTES(p_entry->p_data, p_entry->data_size);
+    }
+  }
+
+  if (p_args->num_relay_ids > 0) {
+    /* message_size still counts the header, so measure from the cursor. */
+    if (p_buf > p_end ||
+        (size_t)(p_end - p_buf) / sizeof(raft_nodeid_t) <
+        p_args->num_relay_ids) {
+      p_args->num_relay_ids = 0;
+      status = RAFT_STATUS_INVALID_MESSAGE;
+      goto fail;
+    }
+    p_args->p_relay_ids = malloc(p_args->num_relay_ids *
+                                 sizeof(raft_nodeid_t));
+    if (p_args->p_relay_ids == NULL) {
+      goto fail;
+    }
+    for (uint32_t ii = 0; ii < p_args->num_relay_ids; ++ii) {
+      RM_U32(&p_args->p_relay_ids[ii]);
+    }
   }
 
   p_args->p_log_entries = p_entries;
   p_args->num_entries = num_entries;
   return RAFT_STATUS_OK;;
 
-fail_oom:
+fail:
   if (p_entries)  {
     for (uint32_t ii = 0; ii < num_entries; ++ii) {
       if (p_entries[ii].p_data) {
@@ -336,7 +547,21 @@ fail_oom:
     p_entries = NULL;
   }
 
-  return RAFT_STATUS_OUT_OF_MEMORY;
+  return status;
+}
+
+void raft_dealloc_append_entries_args(raft_append_entries_args_t* p_args) {
+  if (p_args->p_log_entries) {
+    for (uint32_t ii = 0; ii < p_args->num_entries; ++ii) {
+      free(p_args->p_log_entries[ii].p_data);
+    }
+    free(p_args->p_log_entries);
+  }
+  p_args->p_log_entries = NULL;
+  p_args->num_entries = 0;
+  free(p_args->p_relay_ids);
+  p_args->p_relay_ids = NULL;
+  p_args->num_relay_ids = 0;
 }
 
 raft_status_t raft_read_append_entries_response_args(
@@ -349,6 +574,20 @@ raft_status_t raft_read_append_entries_response_args(
   RM_BOOL(success);
   RM(acknowledged_log_index);
   RM(acknowledged_log_term);
+  RM(seq);
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_read_heartbeat_args(raft_heartbeat_args_t* p_args,
+                                       void* p_message_bytes,
+                                       uint32_t message_size) {
+  RM_SETUP;
+  RM(term);
+  RM(leader_id);
+  RM(leader_commit);
+  RM(seq);
+  RM(election_timeout_hint_ms);
 
   return RAFT_STATUS_OK;
 }
@@ -361,6 +600,7 @@ raft_status_t raft_read_request_vote_args(raft_request_vote_args_t* p_args,
   RM(candidate_id);
   RM(last_log_index);
   RM(last_log_term);
+  RM_BOOL(leadership_transfer);
 
   return RAFT_STATUS_OK;
 }
@@ -376,3 +616,71 @@ raft_status_t raft_read_request_vote_response_args(
 
   return RAFT_STATUS_OK;
 }
+
+raft_status_t raft_read_timeout_now_args(raft_timeout_now_args_t* p_args,
+                                         void* p_message_bytes,
+                                         uint32_t message_size) {
+  RM_SETUP;
+  RM(term);
+  RM(leader_id);
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_read_read_index_args(raft_read_index_args_t* p_args,
+                                        void* p_message_bytes,
+                                        uint32_t message_size) {
+  RM_SETUP;
+  RM(term);
+  RM(follower_id);
+  RM(request_id);
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_read_read_index_response_args(
+    raft_read_index_response_args_t* p_args,
+    void* p_message_bytes,
+    uint32_t message_size) {
+  RM_SETUP;
+  RM(term);
+  RM(request_id);
+  RM_BOOL(success);
+  RM(read_index);
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_read_fragment_args(raft_fragment_args_t* p_args,
+                                      void* p_message_bytes,
+                                      uint32_t message_size) {
+  RM_SETUP;
+  RM(sender_id);
+  RM(index);
+  RM(entry_term);
+
+  return RAFT_STATUS_OK;
+}
+
+raft_status_t raft_read_fragment_response_args(
+    raft_fragment_response_args_t* p_args,
+    void* p_message_bytes,
+    uint32_t message_size) {
+  uint8_t const* const p_end = (uint8_t const*)p_message_bytes + message_size;
+
+  RM_SETUP;
+  RM(sender_id);
+  RM(index);
+  RM(entry_term);
+  RM_BOOL(held);
+  RM(fragment_index);
+  RM(data_size);
+
+  /* The data stays in the message rather than being copied out. */
+  if (p_buf > p_end || (uint32_t)(p_end - p_buf) < p_args->data_size) {
+    return RAFT_STATUS_INVALID_MESSAGE;
+  }
+  p_args->p_data = p_args->data_size ? p_buf : NULL;
+
+  return RAFT_STATUS_OK;
+}
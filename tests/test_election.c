@@ -1,7 +1,17 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "CuTest.h"
 
+#include "raft_election.h"
+#include "raft_erasure.h"
+#include "raft_log.h"
+#include "raft_membership.h"
+#include "raft_ready.h"
+#include "raft_replication.h"
+#include "raft_wire.h"
+
 #define NODE_COUNT 5
 #include "test_helpers.h"
 
@@ -41,3 +51,1010 @@ void Test_election_after_leader_failures(CuTest* tc) {
 
   stop_nodes();
 }
+
+void Test_election_Then_replication(CuTest* tc) {
+  start_nodes();
+
+  process_events(10);
+  CuAssertIntEquals(tc, 1, leader_count());
+
+  /* The leader's term starts with an empty entry at index 1. */
+  raft_state_t* p_leader = get_node(first_leader());
+  CuAssertIntEquals(tc, 1, p_leader->v.commit_index);
+  CuAssertIntEquals(tc, RAFT_LOG_ENTRY_TYPE_SYSTEM,
+                    raft_log_entry(p_leader->p.p_log, 1)->type);
+  for (uint32_t ii = 0; ii < 3; ++ii) {
+    uint32_t* p_data = malloc(sizeof(uint32_t));
+    *p_data = ii;
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_append(p_leader, ii, p_data, sizeof(uint32_t),
+                                  NULL, NULL));
+  }
+  CuAssertIntEquals(tc, 4, p_leader->v.commit_index);
+  CuAssertIntEquals(tc, 4, p_leader->v.last_applied);
+
+  /* Followers learn the commit index from the next heartbeat. */
+  process_events(10);
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_state_t* p_state = get_node(ii);
+    CuAssertIntEquals(tc, 5, raft_log_length(p_state->p.p_log));
+    CuAssertIntEquals(tc, 4, p_state->v.commit_index);
+    CuAssertIntEquals(tc, 2, *(uint32_t*)raft_log_entry(p_state->p.p_log, 4)->p_data);
+  }
+
+  stop_nodes();
+}
+
+static uint32_t s_proposal_events[3];
+static void count_proposal_event(void* p_context,
+                                 raft_index_t index,
+                                 uint32_t unique_id,
+                                 raft_proposal_event_t event) {
+  CuAssertIntEquals((CuTest*)p_context, index, unique_id);
+  ++s_proposal_events[event];
+}
+
+void Test_election_Then_proposal_completion(CuTest* tc) {
+  memset(s_proposal_events, 0, sizeof(s_proposal_events));
+  start_nodes();
+
+  process_events(10);
+  raft_state_t* p_leader = get_node(first_leader());
+  for (uint32_t ii = 1; ii <= 3; ++ii) {
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_append(p_leader, raft_log_length(p_leader->p.p_log),
+                                  NULL, 0, count_proposal_event, tc));
+  }
+
+  CuAssertIntEquals(tc, 3, s_proposal_events[RAFT_PROPOSAL_COMMITTED]);
+  CuAssertIntEquals(tc, 3, s_proposal_events[RAFT_PROPOSAL_APPLIED]);
+  CuAssertIntEquals(tc, 0, s_proposal_events[RAFT_PROPOSAL_FAILED]);
+  CuAssertIntEquals(tc, 0, p_leader->q.count);
+
+  stop_nodes();
+}
+
+void Test_election_Then_proposal_failure(CuTest* tc) {
+  memset(s_proposal_events, 0, sizeof(s_proposal_events));
+  start_nodes();
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_leader = get_node(leader);
+
+  /* Cut the leader off so nothing it proposes commits. */
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    if (ii != leader) stop_node(ii);
+  }
+
+  for (uint32_t ii = 1; ii <= 2; ++ii) {
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_append(p_leader, raft_log_length(p_leader->p.p_log),
+                                  NULL, 0, count_proposal_event, tc));
+  }
+  CuAssertIntEquals(tc, 0, s_proposal_events[RAFT_PROPOSAL_COMMITTED]);
+
+  raft_append_entries_response_args_t args = {
+    .follower_id = (leader + 1) % NODE_COUNT + 1,
+    .term = p_leader->p.current_term + 1,
+  };
+  raft_recv_append_entries_response(p_leader, &args);
+
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_FOLLOWER, p_leader->type);
+  CuAssertIntEquals(tc, 2, s_proposal_events[RAFT_PROPOSAL_FAILED]);
+  CuAssertIntEquals(tc, 0, s_proposal_events[RAFT_PROPOSAL_APPLIED]);
+
+  stop_nodes();
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ********************************** PreVote ************************************
+ *******************************************************************************
+ ******************************************************************************/
+
+static void start_pre_vote_nodes() {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    get_node(ii)->p_config->pre_vote = RAFT_TRUE;
+  }
+}
+
+void Test_election_With_pre_vote(CuTest* tc) {
+  start_pre_vote_nodes();
+
+  process_events(10);
+  CuAssertIntEquals(tc, 1, leader_count());
+  CuAssertIntEquals(tc, 1, get_node(first_leader())->p.current_term);
+
+  stop_nodes();
+}
+
+void Test_election_With_pre_vote_Keeps_healthy_leader(CuTest* tc) {
+  start_pre_vote_nodes();
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_leader = get_node(leader);
+  raft_term_t const term = p_leader->p.current_term;
+
+  /* A follower that missed heartbeats, e.g. behind a partition, times out. */
+  raft_state_t* p_follower = get_node((leader + 1) % NODE_COUNT);
+  uint32_t reschedule_ms;
+  raft_tick(p_follower, &reschedule_ms,
+            p_follower->p_config->election_timeout_max_ms);
+
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_PRE_CANDIDATE, p_follower->type);
+  CuAssertIntEquals(tc, term, p_follower->p.current_term);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_LEADER, p_leader->type);
+  CuAssertIntEquals(tc, term, p_leader->p.current_term);
+
+  /* The next heartbeat brings it back. */
+  process_events(NODE_COUNT);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_FOLLOWER, p_follower->type);
+  CuAssertIntEquals(tc, 1, leader_count());
+  CuAssertIntEquals(tc, term, p_leader->p.current_term);
+
+  stop_nodes();
+}
+
+void Test_election_Pre_vote_leaves_term_and_vote(CuTest* tc) {
+  raft_state_t* p_state = make_raft_node(1);
+  p_state->p_config->use_ready = RAFT_TRUE;
+  p_state->p.current_term = 3;
+
+  raft_request_vote_args_t args = {
+    .term = 4,
+    .candidate_id = 2,
+  };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_recv_pre_vote(p_state, &args));
+  CuAssertIntEquals(tc, 3, p_state->p.current_term);
+  CuAssertIntEquals(tc, 0, p_state->p.voted_for);
+
+  raft_ready_t ready;
+  raft_ready(p_state, &ready);
+  CuAssertIntEquals(tc, 1, ready.num_messages);
+  CuAssertIntEquals(tc, MSG_TYPE_PRE_VOTE_RESPONSE,
+                    raft_message_type(ready.p_messages[0].p_message));
+
+  raft_request_vote_response_args_t response;
+  raft_read_request_vote_response_args(&response,
+                                       ready.p_messages[0].p_message,
+                                       ready.p_messages[0].message_size);
+  CuAssertIntEquals(tc, RAFT_TRUE, response.vote_granted);
+  CuAssertIntEquals(tc, 4, response.term);
+  raft_advance(p_state, &ready);
+
+  raft_free(p_state);
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ **************************** Leadership Transfer ******************************
+ *******************************************************************************
+ ******************************************************************************/
+
+void Test_election_Then_leadership_transfer(CuTest* tc) {
+  start_nodes();
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_leader = get_node(leader);
+  raft_term_t const term = p_leader->p.current_term;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_append(p_leader, 1, NULL, 0, NULL, NULL));
+
+  /* The target is caught up, so it takes over without waiting. */
+  raft_nodeid_t const target_id = (leader + 1) % NODE_COUNT + 1;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_transfer_leadership(p_leader, target_id));
+
+  CuAssertIntEquals(tc, 1, leader_count());
+  CuAssertIntEquals(tc, target_id, first_leader() + 1);
+  CuAssertIntEquals(tc, term + 1, get_node(target_id - 1)->p.current_term);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_FOLLOWER, p_leader->type);
+  CuAssertIntEquals(tc, target_id, p_leader->v.leader_id);
+
+  stop_nodes();
+}
+
+void Test_election_Leadership_transfer_To_lagging_target(CuTest* tc) {
+  raft_state_t* p_state = make_raft_node(1);
+  p_state->p_config->use_ready = RAFT_TRUE;
+  p_state->p.current_term = 1;
+  raft_promote_to_leader(p_state);
+  raft_append(p_state, 1, NULL, 0, NULL, NULL);
+
+  raft_ready_t ready;
+  raft_ready(p_state, &ready);
+  raft_advance(p_state, &ready);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_transfer_leadership(p_state, 2));
+  CuAssertIntEquals(tc, RAFT_STATUS_TRANSFER_IN_PROGRESS,
+                    raft_append(p_state, 2, NULL, 0, NULL, NULL));
+  CuAssertIntEquals(tc, RAFT_STATUS_TRANSFER_IN_PROGRESS,
+                    raft_transfer_leadership(p_state, 3));
+
+  /* TimeoutNow follows once the target acknowledges the whole log. */
+  raft_append_entries_response_args_t args = {
+    .follower_id = 2,
+    .term = 1,
+    .success = RAFT_TRUE,
+    .acknowledged_log_index = 2,
+  };
+  raft_recv_append_entries_response(p_state, &args);
+  raft_ready(p_state, &ready);
+  CuAssertIntEquals(tc, 1, ready.num_messages);
+  CuAssertIntEquals(tc, MSG_TYPE_TIMEOUT_NOW,
+                    raft_message_type(ready.p_messages[0].p_message));
+  raft_advance(p_state, &ready);
+
+  /* The target never took over; proposals resume. */
+  uint32_t reschedule_ms;
+  raft_tick(p_state, &reschedule_ms,
+            p_state->p_config->election_timeout_max_ms);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_append(p_state, 2, NULL, 0, NULL, NULL));
+
+  raft_free(p_state);
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ******************************** CheckQuorum **********************************
+ *******************************************************************************
+ ******************************************************************************/
+
+void Test_election_With_check_quorum(CuTest* tc) {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    get_node(ii)->p_config->check_quorum = RAFT_TRUE;
+  }
+
+  process_events(10);
+  CuAssertIntEquals(tc, 1, leader_count());
+
+  /* A leader that hears from its followers keeps leading. */
+  int32_t const leader = first_leader();
+  process_events(30);
+  CuAssertIntEquals(tc, leader, first_leader());
+
+  /* Cut the leader off from everyone else. */
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    if (ii != leader) stop_node(ii);
+  }
+
+  raft_state_t* p_leader = get_node(leader);
+  uint32_t reschedule_ms;
+  raft_tick(p_leader, &reschedule_ms,
+            p_leader->p_config->election_timeout_min_ms - 1);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_LEADER, p_leader->type);
+  raft_tick(p_leader, &reschedule_ms, 1);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_FOLLOWER, p_leader->type);
+  CuAssertIntEquals(tc, 0, p_leader->v.leader_id);
+
+  stop_nodes();
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ********************************** Learners ***********************************
+ *******************************************************************************
+ ******************************************************************************/
+
+/* Nodes 1 and 2 are learners, leaving a quorum of two out of three voters. */
+static void start_learner_nodes() {
+  raft_member_t const a_members[] = {
+    { 1, RAFT_ROLE_MEMBER },
+    { 2, RAFT_ROLE_MEMBER },
+    { 3, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER },
+    { 4, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER },
+    { 5, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER },
+  };
+
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_membership_apply(get_node(ii), a_members,
+                          ARRAY_ELEMENT_COUNT(a_members));
+  }
+}
+
+void Test_election_With_learners(CuTest* tc) {
+  start_learner_nodes();
+
+  process_events(10);
+  CuAssertIntEquals(tc, 1, leader_count());
+  int32_t const leader = first_leader();
+  CuAssertTrue(tc, leader >= 2);
+
+  /* Learners receive the log. */
+  raft_state_t* p_leader = get_node(leader);
+  raft_append(p_leader, 1, NULL, 0, NULL, NULL);
+  CuAssertIntEquals(tc, 3, raft_log_length(get_node(0)->p.p_log));
+  CuAssertIntEquals(tc, 3, raft_log_length(get_node(1)->p.p_log));
+  CuAssertTrue(tc, raft_learner_caught_up(p_leader, 1));
+
+  /* But acknowledgements from learners alone do not commit. */
+  for (uint32_t ii = 2; ii < NODE_COUNT; ++ii) {
+    if (ii != leader) stop_node(ii);
+  }
+  raft_index_t const commit_index = p_leader->v.commit_index;
+  raft_append(p_leader, 2, NULL, 0, NULL, NULL);
+  CuAssertIntEquals(tc, commit_index, p_leader->v.commit_index);
+
+  stop_nodes();
+}
+
+void Test_election_Learners_never_campaign(CuTest* tc) {
+  start_learner_nodes();
+
+  process_events(10);
+  for (uint32_t ii = 2; ii < NODE_COUNT; ++ii) {
+    stop_node(ii);
+  }
+  raft_term_t const term = get_node(0)->p.current_term;
+
+  /* Time the learners out directly; they still do not campaign. */
+  for (uint32_t ii = 0; ii < 2; ++ii) {
+    raft_state_t* p_learner = get_node(ii);
+    uint32_t reschedule_ms;
+    raft_tick(p_learner, &reschedule_ms,
+              p_learner->p_config->election_timeout_max_ms);
+    CuAssertIntEquals(tc, RAFT_NODE_TYPE_FOLLOWER, p_learner->type);
+    CuAssertIntEquals(tc, term, p_learner->p.current_term);
+    CuAssertTrue(tc, reschedule_ms > 0);
+  }
+
+  stop_nodes();
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ********************************* Membership **********************************
+ *******************************************************************************
+ ******************************************************************************/
+
+void Test_election_Promote_learner(CuTest* tc) {
+  start_learner_nodes();
+
+  process_events(10);
+  raft_state_t* p_leader = get_node(first_leader());
+  raft_append(p_leader, 1, NULL, 0, NULL, NULL);
+
+  /* The joint and then the final configuration commit in turn. */
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_promote_learner(p_leader, 1));
+  raft_index_t const config_index = raft_log_length(p_leader->p.p_log) - 1;
+  CuAssertIntEquals(tc, config_index, p_leader->v.commit_index);
+
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_state_t* p_state = get_node(ii);
+    CuAssertIntEquals(tc, config_index, p_state->m.config_index);
+    CuAssertTrue(tc, !p_state->m.joint);
+    CuAssertTrue(tc, raft_membership_is_voter(p_state, 1));
+    CuAssertTrue(tc, !raft_membership_is_voter(p_state, 2));
+    CuAssertTrue(tc, raft_membership_is_member(p_state, 2));
+  }
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS,
+                    raft_promote_learner(p_leader, 1));
+
+  stop_nodes();
+}
+
+void Test_election_Membership_change_removes_leader(CuTest* tc) {
+  start_nodes();
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_leader = get_node(leader);
+  CuAssertIntEquals(tc, 5, leader + 1);
+
+  raft_nodeid_t const a_voters[] = { 1, 2, 3 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_change_membership(p_leader, a_voters, 3, NULL, 0));
+
+  /**
+   * The leader steps down as soon as the configuration without it commits,
+   * which nodes 1 and 2 suffice for.
+   */
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_FOLLOWER, p_leader->type);
+  CuAssertTrue(tc, !raft_membership_is_member(p_leader, 5));
+  for (uint32_t ii = 0; ii < 2; ++ii) {
+    raft_state_t* p_state = get_node(ii);
+    CuAssertIntEquals(tc, 2, p_state->m.peer_count);
+    CuAssertTrue(tc, !raft_membership_is_member(p_state, 4));
+    CuAssertIntEquals(tc, p_leader->v.commit_index,
+                      p_state->m.config_index);
+  }
+
+  stop_nodes();
+}
+
+void Test_election_Joint_configuration_needs_both_majorities(CuTest* tc) {
+  start_learner_nodes();
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_leader = get_node(leader);
+
+  /* With voters 3 and 4 gone, the old configuration has no majority. */
+  stop_node(2);
+  stop_node(3);
+  raft_index_t const commit_index = p_leader->v.commit_index;
+  raft_nodeid_t const a_voters[] = { 1, 2, 5 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_change_membership(p_leader, a_voters, 3, NULL, 0));
+  CuAssertIntEquals(tc, commit_index, p_leader->v.commit_index);
+  CuAssertTrue(tc, p_leader->m.joint);
+  CuAssertTrue(tc, get_node(0)->m.joint);
+  CuAssertIntEquals(tc, RAFT_STATUS_CHANGE_IN_PROGRESS,
+                    raft_change_membership(p_leader, a_voters, 3, NULL, 0));
+
+  /* A new leader overwriting the joint entry restores the old config. */
+  raft_state_t* p_follower = get_node(0);
+  raft_index_t const config_index = p_follower->m.config_index;
+  raft_log_entry_t entry = {
+    .term = p_follower->p.current_term + 1,
+    .type = RAFT_LOG_ENTRY_TYPE_USER,
+  };
+  raft_append_entries_args_t args = {
+    .term = entry.term,
+    .leader_id = 3,
+    .prev_log_index = config_index - 1,
+    .prev_log_term = raft_log_entry(p_follower->p.p_log,
+                                    config_index - 1)->term,
+    .num_entries = 1,
+    .p_log_entries = &entry,
+  };
+  stop_node(leader);
+  raft_recv_append_entries(p_follower, &args);
+  CuAssertIntEquals(tc, 0, p_follower->m.config_index);
+  CuAssertTrue(tc, !p_follower->m.joint);
+  CuAssertTrue(tc, raft_membership_is_voter(p_follower, 1));
+
+  stop_nodes();
+}
+
+void Test_election_Membership_grows_node_arrays(CuTest* tc) {
+  start_nodes();
+
+  raft_state_t* p_state = get_node(0);
+  raft_member_t const a_members[] = {
+    { 1, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER },
+    { 2, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER },
+    { 8, RAFT_ROLE_MEMBER },
+  };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_membership_apply(p_state, a_members, 3));
+  CuAssertIntEquals(tc, 8, p_state->m.capacity);
+  CuAssertIntEquals(tc, 2, p_state->m.peer_count);
+  CuAssertTrue(tc, raft_membership_is_member(p_state, 8));
+  CuAssertTrue(tc, !raft_membership_is_voter(p_state, 8));
+  CuAssertTrue(tc, !raft_membership_is_member(p_state, 5));
+  CuAssertIntEquals(tc, 0, p_state->l.p_match_index[7]);
+  CuAssertIntEquals(tc, 0, p_state->l.p_ballot[7]);
+
+  stop_nodes();
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ********************************** Witnesses **********************************
+ *******************************************************************************
+ ******************************************************************************/
+
+void Test_election_Witness_stores_metadata_only(CuTest* tc) {
+  raft_member_t const a_members[] = {
+    { 1, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER | RAFT_ROLE_WITNESS },
+    { 2, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER },
+    { 3, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER },
+    { 4, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER },
+    { 5, RAFT_ROLE_MEMBER | RAFT_ROLE_VOTER },
+  };
+
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_membership_apply(get_node(ii), a_members,
+                          ARRAY_ELEMENT_COUNT(a_members));
+  }
+
+  process_events(10);
+  raft_state_t* p_leader = get_node(first_leader());
+
+  /* The witness's acknowledgement counts towards the commit... */
+  stop_node(2);
+  stop_node(3);
+  uint32_t* p_data = malloc(sizeof(uint32_t));
+  *p_data = 42;
+  raft_append(p_leader, 1, p_data, sizeof(uint32_t), NULL, NULL);
+  CuAssertIntEquals(tc, 2, p_leader->v.commit_index);
+
+  /* ...but it keeps no data and applies nothing. */
+  raft_state_t* p_witness = get_node(0);
+  raft_log_entry_t const* p_entry = raft_log_entry(p_witness->p.p_log, 2);
+  CuAssertIntEquals(tc, 1, p_entry->unique_id);
+  CuAssertIntEquals(tc, sizeof(uint32_t), p_entry->data_size);
+  CuAssertPtrEquals(tc, NULL, p_entry->p_data);
+  p_entry = raft_log_entry(get_node(1)->p.p_log, 2);
+  CuAssertIntEquals(tc, 42, *(uint32_t*)p_entry->p_data);
+
+  /* Nor does it ever campaign. */
+  raft_term_t const term = p_witness->p.current_term;
+  uint32_t reschedule_ms;
+  raft_tick(p_witness, &reschedule_ms,
+            p_witness->p_config->election_timeout_max_ms);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_FOLLOWER, p_witness->type);
+  CuAssertIntEquals(tc, term, p_witness->p.current_term);
+
+  stop_nodes();
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ****************************** Flexible Quorums *******************************
+ *******************************************************************************
+ ******************************************************************************/
+
+void Test_election_Flexible_quorums_are_validated(CuTest* tc) {
+  start_nodes();
+
+  raft_config_t config = *get_node(0)->p_config;
+  raft_state_t* p_state = NULL;
+
+  /* Two and three out of five need not intersect. */
+  config.replication_quorum = 2;
+  config.election_quorum = 3;
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS, raft_alloc(&p_state, &config));
+
+  /* Two election quorums of two out of five could elect two leaders. */
+  config.replication_quorum = 4;
+  config.election_quorum = 2;
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS, raft_alloc(&p_state, &config));
+
+  config.replication_quorum = 6;
+  config.election_quorum = 0;
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS, raft_alloc(&p_state, &config));
+
+  config.replication_quorum = 2;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_alloc(&p_state, &config));
+  raft_free(p_state);
+
+  stop_nodes();
+}
+
+void Test_election_With_flexible_quorums(CuTest* tc) {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    get_node(ii)->p_config->replication_quorum = 2;
+  }
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_leader = get_node(leader);
+
+  /* One follower's acknowledgement commits. */
+  for (uint32_t ii = 1; ii < NODE_COUNT; ++ii) {
+    if (ii != leader) stop_node(ii);
+  }
+  raft_append(p_leader, 1, NULL, 0, NULL, NULL);
+  CuAssertIntEquals(tc, 2, p_leader->v.commit_index);
+
+  /* But an election needs four of the five votes. */
+  raft_state_t* p_follower = get_node(0);
+  raft_campaign(p_follower, RAFT_FALSE);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_CANDIDATE, p_follower->type);
+  CuAssertIntEquals(tc, 2, raft_state_vote_count(p_follower));
+
+  stop_nodes();
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ************************* Weights and Priorities ******************************
+ *******************************************************************************
+ ******************************************************************************/
+
+static raft_node_preference_t s_preferences[] = {
+  { .id = 1, .vote_weight = 1, .priority = 2 },
+  { .id = 2, .vote_weight = 1, .priority = 1 },
+  { .id = 5, .vote_weight = 4, .priority = 0 },
+};
+
+static void start_weighted_nodes() {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_state_t* p_state = get_node(ii);
+    p_state->p_config->preference_count = ARRAY_ELEMENT_COUNT(s_preferences);
+    p_state->p_config->p_preferences = s_preferences;
+    raft_membership_init(p_state);
+  }
+}
+
+void Test_election_With_weighted_quorums(CuTest* tc) {
+  start_weighted_nodes();
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  CuAssertIntEquals(tc, 4, leader);
+  raft_state_t* p_leader = get_node(leader);
+
+  /* Node 5's weight of 4 and one more vote make 5 of 8. */
+  for (uint32_t ii = 1; ii < NODE_COUNT - 1; ++ii) {
+    stop_node(ii);
+  }
+  raft_append(p_leader, 1, NULL, 0, NULL, NULL);
+  CuAssertIntEquals(tc, 2, p_leader->v.commit_index);
+
+  /* Without node 5, four nodes of weight 1 are not enough. */
+  stop_nodes();
+  start_weighted_nodes();
+  stop_node(4);
+  raft_state_t* p_candidate = get_node(0);
+  raft_campaign(p_candidate, RAFT_FALSE);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_CANDIDATE, p_candidate->type);
+  CuAssertIntEquals(tc, 4, raft_state_vote_count(p_candidate));
+
+  stop_nodes();
+}
+
+void Test_election_Priorities_order_election_timeouts(CuTest* tc) {
+  start_weighted_nodes();
+
+  /* Three priority levels split the 500ms range into thirds. */
+  for (uint32_t round = 0; round < 20; ++round) {
+    for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+      raft_reset_election_timer(get_node(ii));
+    }
+    CuAssertTrue(tc, get_node(0)->v.election_timeout_ms < 666);
+    CuAssertTrue(tc, get_node(1)->v.election_timeout_ms >= 666);
+    CuAssertTrue(tc, get_node(1)->v.election_timeout_ms < 832);
+    for (uint32_t ii = 2; ii < NODE_COUNT; ++ii) {
+      CuAssertTrue(tc, get_node(ii)->v.election_timeout_ms >= 832);
+      CuAssertTrue(tc, get_node(ii)->v.election_timeout_ms < 1000);
+    }
+  }
+
+  stop_nodes();
+}
+
+void Test_election_With_adaptive_timeouts(CuTest* tc) {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_config_t* p_config = get_node(ii)->p_config;
+    p_config->adaptive_election_timeout = RAFT_TRUE;
+    p_config->election_timeout_min_ms = 50;
+  }
+
+  process_events(50);
+  int32_t const leader = first_leader();
+  raft_state_t* p_leader = get_node(leader);
+
+  /* Round trips are instant here, leaving twice the ping interval. */
+  raft_state_t* p_follower = get_node(leader == 0 ? 1 : 0);
+  raft_nodeid_t const follower_id = p_follower->p.self;
+  CuAssertTrue(tc, p_leader->l.p_rtt_count[follower_id - 1] > 0);
+  CuAssertIntEquals(tc, 200, p_leader->l.p_hint_ms[follower_id - 1]);
+  CuAssertIntEquals(tc, 200, p_follower->v.election_timeout_hint_ms);
+  for (uint32_t round = 0; round < 20; ++round) {
+    raft_reset_election_timer(p_follower);
+    CuAssertTrue(tc, p_follower->v.election_timeout_ms >= 200);
+    CuAssertTrue(tc, p_follower->v.election_timeout_ms < 400);
+  }
+
+  /* Slow round trips widen the window, up to the configured maximum. */
+  uint32_t* p_rtt_ms =
+      &p_leader->l.p_rtt_ms[(follower_id - 1) * RAFT_RTT_SAMPLE_COUNT];
+  for (uint32_t ii = 0; ii < RAFT_RTT_SAMPLE_COUNT; ++ii) {
+    p_rtt_ms[ii] = 300;
+  }
+  p_leader->l.p_rtt_count[follower_id - 1] = RAFT_RTT_SAMPLE_COUNT;
+  p_leader->l.p_rtt_pending[follower_id - 1] = RAFT_TRUE;
+  raft_election_rtt_ack(p_leader, follower_id,
+                        p_leader->l.p_rtt_seq[follower_id - 1]);
+  CuAssertTrue(tc, p_leader->l.p_hint_ms[follower_id - 1] >= 1400);
+
+  p_follower->v.election_timeout_hint_ms =
+      p_leader->l.p_hint_ms[follower_id - 1];
+  for (uint32_t round = 0; round < 20; ++round) {
+    raft_reset_election_timer(p_follower);
+    CuAssertTrue(tc, p_follower->v.election_timeout_ms >= 666);
+    CuAssertTrue(tc, p_follower->v.election_timeout_ms < 1000);
+  }
+
+  stop_nodes();
+}
+
+void Test_election_Adaptive_timeouts_time_each_follower(CuTest* tc) {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    get_node(ii)->p_config->adaptive_election_timeout = RAFT_TRUE;
+  }
+
+  process_events(50);
+  raft_state_t* p_leader = get_node(first_leader());
+  raft_nodeid_t const follower_id = (p_leader->p.self == 1 ? 2 : 1);
+  uint32_t const i = follower_id - 1;
+  CuAssertTrue(tc, !p_leader->l.p_rtt_pending[i]);
+
+  /* A follower first messaged 40ms into the round is timed from then, and
+   * later messages in the same round do not restart its clock. */
+  ++p_leader->rd.seq;
+  p_leader->v.clock_ms += 40;
+  raft_election_rtt_sent(p_leader, follower_id);
+  p_leader->v.clock_ms += 10;
+  raft_election_rtt_sent(p_leader, follower_id);
+  p_leader->v.clock_ms += 5;
+
+  uint32_t const count = p_leader->l.p_rtt_count[i];
+  raft_election_rtt_ack(p_leader, follower_id, p_leader->rd.seq);
+  CuAssertIntEquals(tc, count + 1, p_leader->l.p_rtt_count[i]);
+  CuAssertIntEquals(tc, 15,
+                    p_leader->l.p_rtt_ms[i * RAFT_RTT_SAMPLE_COUNT +
+                                         count % RAFT_RTT_SAMPLE_COUNT]);
+
+  /* A second answer to the same round adds no sample. */
+  raft_election_rtt_ack(p_leader, follower_id, p_leader->rd.seq);
+  CuAssertIntEquals(tc, count + 1, p_leader->l.p_rtt_count[i]);
+
+  stop_nodes();
+}
+
+void Test_election_Adaptive_timeouts_stay_randomized(CuTest* tc) {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_config_t* p_config = get_node(ii)->p_config;
+    p_config->adaptive_election_timeout = RAFT_TRUE;
+    p_config->election_timeout_floor_ms = 20;
+  }
+
+  /* A hint below election_timeout_min_ms still leaves a window half as wide
+   * as its start, so nodes given the same hint rarely time out together. */
+  raft_state_t* p_first = get_node(0);
+  raft_state_t* p_second = get_node(1);
+  p_first->v.election_timeout_hint_ms = 40;
+  p_second->v.election_timeout_hint_ms = 40;
+  uint32_t differing = 0;
+  for (uint32_t round = 0; round < 20; ++round) {
+    raft_reset_election_timer(p_first);
+    raft_reset_election_timer(p_second);
+    CuAssertTrue(tc, p_first->v.election_timeout_ms >= 40);
+    CuAssertTrue(tc, p_first->v.election_timeout_ms < 80);
+    differing += (p_first->v.election_timeout_ms !=
+                  p_second->v.election_timeout_ms);
+  }
+  CuAssertTrue(tc, differing > 0);
+
+  /* The floor bounds how low the hint may take the window. */
+  p_first->v.election_timeout_hint_ms = 5;
+  raft_reset_election_timer(p_first);
+  CuAssertTrue(tc, p_first->v.election_timeout_ms >= 20);
+  CuAssertTrue(tc, p_first->v.election_timeout_ms < 40);
+
+  stop_nodes();
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ****************************** Relay Replication ******************************
+ *******************************************************************************
+ ******************************************************************************/
+
+void Test_election_With_relays(CuTest* tc) {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    get_node(ii)->p_config->relay_fanout = 2;
+  }
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_leader = get_node(leader);
+
+  /* Relayed followers acknowledge the leader directly. */
+  raft_append(p_leader, 1, NULL, 0, NULL, NULL);
+  raft_index_t const last_index = raft_log_length(p_leader->p.p_log) - 1;
+  CuAssertIntEquals(tc, last_index, p_leader->v.commit_index);
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    CuAssertIntEquals(tc, last_index + 1,
+                      raft_log_length(get_node(ii)->p.p_log));
+    if (ii != leader) {
+      CuAssertIntEquals(tc, last_index, p_leader->l.p_match_index[ii]);
+    }
+  }
+
+  stop_nodes();
+}
+
+static char const s_coded_value[] = "erasure";
+static uint32_t s_coded_applies = 0;
+
+static raft_status_t count_coded_apply(raft_index_t index,
+                                       raft_log_entry_t const* p_entry) {
+  if (p_entry->data_size == sizeof(s_coded_value) &&
+      memcmp(p_entry->p_data, s_coded_value, sizeof(s_coded_value)) == 0) {
+    ++s_coded_applies;
+  }
+  return RAFT_STATUS_OK;
+}
+
+static void start_coding_nodes() {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_config_t* p_config = get_node(ii)->p_config;
+    p_config->erasure_fragments = 2;
+    p_config->erasure_min_size = 4;
+    p_config->cb.pf_apply_log_entry = &count_coded_apply;
+  }
+  s_coded_applies = 0;
+}
+
+static void append_coded_value(raft_state_t* p_leader) {
+  void* p_data = malloc(sizeof(s_coded_value));
+  memcpy(p_data, s_coded_value, sizeof(s_coded_value));
+  raft_append(p_leader, 1, p_data, sizeof(s_coded_value), NULL, NULL);
+}
+
+void Test_election_With_erasure_coding(CuTest* tc) {
+  start_coding_nodes();
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_leader = get_node(leader);
+
+  /* Followers are sent only their own fragment. */
+  raft_state_t* p_follower = get_node(leader == 0 ? 1 : 0);
+  p_follower->p_config->cb.pf_apply_log_entry = NULL;
+  append_coded_value(p_leader);
+  raft_index_t const index = raft_log_length(p_leader->p.p_log) - 1;
+  CuAssertIntEquals(tc, index, p_leader->v.commit_index);
+  /* Nothing coded is left for later commits to check. */
+  CuAssertIntEquals(tc, 0, p_leader->l.first_coded_index);
+
+  raft_log_entry_t const* p_entry = raft_log_entry(p_follower->p.p_log, index);
+  CuAssertIntEquals(tc, sizeof(s_coded_value), p_entry->coded_size);
+  CuAssertIntEquals(tc, 2, p_entry->fragments_needed);
+  if (p_follower->v.commit_index < index) {
+    CuAssertIntEquals(tc, p_follower->p.self - 1, p_entry->fragment_index);
+    CuAssertIntEquals(tc, (sizeof(s_coded_value) + 1) / 2,
+                      p_entry->data_size);
+  }
+
+  /* Once it commits, each node rebuilds the entry from the others'
+   * fragments before applying it. */
+  process_events(20);
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_state_t* p_state = get_node(ii);
+    CuAssertIntEquals(tc, index, p_state->v.last_applied);
+    p_entry = raft_log_entry(p_state->p.p_log, index);
+    CuAssertIntEquals(tc, RAFT_FRAGMENT_WHOLE, p_entry->fragment_index);
+    CuAssertStrEquals(tc, s_coded_value, p_entry->p_data);
+  }
+  CuAssertIntEquals(tc, NODE_COUNT - 1, s_coded_applies);
+
+  stop_nodes();
+}
+
+void Test_election_Coded_entries_survive_their_leader(CuTest* tc) {
+  start_coding_nodes();
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_old_leader = get_node(leader);
+
+  /* Only the entry reaches the followers, not its commit. */
+  p_old_leader->p_config->use_ready = RAFT_TRUE;
+  append_coded_value(p_old_leader);
+  raft_index_t const index = raft_log_length(p_old_leader->p.p_log) - 1;
+  raft_ready_t ready;
+  raft_ready(p_old_leader, &ready);
+  for (uint32_t ii = 0; ii < ready.num_messages; ++ii) {
+    raft_envelope_t const* p_env = &ready.p_messages[ii];
+    send_message_callback(p_env->recipient_id, p_env->p_message,
+                          p_env->message_size);
+  }
+  raft_advance(p_old_leader, &ready);
+  stop_node(leader);
+
+  /* The next leader holds only its fragment, and rebuilds the entry from
+   * the others' before replicating it. */
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_state_t* p_state = get_node(ii);
+    if (p_state) {
+      CuAssertTrue(tc, p_state->v.commit_index < index);
+      CuAssertTrue(tc, raft_log_entry(p_state->p.p_log, index)->fragment_index !=
+                       RAFT_FRAGMENT_WHOLE);
+    }
+  }
+  s_coded_applies = 0;
+  while (first_leader() < 0) {
+    process_events(1);
+  }
+  raft_state_t* p_leader = get_node(first_leader());
+  raft_log_entry_t const* p_entry = raft_log_entry(p_leader->p.p_log, index);
+  CuAssertIntEquals(tc, RAFT_FRAGMENT_WHOLE, p_entry->fragment_index);
+  CuAssertStrEquals(tc, s_coded_value, p_entry->p_data);
+
+  /* It commits once an entry from the new term does. */
+  raft_append(p_leader, 2, NULL, 0, NULL, NULL);
+  process_events(20);
+  CuAssertIntEquals(tc, NODE_COUNT - 1, s_coded_applies);
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    raft_state_t* p_state = get_node(ii);
+    if (p_state) {
+      p_entry = raft_log_entry(p_state->p.p_log, index);
+      CuAssertStrEquals(tc, s_coded_value, p_entry->p_data);
+    }
+  }
+
+  stop_nodes();
+}
+
+void Test_election_Coded_entries_too_few_hold_are_dropped(CuTest* tc) {
+  start_coding_nodes();
+
+  process_events(10);
+  int32_t const leader = first_leader();
+  raft_state_t* p_old_leader = get_node(leader);
+  uint32_t const holder = leader == 0 ? 1 : 0;
+  raft_state_t* p_holder = get_node(holder);
+
+  /* Only one follower gets a fragment before the leader is lost. */
+  p_old_leader->p_config->use_ready = RAFT_TRUE;
+  append_coded_value(p_old_leader);
+  raft_index_t const index = raft_log_length(p_old_leader->p.p_log) - 1;
+  raft_ready_t ready;
+  raft_ready(p_old_leader, &ready);
+  for (uint32_t ii = 0; ii < ready.num_messages; ++ii) {
+    raft_envelope_t const* p_env = &ready.p_messages[ii];
+    if (p_env->recipient_id == p_holder->p.self) {
+      send_message_callback(p_env->recipient_id, p_env->p_message,
+                            p_env->message_size);
+    }
+  }
+  raft_advance(p_old_leader, &ready);
+  stop_node(leader);
+  CuAssertIntEquals(tc, index + 1, raft_log_length(p_holder->p.p_log));
+
+  /* The others answer that they lack it, so it cannot have committed, and
+   * the new leader drops it rather than wait for fragments. */
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_campaign(p_holder, RAFT_FALSE));
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_LEADER, p_holder->type);
+
+  /* The empty entry starting the new term takes its place. */
+  CuAssertIntEquals(tc, index + 1, raft_log_length(p_holder->p.p_log));
+  raft_log_entry_t const* p_entry = raft_log_entry(p_holder->p.p_log, index);
+  CuAssertIntEquals(tc, RAFT_LOG_ENTRY_TYPE_SYSTEM, p_entry->type);
+  CuAssertIntEquals(tc, p_holder->p.current_term, p_entry->term);
+
+  raft_append(p_holder, 2, NULL, 0, NULL, NULL);
+  CuAssertIntEquals(tc, index + 1, p_holder->v.commit_index);
+
+  stop_nodes();
+}
+
+static uint32_t s_apply_failures = 0;
+
+static raft_status_t failing_apply(raft_index_t index,
+                                   raft_log_entry_t const* p_entry) {
+  if (s_apply_failures) {
+    --s_apply_failures;
+    return RAFT_STATUS_INVALID_ARGS;
+  }
+  return RAFT_STATUS_OK;
+}
+
+void Test_election_Failed_apply_is_retried(CuTest* tc) {
+  raft_state_t* p_state = make_raft_node(1);
+  p_state->p_config->cb.pf_apply_log_entry = &failing_apply;
+  raft_log_append_user(p_state->p.p_log, 1, 0, NULL, 0);
+  raft_log_append_user(p_state->p.p_log, 2, 0, NULL, 0);
+  p_state->v.commit_index = 2;
+
+  s_apply_failures = 1;
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS,
+                    raft_apply_committed(p_state));
+  CuAssertIntEquals(tc, 0, p_state->v.last_applied);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_apply_committed(p_state));
+  CuAssertIntEquals(tc, 2, p_state->v.last_applied);
+
+  raft_free(p_state);
+}
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "CuTest.h"
+
+#include "raft_erasure.h"
+
+#define DATA_SIZE 11
+#define FRAGMENTS_NEEDED 3
+
+static void encode_all(uint8_t const* p_data,
+                       uint8_t a_fragments[][DATA_SIZE],
+                       uint32_t const* p_indexes) {
+  for (uint32_t ii = 0; ii < FRAGMENTS_NEEDED; ++ii) {
+    raft_erasure_encode(p_data, DATA_SIZE, FRAGMENTS_NEEDED, p_indexes[ii],
+                        a_fragments[ii]);
+  }
+}
+
+void Test_raft_erasure_Data_fragments(CuTest* tc) {
+  uint8_t a_data[DATA_SIZE] = "abcdefghij";
+  CuAssertIntEquals(tc, 4,
+                    raft_erasure_fragment_size(DATA_SIZE, FRAGMENTS_NEEDED));
+
+  /* Data fragments are the entry itself, zero padded. */
+  uint8_t a_fragment[4];
+  raft_erasure_encode(a_data, DATA_SIZE, FRAGMENTS_NEEDED, 2, a_fragment);
+  CuAssertIntEquals(tc, 0, memcmp("ij\0\0", a_fragment, 4));
+}
+
+void Test_raft_erasure_Decode(CuTest* tc) {
+  uint8_t a_data[DATA_SIZE] = "abcdefghij";
+  uint32_t a_index_sets[][FRAGMENTS_NEEDED] = {
+    { 0, 1, 2 },
+    { 5, 3, 4 },
+    { 2, 200, 0 },
+    { 255, 1, 17 },
+  };
+
+  for (uint32_t ii = 0; ii < sizeof(a_index_sets) / sizeof(*a_index_sets);
+       ++ii) {
+    uint8_t a_fragments[FRAGMENTS_NEEDED][DATA_SIZE];
+    encode_all(a_data, a_fragments, a_index_sets[ii]);
+
+    void const* a_pointers[FRAGMENTS_NEEDED];
+    for (uint32_t jj = 0; jj < FRAGMENTS_NEEDED; ++jj) {
+      a_pointers[jj] = a_fragments[jj];
+    }
+
+    uint8_t a_decoded[DATA_SIZE] = { 0 };
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_erasure_decode(a_pointers, a_index_sets[ii],
+                                          FRAGMENTS_NEEDED, DATA_SIZE,
+                                          a_decoded));
+    CuAssertIntEquals(tc, 0, memcmp(a_data, a_decoded, DATA_SIZE));
+  }
+}
+
+void Test_raft_erasure_Decode_with_repeated_fragments(CuTest* tc) {
+  uint8_t a_data[DATA_SIZE] = "abcdefghij";
+  uint32_t a_indexes[FRAGMENTS_NEEDED] = { 4, 1, 4 };
+  uint8_t a_fragments[FRAGMENTS_NEEDED][DATA_SIZE];
+  encode_all(a_data, a_fragments, a_indexes);
+
+  void const* a_pointers[] = { a_fragments[0], a_fragments[1], a_fragments[2] };
+  uint8_t a_decoded[DATA_SIZE];
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS,
+                    raft_erasure_decode(a_pointers, a_indexes,
+                                        FRAGMENTS_NEEDED, DATA_SIZE,
+                                        a_decoded));
+}
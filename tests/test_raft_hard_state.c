@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "CuTest.h"
+
+#include "raft_hard_state.h"
+
+void Test_raft_hard_state_Slot(CuTest* tc) {
+  raft_hard_state_t const hard_state = { 0x01020304, 5 };
+  uint8_t a_slot[RAFT_HARD_STATE_SIZE];
+  raft_hard_state_encode(&hard_state, 0x100000007, a_slot);
+
+  raft_hard_state_t read_state;
+  uint64_t sequence;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_hard_state_decode(a_slot, &read_state, &sequence));
+  CuAssertIntEquals(tc, 0x01020304, read_state.current_term);
+  CuAssertIntEquals(tc, 5, read_state.voted_for);
+  CuAssertTrue(tc, sequence == 0x100000007);
+
+  a_slot[14] ^= 1;
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_MESSAGE,
+                    raft_hard_state_decode(a_slot, &read_state, &sequence));
+
+  uint8_t a_empty[RAFT_HARD_STATE_SIZE] = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_MESSAGE,
+                    raft_hard_state_decode(a_empty, &read_state, &sequence));
+}
+
+void Test_raft_hard_state_File(CuTest* tc) {
+  char a_path[] = "/tmp/raft_hard_state_XXXXXX";
+  int fd = mkstemp(a_path);
+  CuAssertTrue(tc, fd >= 0);
+  close(fd);
+
+  raft_hard_state_file_t* p_file;
+  raft_hard_state_t hard_state;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_hard_state_open(a_path, &p_file, &hard_state));
+  CuAssertIntEquals(tc, 0, hard_state.current_term);
+  CuAssertIntEquals(tc, 0, hard_state.voted_for);
+
+  for (raft_term_t term = 1; term <= 3; ++term) {
+    hard_state.current_term = term;
+    hard_state.voted_for = term + 1;
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_hard_state_save(p_file, &hard_state));
+  }
+  raft_hard_state_close(p_file);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_hard_state_open(a_path, &p_file, &hard_state));
+  CuAssertIntEquals(tc, 3, hard_state.current_term);
+  CuAssertIntEquals(tc, 4, hard_state.voted_for);
+  raft_hard_state_close(p_file);
+
+  /* A torn write of the latest slot falls back to the one before. */
+  FILE* p_stream = fopen(a_path, "r+b");
+  fseek(p_stream, RAFT_HARD_STATE_SIZE + 13, SEEK_SET);
+  fputc(0xff, p_stream);
+  fclose(p_stream);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_hard_state_open(a_path, &p_file, &hard_state));
+  CuAssertIntEquals(tc, 2, hard_state.current_term);
+  CuAssertIntEquals(tc, 3, hard_state.voted_for);
+  raft_hard_state_close(p_file);
+
+  /* With neither slot intact, the vote cast is unknown. */
+  p_stream = fopen(a_path, "r+b");
+  fseek(p_stream, 13, SEEK_SET);
+  fputc(0xff, p_stream);
+  fclose(p_stream);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_IO_ERROR,
+                    raft_hard_state_open(a_path, &p_file, &hard_state));
+  CuAssertPtrEquals(tc, NULL, p_file);
+
+  unlink(a_path);
+}
+
+void Test_raft_hard_state_New_file(CuTest* tc) {
+  char a_dir[] = "/tmp/raft_hard_state_XXXXXX";
+  CuAssertPtrNotNull(tc, mkdtemp(a_dir));
+  char a_path[sizeof(a_dir) + 8];
+  snprintf(a_path, sizeof(a_path), "%s/state", a_dir);
+
+  raft_hard_state_file_t* p_file;
+  raft_hard_state_t hard_state = { 7, 7 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_hard_state_open(a_path, &p_file, &hard_state));
+  CuAssertIntEquals(tc, 0, hard_state.current_term);
+  CuAssertIntEquals(tc, 0, hard_state.voted_for);
+  raft_hard_state_close(p_file);
+
+  /* Reopened before anything was saved, it is still new. */
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_hard_state_open(a_path, &p_file, &hard_state));
+  raft_hard_state_close(p_file);
+
+  unlink(a_path);
+  rmdir(a_dir);
+}
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "CuTest.h"
+
+#include "raft_log.h"
+
+static void* make_payload(uint32_t size, uint8_t value) {
+  void* p_data = malloc(size);
+  memset(p_data, value, size);
+  return p_data;
+}
+
+void Test_raft_log_Payloads(CuTest* tc) {
+  raft_log_t* p_log = raft_log_alloc();
+
+  /* Enough entries to span several nodes, alternating small and large
+   * payloads. */
+  for (uint32_t ii = 1; ii < 300; ++ii) {
+    uint32_t const size = ii % 2 ? 24 : 1000;
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_log_append_user(p_log, ii, 1,
+                                           make_payload(size, (uint8_t)ii),
+                                           size));
+  }
+
+  raft_log_entry_t const a_entries[] = {
+    { .term = 2, .type = RAFT_LOG_ENTRY_TYPE_USER,
+      .p_data = "copied", .data_size = 7 },
+    { .term = 2, .type = RAFT_LOG_ENTRY_TYPE_SYSTEM },
+  };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_log_append(p_log, a_entries, 2));
+  CuAssertIntEquals(tc, 302, raft_log_length(p_log));
+
+  for (uint32_t ii = 1; ii < 300; ++ii) {
+    raft_log_entry_t const* p_entry = raft_log_entry(p_log, ii);
+    CuAssertIntEquals(tc, ii % 2 ? 24 : 1000, p_entry->data_size);
+    CuAssertIntEquals(tc, (uint8_t)ii,
+                      ((uint8_t const*)p_entry->p_data)[p_entry->data_size - 1]);
+  }
+  raft_log_entry_t const* p_copy = raft_log_entry(p_log, 300);
+  CuAssertTrue(tc, p_copy->p_data != a_entries[0].p_data);
+  CuAssertStrEquals(tc, "copied", p_copy->p_data);
+  CuAssertPtrEquals(tc, NULL, raft_log_entry(p_log, 301)->p_data);
+
+  /* Truncation and freeing release only the payloads allocated apart. */
+  raft_log_truncate(p_log, 150);
+  CuAssertIntEquals(tc, 150, raft_log_length(p_log));
+  CuAssertIntEquals(tc, (uint8_t)149,
+                    ((uint8_t const*)raft_log_entry(p_log, 149)->p_data)[23]);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_log_append_user(p_log, 150, 3,
+                                         make_payload(64, 0xcd), 64));
+  CuAssertIntEquals(tc, 0xcd,
+                    ((uint8_t const*)raft_log_entry(p_log, 150)->p_data)[63]);
+
+  raft_log_free(p_log);
+}
+
+void Test_raft_log_Truncate(CuTest* tc) {
+  raft_log_t* p_log = raft_log_alloc();
+  for (uint32_t ii = 1; ii < 1000; ++ii) {
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_log_append_user(p_log, ii, 1,
+                                           make_payload(300, (uint8_t)ii),
+                                           300));
+  }
+
+  /* Payloads truncated away make room for those replacing them. */
+  raft_log_truncate(p_log, 990);
+  for (uint32_t ii = 990; ii < 1000; ++ii) {
+    raft_log_append_user(p_log, ii, 2, make_payload(200, 0xee), 200);
+  }
+  CuAssertIntEquals(tc, (uint8_t)989,
+                    ((uint8_t const*)raft_log_entry(p_log, 989)->p_data)[299]);
+  CuAssertIntEquals(tc, 0xee,
+                    ((uint8_t const*)raft_log_entry(p_log, 995)->p_data)[199]);
+
+  /* Whole nodes dropped by truncation are replaced as the log grows. */
+  raft_log_truncate(p_log, 2);
+  for (uint32_t ii = 2; ii < 1000; ++ii) {
+    raft_log_append_user(p_log, ii, 3, make_payload(8, (uint8_t)ii), 8);
+  }
+  CuAssertIntEquals(tc, 1000, raft_log_length(p_log));
+  for (raft_index_t index = 1; index < 1000; ++index) {
+    raft_log_entry_t const* p_entry = raft_log_entry(p_log, index);
+    CuAssertIntEquals(tc, index, p_entry->unique_id);
+    CuAssertIntEquals(tc, index == 1 ? 1 : 3, p_entry->term);
+  }
+  CuAssertIntEquals(tc, (uint8_t)999,
+                    ((uint8_t const*)raft_log_entry(p_log, -1)->p_data)[7]);
+
+  raft_log_free(p_log);
+}
@@ -0,0 +1,456 @@
+#include "CuTest.h"
+
+#include "raft_election.h"
+#include "raft_lease.h"
+#include "raft_log.h"
+#include "raft_wire.h"
+
+#define NODE_COUNT 5
+#include "test_helpers.h"
+
+static uint32_t s_reads_released;
+static raft_index_t s_last_read_index;
+static raft_status_t s_last_read_status;
+static void count_read(void* p_context,
+                       raft_index_t read_index,
+                       raft_status_t status) {
+  ++s_reads_released;
+  s_last_read_index = read_index;
+  s_last_read_status = status;
+}
+
+static void reset_reads() {
+  s_reads_released = 0;
+  s_last_read_index = 0;
+  s_last_read_status = RAFT_STATUS_OK;
+}
+
+
+static void ack_round(raft_state_t* p_state, uint32_t seq) {
+  for (raft_nodeid_t id = 2; id <= NODE_COUNT / 2 + 1; ++id) {
+    raft_append_entries_response_args_t args = {
+      .follower_id = id,
+      .term = p_state->p.current_term,
+      .success = RAFT_TRUE,
+      .acknowledged_log_index = raft_log_length(p_state->p.p_log) - 1,
+      .seq = seq,
+    };
+    raft_recv_append_entries_response(p_state, &args);
+  }
+}
+
+static uint32_t drain_messages(raft_state_t* p_state) {
+  raft_ready_t ready;
+  raft_ready(p_state, &ready);
+  uint32_t const num_messages = ready.num_messages;
+  raft_advance(p_state, &ready);
+  return num_messages;
+}
+
+/* A ready-mode leader for term 1 whose first heartbeat round, carrying the
+ * no-op it appended on taking office, has been acknowledged. */
+static raft_state_t* make_ready_leader() {
+  raft_state_t* p_state = make_raft_node(1);
+  p_state->p_config->use_ready = RAFT_TRUE;
+  p_state->p.current_term = 1;
+  raft_promote_to_leader(p_state);
+  drain_messages(p_state);
+  ack_round(p_state, p_state->rd.seq);
+  drain_messages(p_state);
+  return p_state;
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ********************************* ReadIndex ***********************************
+ *******************************************************************************
+ ******************************************************************************/
+
+void Test_raft_read_index_As_follower(CuTest* tc) {
+  raft_state_t* p_state = make_raft_node(1);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_NOT_LEADER,
+                    raft_read_index(p_state, count_read, NULL));
+
+  raft_free(p_state);
+}
+
+void Test_raft_read_index_In_cluster(CuTest* tc) {
+  reset_reads();
+  start_nodes();
+
+  process_events(10);
+  raft_state_t* p_leader = get_node(first_leader());
+
+  /* The no-op appended on taking office has committed, so reads need no
+   * log writes. */
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_index(p_leader, count_read, NULL));
+  CuAssertIntEquals(tc, 1, s_reads_released);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, s_last_read_status);
+  CuAssertIntEquals(tc, 1, s_last_read_index);
+  CuAssertIntEquals(tc, 2, raft_log_length(p_leader->p.p_log));
+
+  /* Nor do later ones. */
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_index(p_leader, count_read, NULL));
+  CuAssertIntEquals(tc, 2, s_reads_released);
+  CuAssertIntEquals(tc, 1, s_last_read_index);
+  CuAssertIntEquals(tc, 2, raft_log_length(p_leader->p.p_log));
+
+  stop_nodes();
+}
+
+void Test_raft_read_index_Shares_rounds(CuTest* tc) {
+  reset_reads();
+  raft_state_t* p_state = make_ready_leader();
+
+  /* The first read starts round 2. */
+  raft_read_index(p_state, count_read, NULL);
+  CuAssertIntEquals(tc, NODE_COUNT - 1, drain_messages(p_state));
+
+  /* Reads arriving mid-round share round 3. */
+  raft_read_index(p_state, count_read, NULL);
+  raft_read_index(p_state, count_read, NULL);
+  CuAssertIntEquals(tc, 0, drain_messages(p_state));
+
+  ack_round(p_state, 2);
+  CuAssertIntEquals(tc, 1, s_reads_released);
+  CuAssertIntEquals(tc, NODE_COUNT - 1, drain_messages(p_state));
+
+  ack_round(p_state, 3);
+  CuAssertIntEquals(tc, 3, s_reads_released);
+  CuAssertIntEquals(tc, 0, drain_messages(p_state));
+
+  raft_free(p_state);
+}
+
+void Test_raft_read_index_With_stale_acks(CuTest* tc) {
+  reset_reads();
+  raft_state_t* p_state = make_ready_leader();
+
+  raft_read_index(p_state, count_read, NULL);
+  drain_messages(p_state);
+
+  /* Responses to heartbeats sent before the read do not confirm it. */
+  ack_round(p_state, 1);
+  drain_messages(p_state);
+  CuAssertIntEquals(tc, 0, s_reads_released);
+
+  raft_free(p_state);
+}
+
+void Test_raft_read_index_With_lost_leadership(CuTest* tc) {
+  reset_reads();
+  raft_state_t* p_state = make_ready_leader();
+
+  raft_read_index(p_state, count_read, NULL);
+  raft_append_entries_response_args_t args = {
+    .follower_id = 2,
+    .term = 2,
+  };
+  raft_recv_append_entries_response(p_state, &args);
+
+  CuAssertIntEquals(tc, 1, s_reads_released);
+  CuAssertIntEquals(tc, RAFT_STATUS_NOT_LEADER, s_last_read_status);
+
+  raft_free(p_state);
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ******************************* Follower Reads ********************************
+ *******************************************************************************
+ ******************************************************************************/
+
+/* A ready-mode follower of node 2 in term 1. */
+static raft_state_t* make_ready_follower() {
+  raft_state_t* p_state = make_raft_node(1);
+  p_state->p_config->use_ready = RAFT_TRUE;
+
+  raft_append_entries_args_t heartbeat = {
+    .term = 1,
+    .leader_id = 2,
+  };
+  raft_recv_append_entries(p_state, &heartbeat);
+  drain_messages(p_state);
+  return p_state;
+}
+
+/* Drains the ready batch, returning the type of its only message. */
+static raft_message_type_t drain_message_type(raft_state_t* p_state) {
+  raft_ready_t ready;
+  raft_ready(p_state, &ready);
+  raft_message_type_t type = 0;
+  if (ready.num_messages == 1) {
+    type = raft_message_type(ready.p_messages[0].p_message);
+  }
+  raft_advance(p_state, &ready);
+  return type;
+}
+
+void Test_raft_read_index_Follower_in_cluster(CuTest* tc) {
+  reset_reads();
+  start_nodes();
+
+  process_events(10);
+  raft_nodeid_t const leader_id = first_leader() + 1;
+  raft_state_t* p_follower = get_node(leader_id % NODE_COUNT);
+  CuAssertIntEquals(tc, leader_id, p_follower->v.leader_id);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_index(p_follower, count_read, NULL));
+
+  /* The leader's no-op reaches the follower's commit index on the next
+   * heartbeat. */
+  process_events(NODE_COUNT);
+  CuAssertIntEquals(tc, 1, s_reads_released);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, s_last_read_status);
+  CuAssertIntEquals(tc, 1, s_last_read_index);
+  CuAssertTrue(tc, p_follower->v.last_applied >= 1);
+
+  stop_nodes();
+}
+
+void Test_raft_read_index_Follower_batches_requests(CuTest* tc) {
+  reset_reads();
+  raft_state_t* p_state = make_ready_follower();
+
+  raft_read_index(p_state, count_read, NULL);
+  CuAssertIntEquals(tc, MSG_TYPE_READ_INDEX, drain_message_type(p_state));
+
+  /* Reads queued while a request is in flight share the next one. */
+  raft_read_index(p_state, count_read, NULL);
+  raft_read_index(p_state, count_read, NULL);
+  CuAssertIntEquals(tc, 0, drain_messages(p_state));
+
+  raft_read_index_response_args_t response = {
+    .term = 1,
+    .request_id = 1,
+    .success = RAFT_TRUE,
+    .read_index = 1,
+  };
+  raft_recv_read_index_response(p_state, &response);
+  CuAssertIntEquals(tc, MSG_TYPE_READ_INDEX, drain_message_type(p_state));
+  CuAssertIntEquals(tc, 0, s_reads_released);
+
+  /* Reads are served once the follower has applied the read index. */
+  raft_log_entry_t entry = { .term = 1 };
+  raft_append_entries_args_t args = {
+    .term = 1,
+    .leader_id = 2,
+    .p_log_entries = &entry,
+    .num_entries = 1,
+    .leader_commit = 1,
+  };
+  raft_recv_append_entries(p_state, &args);
+  drain_messages(p_state);
+  CuAssertIntEquals(tc, 1, s_reads_released);
+  CuAssertIntEquals(tc, 1, s_last_read_index);
+
+  /* Stale responses are ignored. */
+  raft_recv_read_index_response(p_state, &response);
+  CuAssertIntEquals(tc, 1, s_reads_released);
+
+  response.request_id = 2;
+  raft_recv_read_index_response(p_state, &response);
+  CuAssertIntEquals(tc, 3, s_reads_released);
+  CuAssertIntEquals(tc, 0, drain_messages(p_state));
+
+  raft_free(p_state);
+}
+
+void Test_raft_read_index_Follower_with_failed_request(CuTest* tc) {
+  reset_reads();
+  raft_state_t* p_state = make_ready_follower();
+
+  raft_read_index(p_state, count_read, NULL);
+  drain_messages(p_state);
+
+  raft_read_index_response_args_t response = {
+    .term = 1,
+    .request_id = 1,
+    .success = RAFT_FALSE,
+  };
+  raft_recv_read_index_response(p_state, &response);
+  CuAssertIntEquals(tc, 1, s_reads_released);
+  CuAssertIntEquals(tc, RAFT_STATUS_NOT_LEADER, s_last_read_status);
+
+  /* A new term fails reads still waiting on the old leader. */
+  raft_read_index(p_state, count_read, NULL);
+  raft_append_entries_args_t heartbeat = {
+    .term = 2,
+    .leader_id = 3,
+  };
+  raft_recv_append_entries(p_state, &heartbeat);
+  CuAssertIntEquals(tc, 2, s_reads_released);
+  CuAssertIntEquals(tc, RAFT_STATUS_NOT_LEADER, s_last_read_status);
+
+  raft_free(p_state);
+}
+
+void Test_raft_read_index_Leader_answers_follower(CuTest* tc) {
+  raft_state_t* p_state = make_ready_leader();
+
+  raft_read_index_args_t request = {
+    .term = 1,
+    .follower_id = 2,
+    .request_id = 7,
+  };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_recv_read_index(p_state, &request));
+  drain_messages(p_state);
+
+  /* The answer waits for the heartbeat round. */
+  CuAssertIntEquals(tc, 0, drain_messages(p_state));
+  ack_round(p_state, 2);
+  CuAssertIntEquals(tc, MSG_TYPE_READ_INDEX_RESPONSE,
+                    drain_message_type(p_state));
+
+  raft_free(p_state);
+}
+
+/*******************************************************************************
+ *******************************************************************************
+ ******************************** Leader Leases ********************************
+ *******************************************************************************
+ ******************************************************************************/
+
+static raft_state_t* make_lease_leader() {
+  raft_state_t* p_state = make_ready_leader();
+  p_state->p_config->lease_reads = RAFT_TRUE;
+  p_state->p_config->lease_drift_ms = 100;
+  raft_lease_start(p_state);
+  return p_state;
+}
+
+void Test_raft_lease_read_Until_expiry(CuTest* tc) {
+  raft_state_t* p_state = make_lease_leader();
+  raft_index_t read_index = 0;
+
+  CuAssertIntEquals(tc, RAFT_STATUS_LEASE_EXPIRED,
+                    raft_lease_read(p_state, &read_index));
+
+  uint32_t reschedule_ms;
+  raft_tick(p_state, &reschedule_ms, 0);
+  ack_round(p_state, p_state->rd.seq);
+  drain_messages(p_state);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_lease_read(p_state, &read_index));
+  CuAssertIntEquals(tc, 1, read_index);
+
+  /* election_timeout_min_ms - lease_drift_ms after the acknowledged round. */
+  raft_tick(p_state, &reschedule_ms, 399);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_lease_read(p_state, &read_index));
+  raft_tick(p_state, &reschedule_ms, 1);
+  CuAssertIntEquals(tc, RAFT_STATUS_LEASE_EXPIRED,
+                    raft_lease_read(p_state, &read_index));
+
+  raft_free(p_state);
+}
+
+void Test_raft_lease_read_After_election(CuTest* tc) {
+  start_nodes();
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    get_node(ii)->p_config->lease_reads = RAFT_TRUE;
+    get_node(ii)->p_config->lease_drift_ms = 100;
+  }
+
+  /* The new leader's no-op commits with the round that grants its lease,
+   * so it reads locally before any client writes. */
+  process_events(10);
+  raft_state_t* p_leader = get_node(first_leader());
+  raft_index_t read_index = 0;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_lease_read(p_leader, &read_index));
+  CuAssertIntEquals(tc, 1, read_index);
+  CuAssertIntEquals(tc, 2, raft_log_length(p_leader->p.p_log));
+
+  stop_nodes();
+}
+
+void Test_raft_lease_read_After_step_down(CuTest* tc) {
+  raft_state_t* p_state = make_lease_leader();
+  raft_index_t read_index = 0;
+
+  uint32_t reschedule_ms;
+  raft_tick(p_state, &reschedule_ms, 0);
+  ack_round(p_state, p_state->rd.seq);
+  drain_messages(p_state);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_lease_read(p_state, &read_index));
+
+  raft_append_entries_response_args_t args = {
+    .follower_id = 2,
+    .term = 2,
+  };
+  raft_recv_append_entries_response(p_state, &args);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_NOT_LEADER,
+                    raft_lease_read(p_state, &read_index));
+  CuAssertTrue(tc, !raft_lease_valid(p_state));
+
+  raft_free(p_state);
+}
+
+void Test_raft_lease_Follower_ignores_candidates(CuTest* tc) {
+  raft_state_t* p_state = make_raft_node(1);
+  p_state->p_config->use_ready = RAFT_TRUE;
+  p_state->p_config->lease_reads = RAFT_TRUE;
+  p_state->p_config->lease_drift_ms = 100;
+
+  raft_append_entries_args_t heartbeat = {
+    .term = 1,
+    .leader_id = 2,
+  };
+  raft_recv_append_entries(p_state, &heartbeat);
+  drain_messages(p_state);
+
+  raft_request_vote_args_t vote = {
+    .term = 2,
+    .candidate_id = 3,
+  };
+  raft_recv_request_vote(p_state, &vote);
+  CuAssertIntEquals(tc, 1, p_state->p.current_term);
+  CuAssertIntEquals(tc, 0, p_state->p.voted_for);
+
+  /* Once the leader has been silent for the minimum timeout, vote. */
+  p_state->v.election_timeout_ms = p_state->p_config->election_timeout_max_ms;
+  uint32_t reschedule_ms;
+  raft_tick(p_state, &reschedule_ms,
+            p_state->p_config->election_timeout_min_ms);
+  raft_recv_request_vote(p_state, &vote);
+  CuAssertIntEquals(tc, 2, p_state->p.current_term);
+  CuAssertIntEquals(tc, 3, p_state->p.voted_for);
+
+  raft_free(p_state);
+}
+
+void Test_raft_lease_Dropped_after_abandoned_transfer(CuTest* tc) {
+  raft_state_t* p_state = make_lease_leader();
+  raft_index_t read_index = 0;
+
+  uint32_t reschedule_ms;
+  raft_tick(p_state, &reschedule_ms, 0);
+  ack_round(p_state, p_state->rd.seq);
+  drain_messages(p_state);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_transfer_leadership(p_state, 2));
+  CuAssertTrue(tc, p_state->l.transfer_sent);
+
+  /* Rounds acknowledged while TimeoutNow was out do not count afterwards. */
+  for (uint32_t ii = 0; ii < 3; ++ii) {
+    raft_tick(p_state, &reschedule_ms, 300);
+    ack_round(p_state, p_state->rd.seq);
+    drain_messages(p_state);
+  }
+  raft_tick(p_state, &reschedule_ms, 100);
+  CuAssertIntEquals(tc, 0, p_state->l.transfer_id);
+  CuAssertIntEquals(tc, RAFT_STATUS_LEASE_EXPIRED,
+                    raft_lease_read(p_state, &read_index));
+
+  raft_tick(p_state, &reschedule_ms, 0);
+  ack_round(p_state, p_state->rd.seq);
+  drain_messages(p_state);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_lease_read(p_state, &read_index));
+
+  raft_free(p_state);
+}
@@ -0,0 +1,207 @@
+#include "CuTest.h"
+
+#include "raft_log.h"
+#include "raft_ready.h"
+#include "raft_wire.h"
+
+#define NODE_COUNT 5
+#include "test_helpers.h"
+
+static raft_state_t* make_ready_node(uint32_t id) {
+  raft_state_t* p_state = make_raft_node(id);
+  p_state->p_config->use_ready = RAFT_TRUE;
+  return p_state;
+}
+
+static void drain_ready(raft_state_t* p_state) {
+  raft_ready_t ready;
+  raft_ready(p_state, &ready);
+  raft_advance(p_state, &ready);
+}
+
+static void elect(raft_state_t* p_state) {
+  uint32_t reschedule_ms;
+  raft_tick(p_state, &reschedule_ms,
+            p_state->p_config->election_timeout_max_ms);
+  drain_ready(p_state);
+
+  for (raft_nodeid_t id = 2; id <= NODE_COUNT / 2 + 1; ++id) {
+    raft_request_vote_response_args_t args = {
+      .follower_id = id,
+      .term = p_state->p.current_term,
+      .vote_granted = RAFT_TRUE
+    };
+    raft_recv_request_vote_response(p_state, &args);
+  }
+  drain_ready(p_state);
+}
+
+void Test_raft_ready_With_election(CuTest* tc) {
+  raft_state_t* p_state = make_ready_node(1);
+  CuAssertTrue(tc, !raft_has_ready(p_state));
+
+  uint32_t reschedule_ms;
+  raft_tick(p_state, &reschedule_ms,
+            p_state->p_config->election_timeout_max_ms);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_CANDIDATE, p_state->type);
+  CuAssertTrue(tc, raft_has_ready(p_state));
+
+  raft_ready_t ready;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_ready(p_state, &ready));
+  CuAssertIntEquals(tc, NODE_COUNT - 1, ready.num_messages);
+  for (uint32_t i = 0; i < ready.num_messages; ++i) {
+    CuAssertIntEquals(tc, MSG_TYPE_REQUEST_VOTE,
+                      raft_message_type(ready.p_messages[i].p_message));
+    CuAssertTrue(tc, ready.p_messages[i].recipient_id != 1);
+  }
+  CuAssertTrue(tc, ready.hard_state_changed);
+  CuAssertIntEquals(tc, 1, ready.current_term);
+  CuAssertIntEquals(tc, 1, ready.voted_for);
+  CuAssertIntEquals(tc, 0, ready.num_persist_entries);
+  CuAssertIntEquals(tc, 0, ready.num_apply_entries);
+
+  /* Messages are handed out once. */
+  CuAssertIntEquals(tc, 0, p_state->r.message_count);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_advance(p_state, &ready));
+  CuAssertTrue(tc, !raft_has_ready(p_state));
+
+  raft_free(p_state);
+}
+
+void Test_raft_ready_With_appended_entry(CuTest* tc) {
+  raft_state_t* p_state = make_ready_node(1);
+  elect(p_state);
+  CuAssertIntEquals(tc, RAFT_NODE_TYPE_LEADER, p_state->type);
+  CuAssertTrue(tc, !raft_has_ready(p_state));
+
+  uint8_t* p_data = malloc(4);
+  memset(p_data, 0xab, 4);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_append(p_state, 7, p_data, 4, NULL, NULL));
+
+  raft_ready_t ready;
+  raft_ready(p_state, &ready);
+  CuAssertTrue(tc, !ready.hard_state_changed);
+  CuAssertIntEquals(tc, NODE_COUNT - 1, ready.num_messages);
+  CuAssertIntEquals(tc, 2, ready.first_persist_index);
+  CuAssertIntEquals(tc, 1, ready.num_persist_entries);
+  CuAssertIntEquals(tc, 0, ready.num_apply_entries);
+  raft_advance(p_state, &ready);
+
+  for (raft_nodeid_t id = 2; id <= NODE_COUNT / 2 + 1; ++id) {
+    raft_append_entries_response_args_t args = {
+      .follower_id = id,
+      .term = p_state->p.current_term,
+      .success = RAFT_TRUE,
+      .acknowledged_log_index = 2,
+      .acknowledged_log_term = p_state->p.current_term
+    };
+    raft_recv_append_entries_response(p_state, &args);
+  }
+  CuAssertIntEquals(tc, 2, p_state->v.commit_index);
+  CuAssertIntEquals(tc, 0, p_state->v.last_applied);
+
+  /* The no-op the leader appended on taking office applies first. */
+  raft_ready(p_state, &ready);
+  CuAssertIntEquals(tc, 0, ready.num_messages);
+  CuAssertIntEquals(tc, 0, ready.num_persist_entries);
+  CuAssertIntEquals(tc, 1, ready.first_apply_index);
+  CuAssertIntEquals(tc, 2, ready.num_apply_entries);
+  raft_advance(p_state, &ready);
+
+  CuAssertIntEquals(tc, 2, p_state->v.last_applied);
+  CuAssertTrue(tc, !raft_has_ready(p_state));
+
+  raft_free(p_state);
+}
+
+void Test_raft_ready_With_suppressed_heartbeats(CuTest* tc) {
+  raft_state_t* p_state = make_ready_node(1);
+  elect(p_state);
+  raft_append(p_state, 7, NULL, 0, NULL, NULL);
+  drain_ready(p_state);
+
+  /* Followers just sent the entry are not pinged again. */
+  uint32_t reschedule_ms;
+  raft_tick(p_state, &reschedule_ms, 50);
+  CuAssertTrue(tc, !raft_has_ready(p_state));
+
+  for (raft_nodeid_t id = 2; id <= NODE_COUNT; ++id) {
+    raft_append_entries_response_args_t args = {
+      .follower_id = id,
+      .term = p_state->p.current_term,
+      .success = RAFT_TRUE,
+      .acknowledged_log_index = 2,
+      .acknowledged_log_term = p_state->p.current_term
+    };
+    raft_recv_append_entries_response(p_state, &args);
+  }
+  drain_ready(p_state);
+
+  /* Once idle, caught up followers get the minimal heartbeat. */
+  raft_tick(p_state, &reschedule_ms, 50);
+  raft_ready_t ready;
+  raft_ready(p_state, &ready);
+  CuAssertIntEquals(tc, NODE_COUNT - 1, ready.num_messages);
+  for (uint32_t ii = 0; ii < ready.num_messages; ++ii) {
+    CuAssertIntEquals(tc, MSG_TYPE_HEARTBEAT,
+                      raft_message_type(ready.p_messages[ii].p_message));
+  }
+
+  raft_heartbeat_args_t args;
+  raft_read_heartbeat_args(&args,
+                           ready.p_messages[0].p_message,
+                           ready.p_messages[0].message_size);
+  CuAssertIntEquals(tc, 2, args.leader_commit);
+  CuAssertIntEquals(tc, p_state->rd.seq, args.seq);
+  raft_advance(p_state, &ready);
+
+  raft_free(p_state);
+}
+
+void Test_raft_ready_With_relays(CuTest* tc) {
+  raft_state_t* p_state = make_ready_node(1);
+  p_state->p_config->relay_fanout = 2;
+  elect(p_state);
+  raft_append(p_state, 7, NULL, 0, NULL, NULL);
+
+  /* The four followers split into two relays with one child each. */
+  raft_ready_t ready;
+  raft_ready(p_state, &ready);
+  CuAssertIntEquals(tc, 2, ready.num_messages);
+
+  raft_append_entries_args_t args;
+  raft_read_append_entries_args(&args,
+                                ready.p_messages[0].p_message,
+                                ready.p_messages[0].message_size);
+  CuAssertIntEquals(tc, 2, ready.p_messages[0].recipient_id);
+  CuAssertIntEquals(tc, 1, args.num_relay_ids);
+  CuAssertIntEquals(tc, 3, args.p_relay_ids[0]);
+  raft_dealloc_append_entries_args(&args);
+
+  raft_read_append_entries_args(&args,
+                                ready.p_messages[1].p_message,
+                                ready.p_messages[1].message_size);
+  CuAssertIntEquals(tc, 4, ready.p_messages[1].recipient_id);
+  CuAssertIntEquals(tc, 1, args.num_relay_ids);
+  CuAssertIntEquals(tc, 5, args.p_relay_ids[0]);
+  raft_dealloc_append_entries_args(&args);
+  raft_advance(p_state, &ready);
+
+  /* Every follower is counted as sent the entry. */
+  for (uint32_t ii = 1; ii < NODE_COUNT; ++ii) {
+    CuAssertIntEquals(tc, raft_log_length(p_state->p.p_log),
+                      p_state->l.p_next_index[ii]);
+  }
+
+  raft_free(p_state);
+}
+
+void Test_raft_ready_Without_use_ready(CuTest* tc) {
+  raft_state_t* p_state = make_raft_node(1);
+
+  raft_ready_t ready;
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS, raft_ready(p_state, &ready));
+
+  raft_free(p_state);
+}
@@ -2,6 +2,7 @@
 
 #include "raft_rpc.h"
 #include "raft_log.h"
+#include "raft_wire.h"
 
 #define NODE_COUNT 5
 #include "test_helpers.h"
@@ -227,6 +228,44 @@ void Test_raft_recv_request_vote_While_leader_with_new_term_and_new_log(CuTest*
   stop_nodes();
 }
 
+static uint32_t s_persist_count;
+static raft_term_t s_persisted_term;
+static raft_nodeid_t s_persisted_voted_for;
+static raft_nodeid_t s_vote_response_target_at_persist;
+static raft_status_t save_hard_state(raft_term_t current_term,
+                                     raft_nodeid_t voted_for) {
+  ++s_persist_count;
+  s_persisted_term = current_term;
+  s_persisted_voted_for = voted_for;
+  s_vote_response_target_at_persist = s_recvd_vote_response_target;
+  return RAFT_STATUS_OK;
+}
+
+void Test_raft_recv_request_vote_Persists_hard_state(CuTest* tc) {
+  TEST_REQUEST_VOTE_SETUP(RAFT_NODE_TYPE_FOLLOWER, 0);
+  p_state->p_config->cb.pf_persist_hard_state = save_hard_state;
+  s_persist_count = 0;
+  s_recvd_vote_response_target = 0;
+
+  /* The new term and vote are stored together, before the vote is sent. */
+  raft_request_vote_args_t args = {
+    .term = 1,
+    .candidate_id = 2,
+  };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_recv_request_vote(p_state, &args));
+  CuAssertIntEquals(tc, 1, s_persist_count);
+  CuAssertIntEquals(tc, 1, s_persisted_term);
+  CuAssertIntEquals(tc, 2, s_persisted_voted_for);
+  CuAssertIntEquals(tc, 0, s_vote_response_target_at_persist);
+  CuAssertIntEquals(tc, 2, s_recvd_vote_response_target);
+
+  /* Repeating the request changes nothing to store. */
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_recv_request_vote(p_state, &args));
+  CuAssertIntEquals(tc, 1, s_persist_count);
+
+  stop_nodes();
+}
+
 /*******************************************************************************
  *******************************************************************************
  ********************** Receive RequestVoteResponse RPC ************************
@@ -340,6 +379,11 @@ void Test_raft_recv_request_vote_response_with_unknown_id(CuTest* tc) {
   CuAssertIntEquals(tc, 1, raft_state_vote_count(p_state));
   CuAssertIntEquals(tc, RAFT_NODE_TYPE_CANDIDATE, p_state->type);
 
+  args.follower_id = 0;
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS,
+                    raft_recv_request_vote_response(p_state, &args));
+  CuAssertIntEquals(tc, 1, raft_state_vote_count(p_state));
+
   stop_nodes();
 }
 
@@ -384,3 +428,136 @@ void Test_raft_recv_request_vote_leader_promotion(CuTest* tc) {
 
   stop_nodes();
 }
+
+/*******************************************************************************
+ *******************************************************************************
+ ************************** Receive Message Batches ****************************
+ *******************************************************************************
+ ******************************************************************************/
+
+void Test_raft_recv_messages_With_append_entries_batch(CuTest* tc) {
+  raft_state_t* p_state = make_raft_node(1);
+  p_state->p_config->use_ready = RAFT_TRUE;
+
+  raft_log_t* p_leader_log = raft_log_alloc();
+  for (uint32_t ii = 1; ii <= 3; ++ii) {
+    raft_log_append_user(p_leader_log, ii, 1, NULL, 0);
+  }
+
+  raft_envelope_t a_envelopes[3] = { { 0 } };
+  void* ap_messages[3];
+  uint32_t a_sizes[3];
+  for (uint32_t ii = 0; ii < 3; ++ii) {
+    raft_append_entries_args_t args = {
+      .term = 1,
+      .leader_id = 2,
+      .prev_log_index = ii,
+      .prev_log_term = ii ? 1 : 0,
+      .p_log_entries = (raft_log_entry_t*)raft_log_entry(p_leader_log, ii + 1),
+      .num_entries = 1,
+      .leader_commit = ii,
+    };
+    raft_write_append_entries_envelope(&a_envelopes[ii], 1, &args);
+    ap_messages[ii] = a_envelopes[ii].p_message;
+    a_sizes[ii] = a_envelopes[ii].message_size;
+  }
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_recv_messages(p_state, ap_messages, a_sizes, 3));
+  CuAssertIntEquals(tc, 4, raft_log_length(p_state->p.p_log));
+  CuAssertIntEquals(tc, 2, p_state->v.commit_index);
+
+  /* One response covering the whole batch. */
+  CuAssertIntEquals(tc, 1, p_state->r.message_count);
+  raft_append_entries_response_args_t response;
+  raft_read_append_entries_response_args(&response,
+                                         p_state->r.p_messages[0].p_message,
+                                         p_state->r.p_messages[0].message_size);
+  CuAssertIntEquals(tc, 2, p_state->r.p_messages[0].recipient_id);
+  CuAssertTrue(tc, response.success);
+  CuAssertIntEquals(tc, 3, response.acknowledged_log_index);
+
+  for (uint32_t ii = 0; ii < 3; ++ii) {
+    raft_dealloc_envelope(&a_envelopes[ii]);
+  }
+  raft_log_free(p_leader_log);
+  raft_free(p_state);
+}
+
+void Test_raft_recv_messages_With_append_entries_response_batch(CuTest* tc) {
+  raft_state_t* p_state = make_raft_node(1);
+  p_state->p_config->use_ready = RAFT_TRUE;
+  p_state->type = RAFT_NODE_TYPE_LEADER;
+  p_state->p.current_term = 1;
+  for (uint32_t ii = 0; ii < NODE_COUNT; ++ii) {
+    p_state->l.p_next_index[ii] = 1;
+  }
+  for (uint32_t ii = 1; ii <= 3; ++ii) {
+    raft_log_append_user(p_state->p.p_log, ii, 1, NULL, 0);
+  }
+
+  raft_envelope_t a_envelopes[3] = { { 0 } };
+  void* ap_messages[3];
+  uint32_t a_sizes[3];
+  for (uint32_t ii = 0; ii < 3; ++ii) {
+    raft_append_entries_response_args_t args = {
+      .follower_id = 2 + ii / 2,
+      .term = 1,
+      .success = RAFT_TRUE,
+      .acknowledged_log_index = 1 + ii % 2,
+      .acknowledged_log_term = 1,
+    };
+    raft_write_append_entries_response_envelope(&a_envelopes[ii], 1, &args);
+    ap_messages[ii] = a_envelopes[ii].p_message;
+    a_sizes[ii] = a_envelopes[ii].message_size;
+  }
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_recv_messages(p_state, ap_messages, a_sizes, 3));
+  CuAssertIntEquals(tc, 2, p_state->l.p_match_index[1]);
+  CuAssertIntEquals(tc, 1, p_state->l.p_match_index[2]);
+  CuAssertIntEquals(tc, 1, p_state->v.commit_index);
+
+  /* A single AppendEntries to each acknowledging follower. */
+  CuAssertIntEquals(tc, 2, p_state->r.message_count);
+  CuAssertIntEquals(tc, 2, p_state->r.p_messages[0].recipient_id);
+  CuAssertIntEquals(tc, 3, p_state->r.p_messages[1].recipient_id);
+
+  for (uint32_t ii = 0; ii < 3; ++ii) {
+    raft_dealloc_envelope(&a_envelopes[ii]);
+  }
+  raft_free(p_state);
+}
+
+void Test_raft_recv_heartbeat(CuTest* tc) {
+  raft_state_t* p_state = make_raft_node(1);
+  p_state->p_config->use_ready = RAFT_TRUE;
+  raft_log_append_user(p_state->p.p_log, 1, 1, NULL, 0);
+
+  /* The commit index is taken only as far as the local log goes. */
+  raft_heartbeat_args_t args = {
+    .term = 1,
+    .leader_id = 2,
+    .leader_commit = 3,
+    .seq = 7,
+  };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_recv_heartbeat(p_state, &args));
+  CuAssertIntEquals(tc, 2, p_state->v.leader_id);
+  CuAssertIntEquals(tc, 1, p_state->v.commit_index);
+
+  CuAssertIntEquals(tc, 1, p_state->r.message_count);
+  raft_append_entries_response_args_t response;
+  raft_read_append_entries_response_args(&response,
+                                         p_state->r.p_messages[0].p_message,
+                                         p_state->r.p_messages[0].message_size);
+  CuAssertTrue(tc, response.success);
+  CuAssertIntEquals(tc, 1, response.acknowledged_log_index);
+  CuAssertIntEquals(tc, 7, response.seq);
+
+  /* Stale leaders are told the current term. */
+  args.term = 0;
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_TERM,
+                    raft_recv_heartbeat(p_state, &args));
+
+  raft_free(p_state);
+}
@@ -0,0 +1,396 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CuTest.h"
+
+#include "raft_wal.h"
+#include "raft_wal_uring.h"
+
+static raft_wal_config_t const wal_config = {
+  .segment_size = 256,
+};
+
+static void make_wal_dir(CuTest* tc, char* p_dir) {
+  strcpy(p_dir, "/tmp/raft_wal_XXXXXX");
+  CuAssertPtrNotNull(tc, mkdtemp(p_dir));
+}
+
+static void remove_wal_dir(char const* p_dir) {
+  DIR* p_handle = opendir(p_dir);
+  for (struct dirent* p_dirent = readdir(p_handle);
+       p_dirent;
+       p_dirent = readdir(p_handle)) {
+    if (p_dirent->d_name[0] != '.') {
+      char a_path[300];
+      snprintf(a_path, sizeof(a_path), "%s/%s", p_dir, p_dirent->d_name);
+      unlink(a_path);
+    }
+  }
+  closedir(p_handle);
+  rmdir(p_dir);
+}
+
+static uint32_t file_count(char const* p_dir, char const* p_suffix) {
+  uint32_t count = 0;
+  DIR* p_handle = opendir(p_dir);
+  for (struct dirent* p_dirent = readdir(p_handle);
+       p_dirent;
+       p_dirent = readdir(p_handle)) {
+    count += strstr(p_dirent->d_name, p_suffix) != NULL;
+  }
+  closedir(p_handle);
+  return count;
+}
+
+static uint32_t segment_file_count(char const* p_dir) {
+  return file_count(p_dir, ".seg");
+}
+
+/**
+ * Appends entries first_index up to end_index, whose data is 40 bytes of
+ * their index plus salt.
+ */
+static void append_entries(CuTest* tc,
+                           raft_wal_t* p_wal,
+                           raft_index_t first_index,
+                           raft_index_t end_index,
+                           uint8_t salt) {
+  for (raft_index_t index = first_index; index < end_index; ++index) {
+    uint8_t a_data[40];
+    memset(a_data, (uint8_t)index + salt, sizeof(a_data));
+    raft_log_entry_t entry = {
+      .unique_id = index,
+      .term = 1,
+      .type = RAFT_LOG_ENTRY_TYPE_USER,
+      .p_data = a_data,
+      .data_size = sizeof(a_data),
+    };
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_wal_append(p_wal, index, &entry, 1));
+  }
+}
+
+static void check_entries(CuTest* tc,
+                          raft_wal_t* p_wal,
+                          raft_index_t first_index,
+                          raft_index_t end_index,
+                          uint8_t salt) {
+  for (raft_index_t index = first_index; index < end_index; ++index) {
+    raft_log_entry_t entry;
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_wal_entry(p_wal, index, &entry));
+    CuAssertIntEquals(tc, index, entry.unique_id);
+    CuAssertIntEquals(tc, 40, entry.data_size);
+    CuAssertIntEquals(tc, (uint8_t)index + salt,
+                      ((uint8_t const*)entry.p_data)[39]);
+  }
+}
+
+void Test_raft_wal_Append_and_read(CuTest* tc) {
+  char a_dir[32];
+  make_wal_dir(tc, a_dir);
+
+  raft_wal_t* p_wal;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &wal_config, &p_wal));
+  CuAssertIntEquals(tc, 0, raft_wal_end_index(p_wal));
+
+  append_entries(tc, p_wal, 1, 20, 0);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_sync(p_wal));
+  CuAssertIntEquals(tc, 1, raft_wal_first_index(p_wal));
+  CuAssertIntEquals(tc, 20, raft_wal_end_index(p_wal));
+  CuAssertTrue(tc, segment_file_count(a_dir) > 2);
+  check_entries(tc, p_wal, 1, 20, 0);
+
+  /* Sealed segments are read in place. */
+  raft_log_entry_t first, again;
+  raft_wal_entry(p_wal, 1, &first);
+  raft_wal_entry(p_wal, 1, &again);
+  CuAssertPtrEquals(tc, first.p_data, again.p_data);
+
+  raft_log_entry_t entry;
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS,
+                    raft_wal_entry(p_wal, 20, &entry));
+
+  /* Later entries replace those at and after their index. */
+  append_entries(tc, p_wal, 3, 6, 100);
+  CuAssertIntEquals(tc, 6, raft_wal_end_index(p_wal));
+  check_entries(tc, p_wal, 1, 3, 0);
+  check_entries(tc, p_wal, 3, 6, 100);
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_ARGS,
+                    raft_wal_append(p_wal, 8, &entry, 1));
+
+  raft_wal_close(p_wal);
+  remove_wal_dir(a_dir);
+}
+
+void Test_raft_wal_Compact(CuTest* tc) {
+  char a_dir[32];
+  make_wal_dir(tc, a_dir);
+
+  raft_wal_t* p_wal;
+  raft_wal_open(a_dir, &wal_config, &p_wal);
+  append_entries(tc, p_wal, 1, 20, 0);
+  uint32_t const segment_count = segment_file_count(a_dir);
+
+  /* Only segments wholly before the index go. */
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_compact(p_wal, 1));
+  CuAssertIntEquals(tc, segment_count, segment_file_count(a_dir));
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_compact(p_wal, 10));
+  CuAssertTrue(tc, segment_file_count(a_dir) < segment_count);
+  CuAssertTrue(tc, raft_wal_first_index(p_wal) > 1);
+  CuAssertTrue(tc, raft_wal_first_index(p_wal) <= 10);
+  check_entries(tc, p_wal, 10, 20, 0);
+
+  raft_wal_close(p_wal);
+  remove_wal_dir(a_dir);
+}
+
+void Test_raft_wal_Recover(CuTest* tc) {
+  char a_dir[32];
+  make_wal_dir(tc, a_dir);
+
+  raft_wal_t* p_wal;
+  raft_wal_open(a_dir, &wal_config, &p_wal);
+  append_entries(tc, p_wal, 5, 20, 0);
+  raft_wal_sync(p_wal);
+  raft_wal_close(p_wal);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &wal_config, &p_wal));
+  CuAssertIntEquals(tc, 5, raft_wal_first_index(p_wal));
+  CuAssertIntEquals(tc, 20, raft_wal_end_index(p_wal));
+  check_entries(tc, p_wal, 5, 20, 0);
+
+  /* Appending resumes in the last segment. */
+  append_entries(tc, p_wal, 20, 22, 0);
+  check_entries(tc, p_wal, 5, 22, 0);
+  raft_wal_close(p_wal);
+
+  /* A torn record ends the log. Segments hold four 72-byte records, so
+   * entry 21 starts the last one. */
+  char a_path[64];
+  snprintf(a_path, sizeof(a_path), "%s/%010u.seg", a_dir, 21);
+  FILE* p_stream = fopen(a_path, "r+b");
+  fseek(p_stream, 16 + 40, SEEK_SET);
+  fputc(0xee, p_stream);
+  fclose(p_stream);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &wal_config, &p_wal));
+  CuAssertIntEquals(tc, 21, raft_wal_end_index(p_wal));
+  check_entries(tc, p_wal, 5, 21, 0);
+  raft_wal_close(p_wal);
+
+  /* Sealed segments must be intact. */
+  snprintf(a_path, sizeof(a_path), "%s/%010u.seg", a_dir, 5);
+  p_stream = fopen(a_path, "r+b");
+  fseek(p_stream, 16 + 72 + 40, SEEK_SET);
+  fputc(0xee, p_stream);
+  fclose(p_stream);
+
+  /* Found when read, or on open when verifying. */
+  raft_log_entry_t entry;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &wal_config, &p_wal));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_entry(p_wal, 5, &entry));
+  CuAssertIntEquals(tc, RAFT_STATUS_IO_ERROR,
+                    raft_wal_entry(p_wal, 6, &entry));
+  raft_wal_close(p_wal);
+
+  raft_wal_config_t config = wal_config;
+  config.verify_threads = 2;
+  CuAssertIntEquals(tc, RAFT_STATUS_IO_ERROR,
+                    raft_wal_open(a_dir, &config, &p_wal));
+
+  remove_wal_dir(a_dir);
+}
+
+void Test_raft_wal_Segment_index(CuTest* tc) {
+  char a_dir[32];
+  make_wal_dir(tc, a_dir);
+
+  raft_wal_t* p_wal;
+  raft_wal_open(a_dir, &wal_config, &p_wal);
+  append_entries(tc, p_wal, 1, 14, 0);
+  raft_wal_sync(p_wal);
+  raft_wal_close(p_wal);
+
+  /* Drop the footer of the segment at 5, which is then scanned instead. */
+  char a_path[64];
+  snprintf(a_path, sizeof(a_path), "%s/%010u.seg", a_dir, 5);
+  FILE* p_stream = fopen(a_path, "r+b");
+  fseek(p_stream, 12, SEEK_SET);
+  fwrite("\0\0\0\0", 1, 4, p_stream);
+  fclose(p_stream);
+
+  raft_wal_config_t config = wal_config;
+  config.verify_threads = 3;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &config, &p_wal));
+  CuAssertIntEquals(tc, 1, raft_wal_first_index(p_wal));
+  CuAssertIntEquals(tc, 14, raft_wal_end_index(p_wal));
+  check_entries(tc, p_wal, 1, 14, 0);
+  raft_term_t term = 0;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_term(p_wal, 6, &term));
+  CuAssertIntEquals(tc, 1, term);
+  raft_wal_close(p_wal);
+
+  /* A sealed segment indexed lazily can still take replacement entries. */
+  raft_wal_open(a_dir, &wal_config, &p_wal);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_term(p_wal, 2, &term));
+  append_entries(tc, p_wal, 3, 4, 100);
+  CuAssertIntEquals(tc, 4, raft_wal_end_index(p_wal));
+  raft_wal_sync(p_wal);
+  raft_wal_close(p_wal);
+
+  raft_wal_open(a_dir, &wal_config, &p_wal);
+  CuAssertIntEquals(tc, 4, raft_wal_end_index(p_wal));
+  check_entries(tc, p_wal, 1, 3, 0);
+  check_entries(tc, p_wal, 3, 4, 100);
+  raft_wal_close(p_wal);
+
+  remove_wal_dir(a_dir);
+}
+
+void Test_raft_wal_Uring(CuTest* tc) {
+  char a_dir[32];
+  make_wal_dir(tc, a_dir);
+
+  /* Falls back to pwrite() where io_uring is unavailable. */
+  raft_wal_config_t config = wal_config;
+  config.io_depth = 4;
+  config.io_buffer_size = 128;
+  raft_wal_t* p_wal;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &config, &p_wal));
+
+  append_entries(tc, p_wal, 1, 20, 0);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_flush(p_wal));
+  CuAssertTrue(tc, raft_wal_durable_index(p_wal) <= 20);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_sync(p_wal));
+  CuAssertIntEquals(tc, 20, raft_wal_durable_index(p_wal));
+  check_entries(tc, p_wal, 1, 20, 0);
+
+  /* Replacing entries takes back their durability. */
+  append_entries(tc, p_wal, 18, 20, 100);
+  CuAssertIntEquals(tc, 18, raft_wal_durable_index(p_wal));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_sync(p_wal));
+  CuAssertIntEquals(tc, 20, raft_wal_durable_index(p_wal));
+  raft_wal_close(p_wal);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &wal_config, &p_wal));
+  CuAssertIntEquals(tc, 20, raft_wal_end_index(p_wal));
+  check_entries(tc, p_wal, 1, 18, 0);
+  check_entries(tc, p_wal, 18, 20, 100);
+  raft_wal_close(p_wal);
+
+  remove_wal_dir(a_dir);
+}
+
+void Test_raft_wal_Uring_syncs_complete_in_order(CuTest* tc) {
+  raft_wal_uring_t* p_uring;
+  if (RAFT_FAILURE(raft_wal_uring_alloc(4, 4096, &p_uring))) {
+    return;
+  }
+
+  char a_path[] = "/tmp/raft_wal_XXXXXX";
+  int const fd = mkstemp(a_path);
+  CuAssertTrue(tc, fd >= 0);
+  unlink(a_path);
+
+  /* The first flush writes to a full pipe, so it stalls until it is read. */
+  int a_pipe[2];
+  CuAssertIntEquals(tc, 0, pipe(a_pipe));
+  fcntl(a_pipe[1], F_SETFL, O_NONBLOCK);
+  char a_bytes[4096] = {0};
+  while (write(a_pipe[1], a_bytes, sizeof(a_bytes)) > 0) {
+  }
+  fcntl(a_pipe[1], F_SETFL, 0);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_uring_write(p_uring, a_pipe[1], a_bytes,
+                                         sizeof(a_bytes), 0));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_uring_sync(p_uring, fd, 2));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_uring_write(p_uring, fd, a_bytes,
+                                         sizeof(a_bytes), 0));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_uring_sync(p_uring, fd, 3));
+
+  /* The second flush completing first does not make the first durable. */
+  raft_index_t durable_index = 1;
+  for (uint32_t ii = 0; ii < 20; ++ii) {
+    usleep(1000);
+    CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                      raft_wal_uring_reap(p_uring, RAFT_FALSE,
+                                          &durable_index));
+  }
+  CuAssertIntEquals(tc, 1, durable_index);
+
+  /* Making room in the pipe lets both go through. */
+  CuAssertIntEquals(tc, sizeof(a_bytes),
+                    read(a_pipe[0], a_bytes, sizeof(a_bytes)));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_uring_reap(p_uring, RAFT_TRUE, &durable_index));
+  CuAssertIntEquals(tc, 3, durable_index);
+
+  raft_wal_uring_free(p_uring);
+  close(a_pipe[0]);
+  close(a_pipe[1]);
+  close(fd);
+}
+
+void Test_raft_wal_Spare_segments(CuTest* tc) {
+  char a_dir[32];
+  make_wal_dir(tc, a_dir);
+
+  raft_wal_config_t config = wal_config;
+  config.spare_segments = 2;
+  raft_wal_t* p_wal;
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &config, &p_wal));
+  CuAssertIntEquals(tc, 2, file_count(a_dir, ".spare"));
+
+  /* New segments move into spares, which compaction refills. */
+  append_entries(tc, p_wal, 1, 10, 0);
+  CuAssertIntEquals(tc, 0, file_count(a_dir, ".spare"));
+  CuAssertIntEquals(tc, 3, segment_file_count(a_dir));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_compact(p_wal, 1));
+  CuAssertIntEquals(tc, 3, segment_file_count(a_dir));
+  CuAssertIntEquals(tc, 1, file_count(a_dir, ".spare"));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_compact(p_wal, 9));
+  CuAssertIntEquals(tc, 1, segment_file_count(a_dir));
+  CuAssertIntEquals(tc, 2, file_count(a_dir, ".spare"));
+
+  /* Recycled segments keep their old records, which are never read back. */
+  append_entries(tc, p_wal, 10, 17, 0);
+  CuAssertIntEquals(tc, 1, file_count(a_dir, ".spare"));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK, raft_wal_sync(p_wal));
+  raft_wal_close(p_wal);
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &config, &p_wal));
+  CuAssertIntEquals(tc, 9, raft_wal_first_index(p_wal));
+  CuAssertIntEquals(tc, 17, raft_wal_end_index(p_wal));
+  check_entries(tc, p_wal, 9, 17, 0);
+
+  /* Truncated records are cleared, not resurrected by a same-sized
+   * replacement. */
+  append_entries(tc, p_wal, 14, 15, 100);
+  raft_wal_close(p_wal);
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_wal_open(a_dir, &config, &p_wal));
+  CuAssertIntEquals(tc, 15, raft_wal_end_index(p_wal));
+  check_entries(tc, p_wal, 14, 15, 100);
+  raft_wal_close(p_wal);
+
+  remove_wal_dir(a_dir);
+}
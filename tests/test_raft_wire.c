@@ -13,13 +13,16 @@
 
 static uint8_t expected_append_entries_message_no_logs[] = {
   0, 0, 1, MSG_TYPE_APPEND_ENTRIES,
-  0, 0, 0, 32,
+  0, 0, 0, 44,
   0x55, 0x44, 0x33, 0x22,
   0x99, 0x88, 0x77, 0x66,
   0x11, 0x22, 0x33, 0x44,
   0x00, 0x11, 0x00, 0x33,
   0, 0, 0, 0,
   0x99, 0x00, 0x22, 0x11,
+  0x01, 0x02, 0x03, 0x04,
+  0x0a, 0x0b, 0x0c, 0x0d,
+  0, 0, 0, 0,
 };
 
 void Test_raft_write_append_entries_envelope_With_no_log_entries(CuTest* tc) {
@@ -30,6 +33,8 @@ void Test_raft_write_append_entries_envelope_With_no_log_entries(CuTest* tc) {
     .prev_log_term = 0x00110033,
     .p_log_entries = NULL,
     .leader_commit = 0x99002211,
+    .seq = 0x01020304,
+    .election_timeout_hint_ms = 0x0a0b0c0d,
   };
 
   raft_envelope_t env = { 0 };
@@ -37,7 +42,7 @@ void Test_raft_write_append_entries_envelope_With_no_log_entries(CuTest* tc) {
                     raft_write_append_entries_envelope(&env, 2, &args));;
 
   CuAssertIntEquals(tc, 2, env.recipient_id);
-  CuAssertIntEquals(tc, 32, env.message_size);
+  CuAssertIntEquals(tc, 44, env.message_size);
   CuAssertIntEquals(tc, 0x100, env.buffer_capacity);
 
   uint32_t const arr_size = ARRAY_ELEMENT_COUNT(expected_append_entries_message_no_logs);
@@ -52,13 +57,16 @@ void Test_raft_write_append_entries_envelope_With_no_log_entries(CuTest* tc) {
 
 static uint8_t expected_append_entries_message_one_log[] = {
   0, 0, 1, MSG_TYPE_APPEND_ENTRIES,
-  0, 0, 0, (32 + 12 + 0) /* Fixed + log metadata + log data */,
+  0, 0, 0, (44 + 12 + 0) /* Fixed + log metadata + log data */,
   0x55, 0x44, 0x33, 0x22,
   0x99, 0x88, 0x77, 0x66,
   0x11, 0x22, 0x33, 0x44,
   0x00, 0x11, 0x00, 0x33,
   0, 0, 0, 1,
   0x99, 0x00, 0x22, 0x11,
+  0, 0, 0, 0,
+  0, 0, 0, 0,
+  0, 0, 0, 0,
   0x80, 0, 0, 0,
   0, 0, 0, 0,
   0, 0, 0, 0,
@@ -81,7 +89,7 @@ void Test_raft_write_append_entries_envelope_With_one_log_entry(CuTest* tc) {
                     raft_write_append_entries_envelope(&env, 2, &args));;
 
   CuAssertIntEquals(tc, 2, env.recipient_id);
-  CuAssertIntEquals(tc, (32 + 12), env.message_size);
+  CuAssertIntEquals(tc, (44 + 12), env.message_size);
   CuAssertIntEquals(tc, 0x100, env.buffer_capacity);
 
   uint32_t const arr_size = ARRAY_ELEMENT_COUNT(expected_append_entries_message_one_log);
@@ -98,13 +106,16 @@ void Test_raft_write_append_entries_envelope_With_one_log_entry(CuTest* tc) {
 
 static uint8_t expected_append_entries_message_two_logs[] = {
   0, 0, 1, MSG_TYPE_APPEND_ENTRIES,
-  0, 0, 0, (32 + 12*2 + 7) /* Fixed + log metadata + log data */,
+  0, 0, 0, (44 + 12*2 + 7) /* Fixed + log metadata + log data */,
   0x55, 0x44, 0x33, 0x22,
   0x99, 0x88, 0x77, 0x66,
   0x11, 0x22, 0x33, 0x44,
   0x00, 0x11, 0x00, 0x33,
   0, 0, 0, 2,
   0x99, 0x00, 0x22, 0x11,
+  0, 0, 0, 0,
+  0, 0, 0, 0,
+  0, 0, 0, 0,
   0x80, 0, 0, 0,          /* Entry 0 Metadata */
   0, 0, 0, 0,
   0, 0, 0, 0,
@@ -128,7 +139,7 @@ void Test_raft_write_append_entries_envelope_With_two_log_entries(CuTest* tc) {
   };
 
   uint8_t* p_data = malloc(7);
-  memcpy(p_data, &expected_append_entries_message_two_logs[56], 7);
+  memcpy(p_data, &expected_append_entries_message_two_logs[68], 7);
   raft_log_append_user(p_log, 0xffaaccdd, 1, p_data, 7);
 
   raft_envelope_t env = { 0 };
@@ -136,7 +147,7 @@ void Test_raft_write_append_entries_envelope_With_two_log_entries(CuTest* tc) {
                     raft_write_append_entries_envelope(&env, 2, &args));;
 
   CuAssertIntEquals(tc, 2, env.recipient_id);
-  CuAssertIntEquals(tc, 63, env.message_size);
+  CuAssertIntEquals(tc, 75, env.message_size);
   CuAssertIntEquals(tc, 0x100, env.buffer_capacity);
 
   uint32_t const arr_size = ARRAY_ELEMENT_COUNT(expected_append_entries_message_two_logs);
@@ -187,6 +198,189 @@ void Test_raft_read_append_entries_message(CuTest* tc) {
   CuAssertIntEquals(tc, 0, memcmp(p_entry->p_data, p_expected_entry_data, 7));
 }
 
+void Test_raft_append_entries_message_With_relay_ids(CuTest* tc) {
+  raft_nodeid_t a_relay_ids[] = { 3, 4 };
+  raft_append_entries_args_t args = {
+    .term = 1,
+    .leader_id = 2,
+    .p_relay_ids = a_relay_ids,
+    .num_relay_ids = 2,
+  };
+
+  raft_envelope_t env = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_write_append_entries_envelope(&env, 5, &args));
+  CuAssertIntEquals(tc, 44 + 4*2, env.message_size);
+
+  raft_append_entries_args_t read_args = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_append_entries_args(&read_args,
+                                                  env.p_message,
+                                                  env.message_size));
+  CuAssertIntEquals(tc, 2, read_args.num_relay_ids);
+  CuAssertIntEquals(tc, 3, read_args.p_relay_ids[0]);
+  CuAssertIntEquals(tc, 4, read_args.p_relay_ids[1]);
+  raft_dealloc_append_entries_args(&read_args);
+
+  /* A message cut short of its relay ids is refused. */
+  raft_append_entries_args_t short_args = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_MESSAGE,
+                    raft_read_append_entries_args(&short_args,
+                                                  env.p_message,
+                                                  env.message_size - 4));
+  CuAssertPtrEquals(tc, NULL, short_args.p_relay_ids);
+
+  raft_dealloc_envelope(&env);
+}
+
+void Test_raft_append_entries_message_Metadata_only(CuTest* tc) {
+  raft_log_t* p_log = raft_log_alloc();
+  raft_append_entries_args_t args = {
+    .term = 1,
+    .leader_id = 2,
+    .p_log_entries = (raft_log_entry_t*)raft_log_entry(p_log, 0),
+    .num_entries = 2,
+    .metadata_only = RAFT_TRUE,
+  };
+
+  uint8_t* p_data = malloc(7);
+  memset(p_data, 0x5a, 7);
+  raft_log_append_user(p_log, 0xffaaccdd, 1, p_data, 7);
+
+  raft_envelope_t env = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_write_append_entries_envelope(&env, 2, &args));
+  CuAssertIntEquals(tc, 44 + 12*2, env.message_size);
+
+  /* The size survives without the data. */
+  raft_append_entries_args_t read_args = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_append_entries_args(&read_args,
+                                                  env.p_message,
+                                                  env.message_size));
+  CuAssertTrue(tc, read_args.metadata_only);
+  raft_log_entry_t* p_entry = &read_args.p_log_entries[1];
+  CuAssertIntEquals(tc, 0xffaaccdd, p_entry->unique_id);
+  CuAssertIntEquals(tc, RAFT_LOG_ENTRY_TYPE_USER, p_entry->type);
+  CuAssertIntEquals(tc, 7, p_entry->data_size);
+  CuAssertPtrEquals(tc, NULL, p_entry->p_data);
+
+  raft_dealloc_append_entries_args(&read_args);
+  raft_dealloc_envelope(&env);
+  raft_log_free(p_log);
+}
+
+void Test_raft_append_entries_message_With_fragments(CuTest* tc) {
+  uint8_t a_fragment[] = { 1, 2, 3 };
+  raft_log_entry_t entry = {
+    .type = RAFT_LOG_ENTRY_TYPE_USER,
+    .term = 1,
+    .unique_id = 7,
+    .p_data = a_fragment,
+    .data_size = sizeof(a_fragment),
+    .coded_size = 5,
+    .fragments_needed = 2,
+    .fragment_index = 4,
+  };
+  raft_append_entries_args_t args = {
+    .term = 1,
+    .leader_id = 2,
+    .p_log_entries = &entry,
+    .num_entries = 1,
+  };
+
+  raft_envelope_t env = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_write_append_entries_envelope(&env, 5, &args));
+  CuAssertIntEquals(tc, 44 + 20 + 3, env.message_size);
+
+  raft_append_entries_args_t read_args = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_append_entries_args(&read_args,
+                                                  env.p_message,
+                                                  env.message_size));
+  raft_log_entry_t* p_entry = &read_args.p_log_entries[0];
+  CuAssertIntEquals(tc, 3, p_entry->data_size);
+  CuAssertIntEquals(tc, 5, p_entry->coded_size);
+  CuAssertIntEquals(tc, 2, p_entry->fragments_needed);
+  CuAssertIntEquals(tc, 4, p_entry->fragment_index);
+  CuAssertIntEquals(tc, 0, memcmp(a_fragment, p_entry->p_data, 3));
+
+  raft_dealloc_append_entries_args(&read_args);
+  raft_dealloc_envelope(&env);
+}
+
+void Test_raft_heartbeat_message(CuTest* tc) {
+  raft_heartbeat_args_t args = {
+    .term = 0x55443322,
+    .leader_id = 2,
+    .leader_commit = 0x00110033,
+    .seq = 0x01020304,
+    .election_timeout_hint_ms = 150,
+  };
+
+  raft_envelope_t env = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_write_heartbeat_envelope(&env, 3, &args));
+  CuAssertIntEquals(tc, 3, env.recipient_id);
+  CuAssertIntEquals(tc, 28, env.message_size);
+  CuAssertIntEquals(tc, MSG_TYPE_HEARTBEAT, raft_message_type(env.p_message));
+
+  raft_heartbeat_args_t read_args = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_heartbeat_args(&read_args,
+                                             env.p_message,
+                                             env.message_size));
+  CuAssertIntEquals(tc, 0x55443322, read_args.term);
+  CuAssertIntEquals(tc, 2, read_args.leader_id);
+  CuAssertIntEquals(tc, 0x00110033, read_args.leader_commit);
+  CuAssertIntEquals(tc, 0x01020304, read_args.seq);
+  CuAssertIntEquals(tc, 150, read_args.election_timeout_hint_ms);
+
+  raft_dealloc_envelope(&env);
+}
+
+void Test_raft_fragment_response_message(CuTest* tc) {
+  raft_fragment_response_args_t args = {
+    .sender_id = 4,
+    .index = 0x00010203,
+    .entry_term = 0x55443322,
+    .held = 1,
+    .fragment_index = 3,
+    .p_data = "fragment",
+    .data_size = 8,
+  };
+
+  raft_envelope_t env = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_write_fragment_response_envelope(&env, 1, &args));
+  CuAssertIntEquals(tc, 1, env.recipient_id);
+  CuAssertIntEquals(tc, 40, env.message_size);
+  CuAssertIntEquals(tc, MSG_TYPE_FRAGMENT_RESPONSE,
+                    raft_message_type(env.p_message));
+
+  raft_fragment_response_args_t read_args = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_fragment_response_args(&read_args,
+                                                     env.p_message,
+                                                     env.message_size));
+  CuAssertIntEquals(tc, 4, read_args.sender_id);
+  CuAssertIntEquals(tc, 0x00010203, read_args.index);
+  CuAssertIntEquals(tc, 0x55443322, read_args.entry_term);
+  CuAssertTrue(tc, read_args.held);
+  CuAssertIntEquals(tc, 3, read_args.fragment_index);
+  CuAssertIntEquals(tc, 8, read_args.data_size);
+  CuAssertTrue(tc, memcmp(read_args.p_data, "fragment", 8) == 0);
+
+  /* Data running past the end of the message is rejected. */
+  CuAssertIntEquals(tc, RAFT_STATUS_INVALID_MESSAGE,
+                    raft_read_fragment_response_args(&read_args,
+                                                     env.p_message,
+                                                     env.message_size - 1));
+
+  raft_dealloc_envelope(&env);
+}
+
 /*******************************************************************************
  *******************************************************************************
  *************************** RequestVote Wire Format ***************************
@@ -195,12 +389,13 @@ void Test_raft_read_append_entries_message(CuTest* tc) {
 
 static uint8_t expected_append_entries_response_message[] = {
   0, 0, 1, MSG_TYPE_APPEND_ENTRIES_RESPONSE,
-  0, 0, 0, 28,
+  0, 0, 0, 32,
   0x55, 0x44, 0x33, 0x22,
   0x99, 0x88, 0x77, 0x66,
   0x00, 0x00, 0x00, 0x01,
   0x00, 0x11, 0x00, 0x33,
   0xff, 0x11, 0xdd, 0x33,
+  0x01, 0x02, 0x03, 0x04,
 };
 
 void Test_raft_write_append_entries_response_envelope(CuTest* tc) {
@@ -210,6 +405,7 @@ void Test_raft_write_append_entries_response_envelope(CuTest* tc) {
     .success = RAFT_TRUE,
     .acknowledged_log_index = 0x00110033,
     .acknowledged_log_term = 0xff11dd33,
+    .seq = 0x01020304,
   };
 
   raft_envelope_t env = { 0 };
@@ -217,7 +413,7 @@ void Test_raft_write_append_entries_response_envelope(CuTest* tc) {
                     raft_write_append_entries_response_envelope(&env, 1, &args));
 
   CuAssertIntEquals(tc, 1, env.recipient_id);
-  CuAssertIntEquals(tc, 28, env.message_size);
+  CuAssertIntEquals(tc, 32, env.message_size);
   CuAssertIntEquals(tc, 0x100, env.buffer_capacity);
 
   uint32_t const arr_size = ARRAY_ELEMENT_COUNT(expected_append_entries_response_message);
@@ -243,6 +439,7 @@ void Test_raft_read_append_entries_response_message(CuTest* tc) {
   CuAssertIntEquals(tc, RAFT_TRUE, args.success);
   CuAssertIntEquals(tc, 0x00110033, args.acknowledged_log_index);
   CuAssertIntEquals(tc, 0xff11dd33, args.acknowledged_log_term);
+  CuAssertIntEquals(tc, 0x01020304, args.seq);
 }
 
 /*******************************************************************************
@@ -253,11 +450,12 @@ void Test_raft_read_append_entries_response_message(CuTest* tc) {
 
 static uint8_t expected_request_vote_message[] = {
   0, 0, 1, MSG_TYPE_REQUEST_VOTE,
-  0, 0, 0, 24,
+  0, 0, 0, 28,
   0x55, 0x44, 0x33, 0x22,
   0x99, 0x88, 0x77, 0x66,
   0x11, 0x22, 0x33, 0x44,
   0x00, 0x11, 0x00, 0x33,
+  0, 0, 0, 1,
 };
 
 void Test_raft_write_request_vote_envelope(CuTest* tc) {
@@ -265,7 +463,8 @@ void Test_raft_write_request_vote_envelope(CuTest* tc) {
     .term = 0x55443322,
     .candidate_id = 0x99887766,
     .last_log_index = 0x11223344,
-    .last_log_term = 0x00110033
+    .last_log_term = 0x00110033,
+    .leadership_transfer = RAFT_TRUE
   };
 
   raft_envelope_t env = { 0 };
@@ -273,7 +472,7 @@ void Test_raft_write_request_vote_envelope(CuTest* tc) {
                     raft_write_request_vote_envelope(&env, 1, &args));
 
   CuAssertIntEquals(tc, 1, env.recipient_id);
-  CuAssertIntEquals(tc, 24, env.message_size);
+  CuAssertIntEquals(tc, 28, env.message_size);
   CuAssertIntEquals(tc, 0x100, env.buffer_capacity);
 
   uint32_t const arr_size = ARRAY_ELEMENT_COUNT(expected_request_vote_message);
@@ -298,6 +497,7 @@ void Test_raft_read_request_vote_message(CuTest* tc) {
   CuAssertIntEquals(tc, 0x99887766, args.candidate_id);
   CuAssertIntEquals(tc, 0x11223344, args.last_log_index);
   CuAssertIntEquals(tc, 0x00110033, args.last_log_term);
+  CuAssertIntEquals(tc, 0x1, args.leadership_transfer);
 }
 
 /*******************************************************************************
@@ -353,3 +553,104 @@ void Test_raft_read_request_vote_response_message(CuTest* tc) {
   CuAssertIntEquals(tc, 0x99887766, args.term);
   CuAssertIntEquals(tc, 0x1, args.vote_granted);
 }
+
+/*******************************************************************************
+ *******************************************************************************
+ ******************************** Read Index ***********************************
+ *******************************************************************************
+ ******************************************************************************/
+
+static uint8_t expected_read_index_message[] = {
+  0, 0, 1, MSG_TYPE_READ_INDEX,
+  0, 0, 0, 20,
+  0x99, 0x88, 0x77, 0x66,
+  0x55, 0x44, 0x33, 0x22,
+  0x12, 0x34, 0x56, 0x78,
+};
+
+void Test_raft_write_read_index_envelope(CuTest* tc) {
+  raft_read_index_args_t args = {
+    .term = 0x99887766,
+    .follower_id = 0x55443322,
+    .request_id = 0x12345678,
+  };
+
+  raft_envelope_t env = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_write_read_index_envelope(&env, 1, &args));
+
+  CuAssertIntEquals(tc, 1, env.recipient_id);
+  CuAssertIntEquals(tc, 20, env.message_size);
+
+  uint32_t const arr_size = ARRAY_ELEMENT_COUNT(expected_read_index_message);
+  for (uint32_t i = 0; i < arr_size; ++i) {
+    CuAssertIntEquals(tc, expected_read_index_message[i], env.p_message[i]);
+  }
+
+  raft_dealloc_envelope(&env);
+}
+
+void Test_raft_read_read_index_message(CuTest* tc) {
+  raft_read_index_args_t args = { 0 };
+
+  CuAssertIntEquals(tc, MSG_TYPE_READ_INDEX,
+                    raft_message_type(expected_read_index_message));
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_read_index_args(
+                        &args,
+                        expected_read_index_message,
+                        sizeof(expected_read_index_message)));
+
+  CuAssertIntEquals(tc, 0x99887766, args.term);
+  CuAssertIntEquals(tc, 0x55443322, args.follower_id);
+  CuAssertIntEquals(tc, 0x12345678, args.request_id);
+}
+
+static uint8_t expected_read_index_response_message[] = {
+  0, 0, 1, MSG_TYPE_READ_INDEX_RESPONSE,
+  0, 0, 0, 24,
+  0x99, 0x88, 0x77, 0x66,
+  0x12, 0x34, 0x56, 0x78,
+  0, 0, 0, 1,
+  0x0a, 0x0b, 0x0c, 0x0d,
+};
+
+void Test_raft_write_read_index_response_envelope(CuTest* tc) {
+  raft_read_index_response_args_t args = {
+    .term = 0x99887766,
+    .request_id = 0x12345678,
+    .success = RAFT_TRUE,
+    .read_index = 0x0a0b0c0d,
+  };
+
+  raft_envelope_t env = { 0 };
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_write_read_index_response_envelope(&env, 1, &args));
+
+  CuAssertIntEquals(tc, 24, env.message_size);
+
+  uint32_t const arr_size =
+      ARRAY_ELEMENT_COUNT(expected_read_index_response_message);
+  for (uint32_t i = 0; i < arr_size; ++i) {
+    CuAssertIntEquals(tc,
+                      expected_read_index_response_message[i],
+                      env.p_message[i]);
+  }
+
+  raft_dealloc_envelope(&env);
+}
+
+void Test_raft_read_read_index_response_message(CuTest* tc) {
+  raft_read_index_response_args_t args = { 0 };
+
+  CuAssertIntEquals(tc, RAFT_STATUS_OK,
+                    raft_read_read_index_response_args(
+                        &args,
+                        expected_read_index_response_message,
+                        sizeof(expected_read_index_response_message)));
+
+  CuAssertIntEquals(tc, 0x99887766, args.term);
+  CuAssertIntEquals(tc, 0x12345678, args.request_id);
+  CuAssertIntEquals(tc, 0x1, args.success);
+  CuAssertIntEquals(tc, 0x0a0b0c0d, args.read_index);
+}